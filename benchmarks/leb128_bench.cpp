@@ -0,0 +1,157 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Microbenchmark for LEB128 decoding throughput.
+//
+// Decodes a buffer of u32 and i64 immediates, distributed roughly like those in real code sections
+// (mostly small indices and constants), through:
+// - the stream source, one byte at a time;
+// - the buffer source, with the byte-at-a-time loop (internal_parse_uN/sN);
+// - the buffer source, with the word-at-a-time fast path (parse_u32/parse_i64).
+//
+// It also compares the bulk vector decoders in leb128_simd.h on function-section-like vectors of typeidxs.
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "absl/strings/str_format.h"
+
+#include "leb128_simd.h"
+#include "parser.h"
+
+namespace wasmtoolbox {
+
+static auto encode_u(uint64_t value, std::vector<uint8_t>& out) -> void {
+  do {
+    auto b = static_cast<uint8_t>(value & 0x7f);
+    value >>= 7;
+    out.push_back(value != 0 ? b | 0x80 : b);
+  } while (value != 0);
+}
+
+static auto encode_s(int64_t value, std::vector<uint8_t>& out) -> void {
+  while (true) {
+    auto b = static_cast<uint8_t>(value & 0x7f);
+    value >>= 7;
+    auto done = (value == 0 && (b & 0x40) == 0) || (value == -1 && (b & 0x40) != 0);
+    out.push_back(done ? b : b | 0x80);
+    if (done) { break; }
+  }
+}
+
+// 60% one-byte, 30% two-byte, 10% anything
+static auto random_magnitude(std::mt19937_64& rng, int bits) -> uint64_t {
+  auto kind = std::uniform_int_distribution<int>{0, 9}(rng);
+  auto max_bits = kind < 6 ? 7 : kind < 9 ? 14 : bits;
+  return rng() & ((max_bits == 64) ? ~uint64_t{0} : (uint64_t{1} << max_bits) - 1);
+}
+
+template<typename F>
+static auto run(std::string_view label, const std::vector<uint8_t>& bytes, long count, F decode_all) -> void {
+  constexpr auto k_reps = 20;
+  auto best = std::chrono::duration<double>::max();
+  auto checksum = uint64_t{0};
+  for (auto rep = 0; rep != k_reps; ++rep) {
+    auto start = std::chrono::steady_clock::now();
+    checksum += decode_all();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, std::chrono::duration<double>(elapsed));
+  }
+  std::cout << absl::StreamFormat("  %-36s %8.1f MB/s  %6.2f ns/value  (checksum %x)\n",
+                                  label, bytes.size() / best.count() / 1e6, best.count() / count * 1e9,
+                                  checksum);
+}
+
+}  // namespace wasmtoolbox
+
+auto main() -> int {
+  using namespace wasmtoolbox;
+
+  constexpr auto k_count = long{1'000'000};
+  auto rng = std::mt19937_64{42};
+
+  auto u32_bytes = std::vector<uint8_t>{};
+  auto i64_bytes = std::vector<uint8_t>{};
+  for (auto i = long{0}; i != k_count; ++i) {
+    encode_u(random_magnitude(rng, 32), u32_bytes);
+    auto magnitude = static_cast<int64_t>(random_magnitude(rng, 63));
+    encode_s((rng() & 1) != 0 ? magnitude : -magnitude, i64_bytes);
+  }
+
+  auto bench = [&](std::string_view title, const std::vector<uint8_t>& bytes,
+                   auto parse_slow, auto parse_fast) {
+    std::cout << absl::StreamFormat("%s (%d values, %d bytes)\n", title, k_count, bytes.size());
+    run("stream source, byte at a time", bytes, k_count, [&] {
+      auto is = std::istringstream{std::string{bytes.begin(), bytes.end()}};
+      auto parser = Wasm_parser{is};
+      auto sum = uint64_t{0};
+      for (auto i = long{0}; i != k_count; ++i) { sum += parse_slow(parser); }
+      return sum;
+    });
+    run("buffer source, byte at a time", bytes, k_count, [&] {
+      auto parser = Wasm_parser{std::span{bytes}};
+      auto sum = uint64_t{0};
+      for (auto i = long{0}; i != k_count; ++i) { sum += parse_slow(parser); }
+      return sum;
+    });
+    run("buffer source, word at a time", bytes, k_count, [&] {
+      auto parser = Wasm_parser{std::span{bytes}};
+      auto sum = uint64_t{0};
+      for (auto i = long{0}; i != k_count; ++i) { sum += parse_fast(parser); }
+      return sum;
+    });
+  };
+
+  bench("u32", u32_bytes,
+        [](auto& parser) { return parser.internal_parse_uN(32); },
+        [](auto& parser) { return uint64_t{parser.parse_u32()}; });
+  bench("i64", i64_bytes,
+        [](auto& parser) { return static_cast<uint64_t>(parser.internal_parse_sN(64)); },
+        [](auto& parser) { return static_cast<uint64_t>(parser.parse_i64()); });
+
+  // Function sections: mostly small typeidxs
+  auto typeidx_bytes = std::vector<uint8_t>{};
+  for (auto i = long{0}; i != k_count; ++i) {
+    auto kind = std::uniform_int_distribution<int>{0, 99}(rng);
+    encode_u(kind < 97 ? rng() % 100 : rng() % 5000, typeidx_bytes);
+  }
+  auto typeidxs = std::vector<uint32_t>(k_count);
+  std::cout << absl::StreamFormat("vec(typeidx) (%d values, %d bytes)\n", k_count, typeidx_bytes.size());
+  run("parse_u32 loop", typeidx_bytes, k_count, [&] {
+    auto parser = Wasm_parser{std::span{typeidx_bytes}};
+    for (auto i = long{0}; i != k_count; ++i) { typeidxs[i] = parser.parse_u32(); }
+    return uint64_t{typeidxs.back()};
+  });
+  auto bench_bulk = [&](std::string_view label, auto decoder) {
+    run(label, typeidx_bytes, k_count, [&] {
+      auto [n, size] = decoder(typeidx_bytes.data(), typeidx_bytes.data() + typeidx_bytes.size(),
+                               typeidxs.data(), k_count);
+      return uint64_t{n + size + typeidxs.back()};
+    });
+  };
+  bench_bulk("bulk, scalar", leb128_simd_internal::bulk_decode_u32_scalar);
+#if defined(__x86_64__)
+  bench_bulk("bulk, SSE2", leb128_simd_internal::bulk_decode_u32_sse2);
+  if (leb128_simd_internal::cpu_has_avx2()) {
+    bench_bulk("bulk, AVX2", leb128_simd_internal::bulk_decode_u32_avx2);
+  }
+#endif
+
+  return 0;
+}
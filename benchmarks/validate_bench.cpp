@@ -0,0 +1,134 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Benchmark for the cost of validating function bodies as they're decoded (Parse_options::validate).
+//
+// Parses a module with and without validation, on one thread and on several, and reports the throughput in
+// MB/s of module bytes.  The module is the one given on the command line, or else a synthetic one whose
+// function bodies mix locals, arithmetic, conversions, memory accesses and small blocks.
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_format.h"
+
+#include "mapped_file.h"
+#include "parser.h"
+
+namespace wasmtoolbox {
+
+static auto encode_u(uint64_t value, std::vector<uint8_t>& out) -> void {
+  do {
+    auto b = static_cast<uint8_t>(value & 0x7f);
+    value >>= 7;
+    out.push_back(value != 0 ? b | 0x80 : b);
+  } while (value != 0);
+}
+
+static auto append_section(std::vector<uint8_t>& out, uint8_t id, const std::vector<uint8_t>& contents) -> void {
+  out.push_back(id);
+  encode_u(contents.size(), out);
+  out.insert(out.end(), contents.begin(), contents.end());
+}
+
+// num_funcs functions of type [i32 i32] -> [i32], with locals 2-5 of type i32 and 6-7 of type i64
+static auto synthetic_module(uint32_t num_funcs, int segments_per_func) -> std::vector<uint8_t> {
+  static const auto k_segment = std::vector<uint8_t>{
+    0x20, 0x00, 0x20, 0x01, 0x6a, 0x21, 0x02,                          // local 2 = local 0 + local 1
+    0x20, 0x02, 0x41, 0x04, 0x6c, 0x28, 0x02, 0x08, 0x22, 0x03, 0x1a,  // local 3 = i32.load offset=8 (local 2 * 4)
+    0x20, 0x03, 0xac, 0x42, 0xe4, 0x00, 0x7e, 0x21, 0x06,              // local 6 = i64(local 3) * 100
+    0x02, 0x40, 0x20, 0x00, 0x0d, 0x00, 0x20, 0x06, 0x50, 0x1a, 0x0b,  // block (br_if 0 (local 0)) ... end
+    0x20, 0x02, 0xb2, 0x43, 0x00, 0x00, 0xc0, 0x3f, 0x94, 0xa8, 0x21, 0x05,  // local 5 = i32(f32(local 2) * 1.5)
+    0x41, 0x00, 0x20, 0x05, 0x36, 0x02, 0x00,                          // i32.store 0 (local 5)
+    0x20, 0x00, 0x04, 0x7f, 0x20, 0x01, 0x05, 0x41, 0x07, 0x0b, 0x21, 0x02,  // local 2 = local 0 ? local 1 : 7
+  };
+
+  auto module = std::vector<uint8_t>{0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00};
+  append_section(module, k_section_type, {0x01, 0x60, 0x02, 0x7f, 0x7f, 0x01, 0x7f});
+  auto funcsec = std::vector<uint8_t>{};
+  encode_u(num_funcs, funcsec);
+  funcsec.insert(funcsec.end(), num_funcs, 0x00);
+  append_section(module, k_section_function, funcsec);
+  append_section(module, k_section_memory, {0x01, 0x00, 0x01});
+
+  auto body = std::vector<uint8_t>{0x02, 0x04, 0x7f, 0x02, 0x7e};
+  for (auto i = 0; i != segments_per_func; ++i) { body.insert(body.end(), k_segment.begin(), k_segment.end()); }
+  body.insert(body.end(), {0x20, 0x02, 0x0b});
+  auto codesec = std::vector<uint8_t>{};
+  encode_u(num_funcs, codesec);
+  for (auto i = uint32_t{0}; i != num_funcs; ++i) {
+    encode_u(body.size(), codesec);
+    codesec.insert(codesec.end(), body.begin(), body.end());
+  }
+  append_section(module, k_section_code, codesec);
+  return module;
+}
+
+static auto run(std::string_view label, std::span<const uint8_t> bytes, Parse_options options) -> void {
+  constexpr auto k_reps = 10;
+  auto best = std::chrono::duration<double>::max();
+  auto num_instrs = size_t{0};
+  for (auto rep = 0; rep != k_reps; ++rep) {
+    auto start = std::chrono::steady_clock::now();
+    auto result = try_parse_wasm(bytes, options);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    if (not result) {
+      std::cout << absl::StreamFormat("  %-36s %s\n", label, result.error().message());
+      return;
+    }
+    best = std::min(best, std::chrono::duration<double>(elapsed));
+    num_instrs = 0;
+    for (const auto& code : result->codes) { num_instrs += code.func->body.size(); }
+  }
+  std::cout << absl::StreamFormat("  %-36s %8.1f MB/s  %6.2f ns/instr\n",
+                                  label, bytes.size() / best.count() / 1e6, best.count() / num_instrs * 1e9);
+}
+
+}  // namespace wasmtoolbox
+
+auto main(int argc, char** argv) -> int {
+  using namespace wasmtoolbox;
+
+  auto mapped = std::optional<Mapped_file>{};
+  auto synthetic = std::vector<uint8_t>{};
+  auto bytes = std::span<const uint8_t>{};
+  if (argc > 1) {
+    mapped = Mapped_file::map(argv[1]);
+    if (not mapped) {
+      std::cerr << absl::StreamFormat("Error: could not map file %s\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+    bytes = mapped->bytes();
+  } else {
+    synthetic = synthetic_module(20'000, 8);
+    bytes = synthetic;
+  }
+
+  auto num_threads = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+  std::cout << absl::StreamFormat("%s (%d bytes)\n", argc > 1 ? argv[1] : "synthetic module", bytes.size());
+  run("decode only, 1 thread", bytes, {});
+  run("decode + validate, 1 thread", bytes, {.validate = true});
+  if (num_threads > 1) {
+    run(absl::StrFormat("decode only, %d threads", num_threads), bytes, {.num_threads = num_threads});
+    run(absl::StrFormat("decode + validate, %d threads", num_threads), bytes,
+        {.num_threads = num_threads, .validate = true});
+  }
+
+  return 0;
+}
@@ -0,0 +1,194 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Benchmark for printing modules in the text format (what wasm2wat spends its time on once parsing is done).
+//
+// Prints a module to /dev/null through a file descriptor and through a std::ostream, serially and on several
+// threads (write_module_in_parallel), and reports the throughput in MB/s of text.  The module is the one given
+// on the command line, or else a synthetic one.  Also prints a multi-megabyte string, like a data segment's
+// contents, and a million identifiers like those from a name section, to time tok_string() and tok_id() on
+// their own.
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_format.h"
+
+#include "mapped_file.h"
+#include "output_sink.h"
+#include "parallel_write.h"
+#include "parser.h"
+#include "text_format.h"
+
+namespace wasmtoolbox {
+
+static auto encode_u(uint64_t value, std::vector<uint8_t>& out) -> void {
+  do {
+    auto b = static_cast<uint8_t>(value & 0x7f);
+    value >>= 7;
+    out.push_back(value != 0 ? b | 0x80 : b);
+  } while (value != 0);
+}
+
+static auto append_section(std::vector<uint8_t>& out, uint8_t id, const std::vector<uint8_t>& contents) -> void {
+  out.push_back(id);
+  encode_u(contents.size(), out);
+  out.insert(out.end(), contents.begin(), contents.end());
+}
+
+// num_funcs functions of type [i32 i32] -> [i32] with a few locals, whose bodies mix the common kinds of
+// immediates (indices, constants, memargs, blocktypes)
+static auto synthetic_module(uint32_t num_funcs, int segments_per_func) -> std::vector<uint8_t> {
+  static const auto k_segment = std::vector<uint8_t>{
+    0x20, 0x00, 0x20, 0x01, 0x6a, 0x21, 0x02,                          // local 2 = local 0 + local 1
+    0x20, 0x02, 0x41, 0x04, 0x6c, 0x28, 0x02, 0x08, 0x22, 0x03, 0x1a,  // local 3 = i32.load offset=8 (local 2 * 4)
+    0x20, 0x03, 0xac, 0x42, 0xe4, 0x00, 0x7e, 0x21, 0x06,              // local 6 = i64(local 3) * 100
+    0x02, 0x40, 0x20, 0x00, 0x0d, 0x00, 0x20, 0x06, 0x50, 0x1a, 0x0b,  // block (br_if 0 (local 0)) ... end
+    0x20, 0x02, 0xb2, 0x43, 0x00, 0x00, 0xc0, 0x3f, 0x94, 0xa8, 0x21, 0x05,  // local 5 = i32(f32(local 2) * 1.5)
+    0x41, 0x00, 0x20, 0x05, 0x36, 0x02, 0x00,                          // i32.store 0 (local 5)
+    0x20, 0x00, 0x04, 0x7f, 0x20, 0x01, 0x05, 0x41, 0x07, 0x0b, 0x21, 0x02,  // local 2 = local 0 ? local 1 : 7
+  };
+
+  auto module = std::vector<uint8_t>{0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00};
+  append_section(module, k_section_type, {0x01, 0x60, 0x02, 0x7f, 0x7f, 0x01, 0x7f});
+  auto funcsec = std::vector<uint8_t>{};
+  encode_u(num_funcs, funcsec);
+  funcsec.insert(funcsec.end(), num_funcs, 0x00);
+  append_section(module, k_section_function, funcsec);
+  append_section(module, k_section_memory, {0x01, 0x00, 0x01});
+
+  auto body = std::vector<uint8_t>{0x02, 0x04, 0x7f, 0x02, 0x7e};
+  for (auto i = 0; i != segments_per_func; ++i) { body.insert(body.end(), k_segment.begin(), k_segment.end()); }
+  body.insert(body.end(), {0x20, 0x02, 0x0b});
+  auto codesec = std::vector<uint8_t>{};
+  encode_u(num_funcs, codesec);
+  for (auto i = uint32_t{0}; i != num_funcs; ++i) {
+    encode_u(body.size(), codesec);
+    codesec.insert(codesec.end(), body.begin(), body.end());
+  }
+  append_section(module, k_section_code, codesec);
+  return module;
+}
+
+// `print` writes the module somewhere and returns how many bytes of text that was
+static auto run(std::string_view label, const std::function<size_t()>& print) -> void {
+  constexpr auto k_reps = 5;
+  auto best = std::chrono::duration<double>::max();
+  auto size = size_t{0};
+  for (auto rep = 0; rep != k_reps; ++rep) {
+    auto start = std::chrono::steady_clock::now();
+    size = print();
+    best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start));
+  }
+  std::cout << absl::StreamFormat("  %-36s %8.1f MB/s  (%d bytes of text)\n", label, size / best.count() / 1e6, size);
+}
+
+}  // namespace wasmtoolbox
+
+auto main(int argc, char** argv) -> int {
+  using namespace wasmtoolbox;
+
+  auto mapped = std::optional<Mapped_file>{};
+  auto synthetic = std::vector<uint8_t>{};
+  auto bytes = std::span<const uint8_t>{};
+  if (argc > 1) {
+    mapped = Mapped_file::map(argv[1]);
+    if (not mapped) {
+      std::cerr << absl::StreamFormat("Error: could not map file %s\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+    bytes = mapped->bytes();
+  } else {
+    synthetic = synthetic_module(20'000, 8);
+    bytes = synthetic;
+  }
+  auto module = parse_wasm(bytes);
+  std::cout << absl::StreamFormat("%s (%d bytes)\n", argc > 1 ? argv[1] : "synthetic module", bytes.size());
+
+  auto fd = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+  auto dev_null = std::ofstream{"/dev/null"};
+  auto text_size = [&] {
+    auto os = std::ostringstream{};
+    Text_format_writer{os}.write_module(module);
+    return os.str().size();
+  }();
+  run("file descriptor", [&] {
+    auto out = Output_sink{fd};
+    Text_format_writer{out}.write_module(module);
+    return text_size;
+  });
+  run("std::ostream", [&] {
+    Text_format_writer{dev_null}.write_module(module);
+    return text_size;
+  });
+  auto num_threads = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+  if (num_threads > 1) {
+    run(absl::StrFormat("file descriptor, %d threads", num_threads), [&] {
+      auto out = Output_sink{fd};
+      write_module_in_parallel(out, module, num_threads);
+      return text_size;
+    });
+  }
+
+  // Mostly text, with a line break every 64 bytes and a run of binary every 1000 or so
+  auto data = std::string{};
+  for (auto i = 0; data.size() < 4'000'000; ++i) {
+    data += "The quick brown fox jumps over the lazy dog, 0123456789 times.\n";
+    if (i % 16 == 0) { data += std::string_view{"\x00\x01\xfe\xff", 4}; }
+  }
+  auto string_size = [&] {
+    auto text = std::string{};
+    {
+      auto out = Output_sink{text};
+      auto w = Text_format_writer{out};
+      w.tok_string(data);
+    }
+    return text.size();
+  }();
+  run("tok_string, 4 MB", [&] {
+    auto out = Output_sink{fd};
+    auto w = Text_format_writer{out};
+    w.tok_string(data);
+    return string_size;
+  });
+
+  // Mangled C++ names and short ones, as in the function and local names of a name section
+  auto ids = std::vector<std::string>{};
+  for (auto i = 0; i != 1'000'000; ++i) {
+    ids.push_back(i % 2 == 0 ? absl::StrFormat("_ZN10wasmtoolbox11Wasm_parserINS_17Span_byte_sourceEE%dEv", i)
+                             : absl::StrFormat("var%d", i));
+  }
+  auto ids_size = size_t{0};
+  for (const auto& id : ids) { ids_size += id.size() + 2; }
+  run("tok_id, 1M names", [&] {
+    auto out = Output_sink{fd};
+    auto w = Text_format_writer{out};
+    for (const auto& id : ids) { w.tok_id(id); }
+    return ids_size;
+  });
+  ::close(fd);
+
+  return 0;
+}
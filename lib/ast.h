@@ -17,11 +17,24 @@
 #ifndef WASMTOOLBOX_AST_H
 #define WASMTOOLBOX_AST_H
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
 #include <iostream>
-#include <string>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
 #include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
+#include "string_interner.h"
+
 namespace wasmtoolbox {
 
 // The structure of the AST closely follows the structure of the WebAssembly spec + a few extensions:
@@ -51,7 +64,7 @@ struct Ast_TODO {};  // A node on the AST that we don't deal with yet
 // It would be cleaner to define separate enum classes and use a std::variant to join them
 // up in valtype, but for now, that feels like overkill
 
-enum Ast_valtype {
+enum Ast_valtype : uint8_t {
   // 2.3.1 Number Types
   k_numtype_i32,
   k_numtype_i64,
@@ -68,38 +81,355 @@ enum Ast_valtype {
 using Ast_numtype = Ast_valtype;
 using Ast_vectype = Ast_valtype;
 using Ast_reftype = Ast_valtype;
+static_assert(sizeof(Ast_valtype) == 1);
 
 /// 2.3.5 Result Types
-using Ast_resulttype = std::vector<Ast_valtype>;
+using Ast_resulttype = std::span<const Ast_valtype>;
 
 // 2.3.6 Function Types
+//
+// A view: the valtypes themselves live elsewhere, usually in an Ast_type_table
 struct Ast_functype {
   Ast_resulttype params{};
   Ast_resulttype results{};
 };
 
+inline auto operator==(Ast_functype a, Ast_functype b) -> bool {
+  auto same = [](Ast_resulttype x, Ast_resulttype y) {
+    return x.size() == y.size() && (x.empty() || std::memcmp(x.data(), y.data(), x.size()) == 0);
+  };
+  return same(a.params, b.params) && same(a.results, b.results);
+}
+
+// 2.3.7 Limits (including the shared flag of the threads extension)
+struct Ast_limits {
+  uint32_t min = 0;
+  std::optional<uint32_t> max{};
+  bool shared = false;
+};
+
+// 2.3.8 Memory Types
+using Ast_memtype = Ast_limits;
+
+// 2.3.9 Table Types
+struct Ast_tabletype {
+  Ast_reftype et = k_reftype_funcref;
+  Ast_limits limits{};
+};
+
+// 2.3.10 Global Types
+enum class Ast_mut : uint8_t {
+  k_const,
+  k_var
+};
+
+struct Ast_globaltype {
+  Ast_valtype t = k_numtype_i32;
+  Ast_mut mut = Ast_mut::k_const;
+};
+
+// 2.4 Instructions
+// ================
+//
+// Function bodies are decoded into a flat array of fixed-size records, one per instruction (including the
+// `end`s and `else`s that delimit blocks), so that passes over a body are linear walks over memory.
+// Immediates are packed into a and b, depending on the opcode (see the k_instr_* constants in parser.h):
+//
+//   block, loop, try            a = blocktype (see below), b = index of the matching end (or delegate)
+//   if                          same, plus subopcode = index of the else, or 0 if there is none
+//   else                        a = index of the if, b = index of the matching end
+//   end                         a = index of the instruction that opened the block, or k_no_instr for the
+//                               end of the function (or constant expression)
+//   br, br_if, rethrow, delegate  a = labelidx
+//   br_table                    a = offset of the labels in Ast_func::br_table_labels, b = number of labels
+//                               (the default one included, last)
+//   select t*                   a = offset of the valtypes in Ast_func::br_table_labels, b = number of them
+//   throw, catch                a = tagidx
+//   call                        a = funcidx
+//   call_indirect               a = typeidx, b = tableidx
+//   local.*, global.*           a = localidx or globalidx
+//   loads, stores, atomics      a = align, b = offset
+//   i32.const, f32.const        a = value (bit pattern)
+//   i64.const, f64.const        a = low 32 bits, b = high 32 bits (see imm64())
+//   memory.init, data.drop      a = dataidx
+//   v128.const, i8x16.shuffle   a = index of the 16 bytes of immediates in Ast_func::v128_imms
+//   *.extract_lane, ...         lane = laneidx
+//   v128.load8_lane, ...        a = align, b = offset, lane = laneidx
+//
+// Instructions after a 0xfc, 0xfd or 0xfe prefix byte have their secondary opcode in subopcode.
+struct Ast_instr {
+  uint8_t opcode;
+  uint8_t lane = 0;  // fits in what would otherwise be padding
+  uint32_t subopcode = 0;
+  uint32_t a = 0;
+  uint32_t b = 0;
+
+  auto imm64() const -> uint64_t { return (uint64_t{b} << 32) | a; }
+};
+static_assert(sizeof(Ast_instr) == 16);
+
+constexpr auto k_no_instr = uint32_t{0xffffffff};
+
+// Blocktypes of block, loop, if and try (Ast_instr::a): a typeidx, or one of these
+constexpr auto k_blocktype_empty = uint32_t{0xffffffff};
+constexpr auto k_blocktype_valtype = uint32_t{0xffffff00};  // | Ast_valtype
+
+// 2.4.3 Vector Instructions: the bytes of a v128.const (little-endian) or the lane indices of an i8x16.shuffle
+using Ast_v128 = std::array<uint8_t, 16>;
+
+// 2.4.7 Memory Instructions
+struct Ast_memarg {
+  uint32_t align;
+  uint32_t offset;
+};
+
 // 2.5 Modules
 // ===========
 
+// Names (imports, name section, ...) point into the input if it's a buffer, or else into
+// Ast_module::interned_names.  Either way, each distinct name is stored once.
+using Ast_name = std::string_view;
+
 // Ast_module definition below to allow referring to module component types
 
 // 2.5.1 Indices
 using Ast_typeidx = uint32_t;
 using Ast_funcidx = uint32_t;
+using Ast_tableidx = uint32_t;
+using Ast_memidx = uint32_t;
+using Ast_globalidx = uint32_t;
+using Ast_tagidx = uint32_t;
+using Ast_elemidx = uint32_t;
+using Ast_dataidx = uint32_t;
 using Ast_localidx = uint32_t;
+using Ast_labelidx = uint32_t;
+
+enum class Ast_index_space : uint8_t {
+  k_type,
+  k_func,
+  k_table,
+  k_mem,
+  k_global,
+  k_tag,
+  k_elem,
+  k_data,
+  k_local,
+  k_label
+};
+
+// 2.5.2 Types
+//
+// All of a module's function types, flattened: the valtypes of every type (params, then results) back to back
+// in a single pool, and where each type starts in it.
+//
+// Types are also hash-consed as they're added: each one gets a canonical signature id, shared by all types
+// with the same params and results, so that comparing types is comparing integers.
+class Ast_type_table {
+ public:
+  Ast_type_table() = default;
+  explicit Ast_type_table(std::pmr::memory_resource* resource)
+      : entries_{resource}, valtypes_{resource}, signatures_{resource} {}
+
+  auto size() const -> size_t { return entries_.size(); }
+  auto empty() const -> bool { return entries_.empty(); }
+  auto operator[](Ast_typeidx typeidx) const -> Ast_functype {
+    const auto& entry = entries_[typeidx];
+    auto valtypes = std::span{valtypes_}.subspan(entry.offset, entry.num_params + entry.num_results);
+    return {valtypes.first(entry.num_params), valtypes.subspan(entry.num_params)};
+  }
+
+  auto add(Ast_functype functype) -> Ast_typeidx {
+    auto typeidx = static_cast<Ast_typeidx>(entries_.size());
+    auto& entry = entries_.emplace_back(Entry{
+        .offset = static_cast<uint32_t>(valtypes_.size()),
+        .num_params = static_cast<uint32_t>(functype.params.size()),
+        .num_results = static_cast<uint32_t>(functype.results.size()),
+        .signature_id = num_signatures_});
+    valtypes_.insert(valtypes_.end(), functype.params.begin(), functype.params.end());
+    valtypes_.insert(valtypes_.end(), functype.results.begin(), functype.results.end());
+
+    // The table maps hashes to the first type with each signature.  Collisions are settled with a memcmp.
+    auto hash = hash_type(entry);
+    auto [first, last] = signatures_.equal_range(hash);
+    for (auto it = first; it != last; ++it) {
+      if (same_valtypes(entry, entries_[it->second])) {
+        entry.signature_id = entries_[it->second].signature_id;
+        return typeidx;
+      }
+    }
+    signatures_.emplace(hash, typeidx);
+    ++num_signatures_;
+    return typeidx;
+  }
+  auto add(std::initializer_list<Ast_valtype> params, std::initializer_list<Ast_valtype> results) -> Ast_typeidx {
+    return add({{params.begin(), params.size()}, {results.begin(), results.size()}});
+  }
+
+  // Dense ids, numbered in order of first appearance
+  auto signature_id(Ast_typeidx typeidx) const -> uint32_t { return entries_[typeidx].signature_id; }
+  auto num_signatures() const -> uint32_t { return num_signatures_; }
+
+  // Same as `(*this)[a] == (*this)[b]`
+  auto same_type(Ast_typeidx a, Ast_typeidx b) const -> bool { return signature_id(a) == signature_id(b); }
+
+ private:
+  struct Entry {
+    uint32_t offset;  // in valtypes_
+    uint32_t num_params;
+    uint32_t num_results;
+    uint32_t signature_id;
+  };
+
+  auto valtype_bytes(const Entry& entry) const -> std::string_view {
+    return {reinterpret_cast<const char*>(valtypes_.data()) + entry.offset, entry.num_params + entry.num_results};
+  }
+  auto hash_type(const Entry& entry) const -> size_t {
+    return std::hash<std::string_view>{}(valtype_bytes(entry)) ^ (entry.num_params * 0x9e3779b97f4a7c15);
+  }
+  auto same_valtypes(const Entry& x, const Entry& y) const -> bool {
+    auto size = x.num_params + x.num_results;
+    return x.num_params == y.num_params && x.num_results == y.num_results
+        && (size == 0 || std::memcmp(&valtypes_[x.offset], &valtypes_[y.offset], size) == 0);
+  }
+
+  std::pmr::vector<Entry> entries_{};
+  std::pmr::vector<Ast_valtype> valtypes_{};
+  std::pmr::unordered_multimap<size_t, Ast_typeidx> signatures_{};  // hash -> first type with that signature
+  uint32_t num_signatures_ = 0;
+};
+
+// 2.5.3 Functions
+struct Ast_locals {
+  uint32_t n;
+  Ast_valtype t;
+};
+
+struct Ast_func {
+  std::pmr::vector<Ast_locals> locals{};
+  std::pmr::vector<Ast_instr> body{};            // ends with the function's `end`
+  std::pmr::vector<uint32_t> br_table_labels{};  // side pool for br_table labels and select t* valtypes
+  std::pmr::vector<Ast_v128> v128_imms{};        // side pool for v128.const and i8x16.shuffle immediates
+};
+
+// A function's entry in the code section (5.5.13)
+struct Ast_code {
+  long offset;                        // of the function in the input, just past its size
+  uint32_t size;
+  std::optional<Ast_func> func{};     // decoded function, unless parsed with lazy_function_bodies...
+  std::span<const uint8_t> body{};    // ...in which case, its undecoded bytes
+};
+
+// 2.5.6 Globals
+struct Ast_global {
+  Ast_globaltype type{};
+  // TODO: init
+};
+
+// 2.5.7 Element Segments
+struct Ast_elem {
+  Ast_reftype type = k_reftype_funcref;
+  // TODO: init, mode
+};
+
+// 2.5.8 Data Segments
+enum class Ast_datamode : uint8_t {
+  k_passive,
+  k_active
+};
+
+// Spans point into the input if it's a buffer, or into the module's arena otherwise
+struct Ast_data {
+  std::span<const uint8_t> init{};
+  Ast_datamode mode = Ast_datamode::k_passive;
+  Ast_memidx memory = 0;              // active only
+  std::span<const uint8_t> offset{};  // active only: the constant expression, undecoded (`end` included)
+};
+
+// [EXTRA] Tags (2.5.10 in Exception Handling Spec)
+struct Ast_tag {
+  Ast_typeidx type = 0;
+};
 
 // 2.5.11 Imports
+enum class Ast_externkind : uint8_t {  // same values as in the binary format
+  k_func,
+  k_table,
+  k_mem,
+  k_global,
+  k_tag
+};
+
+struct Ast_importdesc {
+  Ast_externkind kind = Ast_externkind::k_func;
+  Ast_typeidx typeidx = 0;  // func, tag
+  Ast_tabletype table{};    // table
+  Ast_memtype mem{};        // mem
+  Ast_globaltype global{};  // global
+};
+
 struct Ast_import {
-  std::string module;
-  std::string name;
-  // TODO: importdesc
+  Ast_name module;
+  Ast_name name;
+  Ast_importdesc desc{};
+};
+
+// [EXTRA] Name section (7.4.1 Name Section)
+struct Ast_nameassoc {
+  uint32_t idx;
+  Ast_name name;
+};
+using Ast_namemap = std::pmr::vector<Ast_nameassoc>;
+
+// Where all of a module's AST lives, so that building it is mostly pointer bumps and freeing it is a handful
+// of large deallocations.  Nothing is freed before the module goes away.
+//
+// Moving an arena hands over its memory, and the moved-from arena starts afresh.  Containers keep the
+// memory resource they were created with, so a module can be moved (its containers go along with the
+// memory they use) but not assigned to, which would leave the target's containers using the source's
+// memory or vice versa.  A moved-from module should only be destroyed.
+class Ast_arena {
+ public:
+  Ast_arena() { resources_.push_back(std::make_unique<std::pmr::monotonic_buffer_resource>()); }
+  Ast_arena(Ast_arena&& other) : resources_{std::move(other.resources_)} {
+    other.resources_.clear();
+    other.resources_.push_back(std::make_unique<std::pmr::monotonic_buffer_resource>());
+  }
+  auto operator=(Ast_arena&&) -> Ast_arena& = delete;
+
+  // Not thread-safe: other threads should allocate from their own resource, then hand it over with adopt()
+  auto resource() const -> std::pmr::memory_resource* { return resources_.front().get(); }
+  auto allocate_bytes(size_t size) -> uint8_t* { return static_cast<uint8_t*>(resource()->allocate(size, 1)); }
+  auto adopt(std::unique_ptr<std::pmr::monotonic_buffer_resource> resource) -> void {
+    resources_.push_back(std::move(resource));
+  }
+
+ private:
+  std::vector<std::unique_ptr<std::pmr::monotonic_buffer_resource>> resources_{};
 };
 
 // -- module --
 struct Ast_module {
-  std::optional<std::string> name{};
-  std::vector<Ast_functype> types{};
-  std::vector<Ast_import> imports{};
+  Ast_arena arena{};  // first, so that it outlives everything below
+
+  std::optional<Ast_name> name{};
+  Ast_type_table types{arena.resource()};
+  std::pmr::vector<Ast_import> imports{arena.resource()};
+  std::pmr::vector<Ast_typeidx> func_types{arena.resource()};  // one per function defined (not imported)
+  std::pmr::vector<Ast_tabletype> tables{arena.resource()};    // ditto for all of these
+  std::pmr::vector<Ast_memtype> mems{arena.resource()};
+  std::pmr::vector<Ast_tag> tags{arena.resource()};
+  std::pmr::vector<Ast_global> globals{arena.resource()};
+  std::pmr::vector<Ast_elem> elems{arena.resource()};
+  std::optional<uint32_t> data_count{};
+  std::pmr::vector<Ast_code> codes{arena.resource()};          // one per function defined (not imported)
+  std::pmr::vector<Ast_data> datas{arena.resource()};
+
+  // From the name section, if any
+  Ast_namemap func_names{arena.resource()};
+  Ast_namemap global_names{arena.resource()};
+  Ast_namemap data_names{arena.resource()};
+
+  String_interner interned_names{arena.resource()};
 };
 
 }  // namespace wasmtoolbox
@@ -0,0 +1,166 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WASMTOOLBOX_BYTE_SOURCE_H
+#define WASMTOOLBOX_BYTE_SOURCE_H
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace wasmtoolbox {
+
+// Where Wasm_parser gets its bytes from.
+//
+// A source always has a current byte that can be peeked at without consuming it.  Sources over contiguous
+// memory (k_contiguous = true) additionally expose the unread bytes directly, so that the parser can check
+// for the end of input once per LEB128 number or vector instead of once per byte.
+//
+// Reading can be bounded to a prefix of the remaining input (e.g., a section's declared size): past the
+// bound, the source behaves exactly as if it had reached the end of input.  Bounds nest.
+template<typename T>
+concept Byte_source = requires(T src, const T csrc, uint8_t* dst, long count) {
+  { T::k_contiguous } -> std::convertible_to<bool>;
+  { csrc.at_eof() } -> std::same_as<bool>;
+  { csrc.peek() } -> std::same_as<uint8_t>;     // only meaningful if at_eof() is false
+  { csrc.offset() } -> std::same_as<long>;
+  { src.next() } -> std::same_as<uint8_t>;      // precondition: at_eof() is false
+  { src.skip(count) } -> std::same_as<bool>;    // false if fewer than count bytes remain
+  { src.read(dst, count) } -> std::same_as<bool>;  // ditto
+
+  { csrc.limit() } -> std::same_as<long>;          // offset of the current bound
+  { src.push_limit(count) } -> std::same_as<long>; // bound to the next count bytes, returns the previous bound
+  { src.pop_limit(count) } -> std::same_as<void>;  // restore a bound returned by push_limit()
+};
+
+// Bytes pulled one at a time from a std::istream (e.g., a pipe)
+struct Istream_byte_source {
+  static constexpr bool k_contiguous = false;
+
+  std::istream* is_;
+  uint8_t cur_byte;  // only valid if is_->eof() is false
+  long cur_offset = 0;
+  long limit_ = std::numeric_limits<long>::max();
+  std::vector<uint8_t>* tap_ = nullptr;  // if set, gets a copy of every byte consumed by next() and read()
+
+  explicit Istream_byte_source(std::istream& is) : is_{&is}, cur_byte{static_cast<uint8_t>(is.get())} {}
+
+  auto at_eof() const -> bool { return cur_offset >= limit_ || is_->eof(); }
+  auto peek() const -> uint8_t { return cur_byte; }
+  auto offset() const -> long { return cur_offset; }
+
+  auto next() -> uint8_t {
+    auto result = cur_byte;
+    if (tap_) { tap_->push_back(result); }
+    cur_byte = static_cast<uint8_t>(is_->get());
+    ++cur_offset;
+    return result;
+  }
+
+  auto skip(long count) -> bool {
+    if (count <= 0) { return true; }
+    if (count > limit_ - cur_offset || is_->eof()) { return false; }
+
+    // cur_byte has already been pulled from the stream, so we land on the last skipped byte and read it
+    // to check that it exists.  Seek there in O(1) where possible, but pipes can only read and discard.
+    if (count >= 2) {
+      if (not is_->seekg(count - 2, std::ios::cur)) {
+        is_->clear();
+        is_->ignore(count - 2);
+      }
+      if (std::istream::traits_type::eq_int_type(is_->get(), std::istream::traits_type::eof())) { return false; }
+    }
+    cur_byte = static_cast<uint8_t>(is_->get());
+    cur_offset += count;
+    return true;
+  }
+
+  auto read(uint8_t* dst, long count) -> bool {
+    if (count <= 0) { return true; }
+    if (count > limit_ - cur_offset || is_->eof()) { return false; }
+    dst[0] = cur_byte;
+    is_->read(reinterpret_cast<char*>(dst + 1), count - 1);
+    if (is_->gcount() != count - 1) { return false; }
+    if (tap_) { tap_->insert(tap_->end(), dst, dst + count); }
+    cur_byte = static_cast<uint8_t>(is_->get());
+    cur_offset += count;
+    return true;
+  }
+
+  auto limit() const -> long { return limit_; }
+  auto push_limit(long count) -> long { return std::exchange(limit_, cur_offset + count); }
+  auto pop_limit(long saved) -> void { limit_ = saved; }
+};
+
+// Bytes in contiguous memory (e.g., a memory-mapped file), walked with a raw pointer.
+// The bytes can be a piece of a larger input (see Streaming_parser), starting at base_offset within it.
+struct Span_byte_source {
+  static constexpr bool k_contiguous = true;
+
+  const uint8_t* begin_;
+  const uint8_t* next_;
+  const uint8_t* end_;
+  long base_offset_ = 0;
+
+  explicit Span_byte_source(std::span<const uint8_t> bytes, long base_offset = 0)
+      : begin_{bytes.data()}, next_{bytes.data()}, end_{bytes.data() + bytes.size()}, base_offset_{base_offset} {}
+
+  auto at_eof() const -> bool { return next_ == end_; }
+  auto peek() const -> uint8_t { return next_ != end_ ? *next_ : 0xff; }
+  auto offset() const -> long { return base_offset_ + (next_ - begin_); }
+  auto next() -> uint8_t { return *next_++; }
+
+  auto skip(long count) -> bool {
+    if (count > available()) { return false; }
+    next_ += std::max(count, 0L);
+    return true;
+  }
+
+  auto read(uint8_t* dst, long count) -> bool {
+    if (count > available()) { return false; }
+    if (count > 0) {
+      std::memcpy(dst, next_, count);
+      next_ += count;
+    }
+    return true;
+  }
+
+  auto limit() const -> long { return base_offset_ + (end_ - begin_); }
+  auto push_limit(long count) -> long {
+    auto saved = limit();
+    end_ = next_ + count;
+    return saved;
+  }
+  auto pop_limit(long saved) -> void { end_ = begin_ + (saved - base_offset_); }
+
+  // Direct access to the unread bytes (up to the current bound)
+  auto available() const -> long { return end_ - next_; }
+  auto data() const -> const uint8_t* { return next_; }
+  auto advance(long count) -> void { next_ += count; }
+};
+
+static_assert(Byte_source<Istream_byte_source>);
+static_assert(Byte_source<Span_byte_source>);
+
+}  // namespace wasmtoolbox
+
+#endif /* WASMTOOLBOX_BYTE_SOURCE_H */
@@ -0,0 +1,142 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WASMTOOLBOX_LEB128_H
+#define WASMTOOLBOX_LEB128_H
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+namespace wasmtoolbox {
+
+// Fast paths for decoding LEB128 integers (5.2.2) out of a contiguous buffer.
+//
+// Instead of looping over bytes, these load 8 (or 16) bytes at once, find the terminating byte with a
+// count-trailing-zeros over the continuation bits, and gather the 7-bit groups with a few shifts and
+// masks.  They accept exactly the encodings that Wasm_parser::internal_parse_uN/sN accept, but don't
+// diagnose the invalid ones: they just return size == 0, and the caller should fall back to the
+// byte-at-a-time decoder to get the error message.
+
+// Number of bytes that must be readable from p for fast_decode_uN/sN<N>(p)
+template<int N>
+constexpr auto k_leb128_fast_path_bytes = (N + 6) / 7 <= 8 ? 8 : 16;
+
+template<typename T>
+struct Leb128_fast_result {
+  T value;
+  int size;  // 0 => not decoded, take the slow path
+};
+
+namespace leb128_internal {
+
+inline auto load_le64(const uint8_t* p) -> uint64_t {
+  auto w = uint64_t{};
+  std::memcpy(&w, p, sizeof(w));
+  if constexpr (std::endian::native == std::endian::big) { w = __builtin_bswap64(w); }
+  return w;
+}
+
+// Packs the low 7 bits of each of the 8 bytes in w into the low 56 bits of the result
+inline auto compact7(uint64_t w) -> uint64_t {
+  w &= 0x7f7f7f7f7f7f7f7f;
+  w = ((w & 0x7f007f007f007f00) >> 1) | (w & 0x007f007f007f007f);
+  w = ((w & 0x3fff00003fff0000) >> 2) | (w & 0x00003fff00003fff);
+  w = ((w & 0x0fffffff00000000) >> 4) | (w & 0x000000000fffffff);
+  return w;
+}
+
+// Keeps only the first n bytes of w (1 <= n <= 8)
+inline auto low_bytes(uint64_t w, int n) -> uint64_t {
+  return n == 8 ? w : w & ((uint64_t{1} << (8 * n)) - 1);
+}
+
+// Finds the terminating byte and gathers the 7-bit groups of an encoding of at most L bytes.
+// Returns the raw (not sign-extended) bits, the size and the terminating byte, or size == 0.
+template<int L>
+struct Raw_leb128 {
+  uint64_t bits;
+  int size;
+  uint8_t last;
+};
+
+template<int L>
+inline auto decode_raw(const uint8_t* p) -> Raw_leb128<L> {
+  constexpr auto k_continuation_bits = uint64_t{0x8080808080808080};
+  auto w = load_le64(p);
+  auto stops = ~w & k_continuation_bits;
+  if constexpr (L <= 8) {
+    if (stops == 0) { return {0, 0, 0}; }
+    auto size = std::countr_zero(stops) / 8 + 1;
+    if (size > L) { return {0, 0, 0}; }
+    return {compact7(low_bytes(w, size)), size, static_cast<uint8_t>(w >> (8 * (size - 1)))};
+  } else {
+    if (stops != 0) {
+      auto size = std::countr_zero(stops) / 8 + 1;
+      return {compact7(low_bytes(w, size)), size, static_cast<uint8_t>(w >> (8 * (size - 1)))};
+    }
+    auto w2 = load_le64(p + 8);
+    auto stops2 = ~w2 & k_continuation_bits;
+    if (stops2 == 0) { return {0, 0, 0}; }
+    auto size2 = std::countr_zero(stops2) / 8 + 1;
+    if (8 + size2 > L) { return {0, 0, 0}; }
+    return {compact7(w) | (compact7(low_bytes(w2, size2)) << 56), 8 + size2,
+            static_cast<uint8_t>(w2 >> (8 * (size2 - 1)))};
+  }
+}
+
+}  // namespace leb128_internal
+
+// Unsigned N-bit integer (uN)
+template<int N>
+inline auto fast_decode_uN(const uint8_t* p) -> Leb128_fast_result<uint64_t> {
+  static_assert(N > 0 && N <= 64);
+  constexpr auto L = (N + 6) / 7;          // Longest valid encoding
+  constexpr auto N_last = N - 7 * (L - 1);  // Bits available in the last byte of a longest encoding
+
+  auto raw = leb128_internal::decode_raw<L>(p);
+  if (raw.size == L && N_last < 8 && raw.last >= (1 << N_last)) { return {0, 0}; }
+  return {raw.bits, raw.size};
+}
+
+// Signed N-bit integer (sN)
+template<int N>
+inline auto fast_decode_sN(const uint8_t* p) -> Leb128_fast_result<int64_t> {
+  static_assert(N > 0 && N <= 64);
+  constexpr auto L = (N + 6) / 7;
+  constexpr auto N_last = N - 7 * (L - 1);
+
+  auto raw = leb128_internal::decode_raw<L>(p);
+  if (raw.size == L && N_last < 8) {
+    if ((raw.last & 0x40) == 0) {  // positive
+      if (raw.last >= (1 << (N_last - 1))) { return {0, 0}; }
+    } else {  // negative
+      if (raw.last < (1 << 7) - (1 << (N_last - 1))) { return {0, 0}; }
+    }
+  }
+
+  // Sign-extend from the top bit of the last byte
+  auto num_bits = 7 * raw.size;
+  auto bits = raw.bits;
+  if (num_bits < 64 && (raw.last & 0x40) != 0) {
+    bits |= ~uint64_t{0} << num_bits;
+  }
+  return {static_cast<int64_t>(bits), raw.size};
+}
+
+}  // namespace wasmtoolbox
+
+#endif /* WASMTOOLBOX_LEB128_H */
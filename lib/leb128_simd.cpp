@@ -0,0 +1,149 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "leb128_simd.h"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "leb128.h"
+
+namespace wasmtoolbox {
+
+namespace leb128_simd_internal {
+
+// Decodes numbers one at a time with the word-at-a-time fast path, for as long as they start before
+// `stop` and there is room to load a whole word
+static auto decode_scalar_until(const uint8_t*& p, const uint8_t* stop, const uint8_t* end,
+                                uint32_t* out, size_t& n, size_t count) -> bool {
+  while (n != count && p < stop && end - p >= k_leb128_fast_path_bytes<32>) {
+    auto [value, size] = fast_decode_uN<32>(p);
+    if (size == 0) { return false; }
+    out[n++] = static_cast<uint32_t>(value);
+    p += size;
+  }
+  return true;
+}
+
+auto bulk_decode_u32_scalar(const uint8_t* p, const uint8_t* end, uint32_t* out, size_t count)
+    -> Leb128_bulk_result {
+  auto start = p;
+  auto n = size_t{0};
+  decode_scalar_until(p, end, end, out, n, count);
+  return {n, static_cast<size_t>(p - start)};
+}
+
+#if defined(__x86_64__)
+
+auto bulk_decode_u32_sse2(const uint8_t* p, const uint8_t* end, uint32_t* out, size_t count)
+    -> Leb128_bulk_result {
+  auto start = p;
+  auto n = size_t{0};
+  auto zero = _mm_setzero_si128();
+  while (n != count && end - p >= 16) {
+    auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    auto continuations = static_cast<uint32_t>(_mm_movemask_epi8(chunk));
+    auto singles = std::countr_zero(continuations | 0x10000);  // leading single-byte numbers
+
+    if (singles == 16 && count - n >= 16) {
+      auto lo = _mm_unpacklo_epi8(chunk, zero);
+      auto hi = _mm_unpackhi_epi8(chunk, zero);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + n +  0), _mm_unpacklo_epi16(lo, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + n +  4), _mm_unpackhi_epi16(lo, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + n +  8), _mm_unpacklo_epi16(hi, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + n + 12), _mm_unpackhi_epi16(hi, zero));
+      p += 16;
+      n += 16;
+    } else if (singles >= 8 && count - n >= 8) {
+      auto lo = _mm_unpacklo_epi8(chunk, zero);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + n + 0), _mm_unpacklo_epi16(lo, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + n + 4), _mm_unpackhi_epi16(lo, zero));
+      p += 8;
+      n += 8;
+    } else {
+      // A multi-byte number soon: decode up to and including it one at a time, then get back to SIMD
+      if (not decode_scalar_until(p, p + singles + 1, end, out, n, count)) { break; }
+    }
+  }
+  decode_scalar_until(p, end, end, out, n, count);
+  return {n, static_cast<size_t>(p - start)};
+}
+
+// Widens 8 single-byte numbers
+__attribute__((target("avx2")))
+static inline auto widen8(const uint8_t* src, uint32_t* dst) -> void {
+  auto bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_cvtepu8_epi32(bytes));
+}
+
+__attribute__((target("avx2")))
+auto bulk_decode_u32_avx2(const uint8_t* p, const uint8_t* end, uint32_t* out, size_t count)
+    -> Leb128_bulk_result {
+  auto start = p;
+  auto n = size_t{0};
+  while (n != count && end - p >= 32) {
+    auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    auto continuations = static_cast<uint32_t>(_mm256_movemask_epi8(chunk));
+    auto singles = std::countr_zero(continuations);  // 32 if there are none
+
+    if (singles == 32 && count - n >= 32) {
+      widen8(p +  0, out + n +  0);
+      widen8(p +  8, out + n +  8);
+      widen8(p + 16, out + n + 16);
+      widen8(p + 24, out + n + 24);
+      p += 32;
+      n += 32;
+    } else if (singles >= 8 && count - n >= 8) {
+      auto runs = std::min(static_cast<size_t>(singles / 8), (count - n) / 8);
+      for (auto i = size_t{0}; i != runs; ++i) {
+        widen8(p, out + n);
+        p += 8;
+        n += 8;
+      }
+    } else {
+      if (not decode_scalar_until(p, p + singles + 1, end, out, n, count)) { break; }
+    }
+  }
+  decode_scalar_until(p, end, end, out, n, count);
+  return {n, static_cast<size_t>(p - start)};
+}
+
+auto cpu_has_avx2() -> bool {
+  return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+}  // namespace leb128_simd_internal
+
+auto bulk_decode_u32(const uint8_t* p, const uint8_t* end, uint32_t* out, size_t count) -> Leb128_bulk_result {
+  using Bulk_decoder = Leb128_bulk_result (*)(const uint8_t*, const uint8_t*, uint32_t*, size_t);
+  static const auto decoder = []() -> Bulk_decoder {
+#if defined(__x86_64__)
+    if (leb128_simd_internal::cpu_has_avx2()) { return leb128_simd_internal::bulk_decode_u32_avx2; }
+    return leb128_simd_internal::bulk_decode_u32_sse2;  // SSE2 is part of the x86-64 baseline
+#else
+    return leb128_simd_internal::bulk_decode_u32_scalar;
+#endif
+  }();
+  return decoder(p, end, out, count);
+}
+
+}  // namespace wasmtoolbox
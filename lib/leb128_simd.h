@@ -0,0 +1,57 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WASMTOOLBOX_LEB128_SIMD_H
+#define WASMTOOLBOX_LEB128_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace wasmtoolbox {
+
+// Bulk decoding of vectors of u32 LEB128 numbers (e.g., vec(typeidx) in the function section).
+//
+// Decodes up to `count` consecutive numbers from [p, end) into out[0, count).  Like the fast paths in
+// leb128.h, this only handles the easy cases: it stops early at the first invalid encoding, or when it gets
+// too close to `end` to load whole words.  The caller is expected to decode the rest one at a time.
+//
+// Runs of single-byte numbers (by far the most common case for indices) are widened 16 or 32 at a time
+// with SSE2 or AVX2, picked at runtime according to what the CPU supports; everything else goes through
+// the scalar word-at-a-time decoder.
+
+struct Leb128_bulk_result {
+  size_t count;  // numbers decoded
+  size_t size;   // bytes consumed
+};
+
+auto bulk_decode_u32(const uint8_t* p, const uint8_t* end, uint32_t* out, size_t count) -> Leb128_bulk_result;
+
+// The individual implementations, exposed for testing and benchmarking
+namespace leb128_simd_internal {
+auto bulk_decode_u32_scalar(const uint8_t* p, const uint8_t* end, uint32_t* out, size_t count)
+    -> Leb128_bulk_result;
+#if defined(__x86_64__)
+auto bulk_decode_u32_sse2(const uint8_t* p, const uint8_t* end, uint32_t* out, size_t count)
+    -> Leb128_bulk_result;
+auto bulk_decode_u32_avx2(const uint8_t* p, const uint8_t* end, uint32_t* out, size_t count)
+    -> Leb128_bulk_result;
+auto cpu_has_avx2() -> bool;
+#endif
+}  // namespace leb128_simd_internal
+
+}  // namespace wasmtoolbox
+
+#endif /* WASMTOOLBOX_LEB128_SIMD_H */
@@ -0,0 +1,71 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+namespace wasmtoolbox {
+
+auto Mapped_file::map(const std::string& filename) -> std::optional<Mapped_file> {
+  auto fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) { return std::nullopt; }
+
+  struct stat st{};
+  if (::fstat(fd, &st) != 0 || not S_ISREG(st.st_mode)) {
+    ::close(fd);
+    return std::nullopt;
+  }
+
+  auto size = static_cast<size_t>(st.st_size);
+  if (size == 0) {
+    ::close(fd);
+    return Mapped_file{nullptr, 0};
+  }
+
+  auto addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);  // The mapping keeps its own reference to the file
+  if (addr == MAP_FAILED) { return std::nullopt; }
+
+  // The parser reads modules front to back exactly once, so let the kernel read ahead aggressively
+  // and drop pages behind us.  This is only a hint, so failure is harmless.
+  (void) ::madvise(addr, size, MADV_SEQUENTIAL);
+
+  return Mapped_file{addr, size};
+}
+
+Mapped_file::Mapped_file(Mapped_file&& other) noexcept
+    : addr_{std::exchange(other.addr_, nullptr)}, size_{std::exchange(other.size_, 0)} {}
+
+auto Mapped_file::operator=(Mapped_file&& other) noexcept -> Mapped_file& {
+  if (this != &other) {
+    if (addr_ != nullptr) { ::munmap(addr_, size_); }
+    addr_ = std::exchange(other.addr_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+Mapped_file::~Mapped_file() {
+  if (addr_ != nullptr) { ::munmap(addr_, size_); }
+}
+
+}  // namespace wasmtoolbox
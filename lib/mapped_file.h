@@ -0,0 +1,55 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WASMTOOLBOX_MAPPED_FILE_H
+#define WASMTOOLBOX_MAPPED_FILE_H
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace wasmtoolbox {
+
+// A read-only memory mapping of an entire file.
+//
+// Lets the parser walk the module as a plain pointer range instead of pulling every byte through
+// std::istream::get().  Only regular files can be mapped: for pipes and the like, map() returns
+// std::nullopt and callers should fall back to reading through a std::istream.
+class Mapped_file {
+ public:
+  static auto map(const std::string& filename) -> std::optional<Mapped_file>;
+
+  Mapped_file(const Mapped_file&) = delete;
+  Mapped_file(Mapped_file&& other) noexcept;
+  auto operator=(const Mapped_file&) -> Mapped_file& = delete;
+  auto operator=(Mapped_file&& other) noexcept -> Mapped_file&;
+  ~Mapped_file();
+
+  auto bytes() const -> std::span<const uint8_t> {
+    return {static_cast<const uint8_t*>(addr_), size_};
+  }
+
+ private:
+  Mapped_file(void* addr, size_t size) : addr_{addr}, size_{size} {}
+
+  void* addr_ = nullptr;  // nullptr for empty files, which can't be mmap'ed
+  size_t size_ = 0;
+};
+
+}  // namespace wasmtoolbox
+
+#endif /* WASMTOOLBOX_MAPPED_FILE_H */
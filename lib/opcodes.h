@@ -0,0 +1,767 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WASMTOOLBOX_OPCODES_H
+#define WASMTOOLBOX_OPCODES_H
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace wasmtoolbox {
+
+// 5.4 Instructions
+// ================
+//
+// Every instruction the parser knows about is listed exactly once below, as
+//
+//   X(opcode, name, mnemonic, immediates, stack effect)
+//
+// and everything else is generated from these lists: the k_instr_* opcode constants, and 256-entry lookup
+// tables for the immediates that follow each opcode (which drive decoding and skipping in the parser), the
+// mnemonics (for the text format) and the stack effects.
+//
+// Immediates are one of the Imm_kind values below.  Stack effects are written "params:results", with one
+// letter per value type (i = i32, l = i64, f = f32, d = f64, v = v128), or "*" when they depend on the
+// immediates or the context (calls, locals, control instructions, ...).
+//
+// Adding an instruction should only take a new line here, plus a new Imm_kind if its immediates are unlike
+// any existing ones.
+
+#define WASMTOOLBOX_INSTRS(X) \
+  /* 5.4.1 Control Instructions */ \
+  X(0x00, unreachable,         "unreachable",         none,       "*") \
+  X(0x01, nop,                 "nop",                 none,       ":") \
+  X(0x02, block,               "block",               block,      "*") \
+  X(0x03, loop,                "loop",                block,      "*") \
+  X(0x04, if,                  "if",                  block,      "*") \
+  X(0x05, else,                "else",                structured, "*") \
+  X(0x06, try,                 "try",                 block,      "*") \
+  X(0x07, catch,               "catch",               structured, "*") \
+  X(0x08, throw,               "throw",               u32,        "*") \
+  X(0x09, rethrow,             "rethrow",             u32,        "*") \
+  X(0x0b, end,                 "end",                 structured, "*") \
+  X(0x0c, br,                  "br",                  u32,        "*") \
+  X(0x0d, br_if,               "br_if",               u32,        "*") \
+  X(0x0e, br_table,            "br_table",            br_table,   "*") \
+  X(0x0f, return,              "return",              none,       "*") \
+  X(0x10, call,                "call",                u32,        "*") \
+  X(0x11, call_indirect,       "call_indirect",       u32_u32,    "*") \
+  X(0x18, delegate,            "delegate",            structured, "*") \
+  X(0x19, catch_all,           "catch_all",           structured, "*") \
+  /* 5.4.2 Reference Instructions */ \
+  X(0xd0, ref_null,            "ref.null",            reftype,    "*") \
+  X(0xd1, ref_is_null,         "ref.is_null",         none,       "*") \
+  X(0xd2, ref_func,            "ref.func",            u32,        "*") \
+  /* 5.4.3 Parametric Instructions */ \
+  X(0x1a, drop,                "drop",                none,       "*") \
+  X(0x1b, select,              "select",              none,       "*") \
+  X(0x1c, select_t,            "select",              select_t,   "*") \
+  /* 5.4.4 Variable Instructions */ \
+  X(0x20, local_get,           "local.get",           u32,        "*") \
+  X(0x21, local_set,           "local.set",           u32,        "*") \
+  X(0x22, local_tee,           "local.tee",           u32,        "*") \
+  X(0x23, global_get,          "global.get",          u32,        "*") \
+  X(0x24, global_set,          "global.set",          u32,        "*") \
+  /* 5.4.5 Table Instructions */ \
+  X(0x25, table_get,           "table.get",           u32,        "*") \
+  X(0x26, table_set,           "table.set",           u32,        "*") \
+  /* 5.4.6 Memory Instructions */ \
+  X(0x28, i32_load,            "i32.load",            memarg,     "i:i") \
+  X(0x29, i64_load,            "i64.load",            memarg,     "i:l") \
+  X(0x2a, f32_load,            "f32.load",            memarg,     "i:f") \
+  X(0x2b, f64_load,            "f64.load",            memarg,     "i:d") \
+  X(0x2c, i32_load8_s,         "i32.load8_s",         memarg,     "i:i") \
+  X(0x2d, i32_load8_u,         "i32.load8_u",         memarg,     "i:i") \
+  X(0x2e, i32_load16_s,        "i32.load16_s",        memarg,     "i:i") \
+  X(0x2f, i32_load16_u,        "i32.load16_u",        memarg,     "i:i") \
+  X(0x30, i64_load8_s,         "i64.load8_s",         memarg,     "i:l") \
+  X(0x31, i64_load8_u,         "i64.load8_u",         memarg,     "i:l") \
+  X(0x32, i64_load16_s,        "i64.load16_s",        memarg,     "i:l") \
+  X(0x33, i64_load16_u,        "i64.load16_u",        memarg,     "i:l") \
+  X(0x34, i64_load32_s,        "i64.load32_s",        memarg,     "i:l") \
+  X(0x35, i64_load32_u,        "i64.load32_u",        memarg,     "i:l") \
+  X(0x36, i32_store,           "i32.store",           memarg,     "ii:") \
+  X(0x37, i64_store,           "i64.store",           memarg,     "il:") \
+  X(0x38, f32_store,           "f32.store",           memarg,     "if:") \
+  X(0x39, f64_store,           "f64.store",           memarg,     "id:") \
+  X(0x3a, i32_store8,          "i32.store8",          memarg,     "ii:") \
+  X(0x3b, i32_store16,         "i32.store16",         memarg,     "ii:") \
+  X(0x3c, i64_store8,          "i64.store8",          memarg,     "il:") \
+  X(0x3d, i64_store16,         "i64.store16",         memarg,     "il:") \
+  X(0x3e, i64_store32,         "i64.store32",         memarg,     "il:") \
+  X(0x3f, memory_size,         "memory.size",         zero_byte,  ":i") \
+  X(0x40, memory_grow,         "memory.grow",         zero_byte,  "i:i") \
+  /* 5.4.7 Numeric Instructions */ \
+  X(0x41, i32_const,           "i32.const",           i32,        ":i") \
+  X(0x42, i64_const,           "i64.const",           i64,        ":l") \
+  X(0x43, f32_const,           "f32.const",           f32,        ":f") \
+  X(0x44, f64_const,           "f64.const",           f64,        ":d") \
+  \
+  X(0x45, i32_eqz,             "i32.eqz",             none,       "i:i") \
+  X(0x46, i32_eq,              "i32.eq",              none,       "ii:i") \
+  X(0x47, i32_ne,              "i32.ne",              none,       "ii:i") \
+  X(0x48, i32_lt_s,            "i32.lt_s",            none,       "ii:i") \
+  X(0x49, i32_lt_u,            "i32.lt_u",            none,       "ii:i") \
+  X(0x4a, i32_gt_s,            "i32.gt_s",            none,       "ii:i") \
+  X(0x4b, i32_gt_u,            "i32.gt_u",            none,       "ii:i") \
+  X(0x4c, i32_le_s,            "i32.le_s",            none,       "ii:i") \
+  X(0x4d, i32_le_u,            "i32.le_u",            none,       "ii:i") \
+  X(0x4e, i32_ge_s,            "i32.ge_s",            none,       "ii:i") \
+  X(0x4f, i32_ge_u,            "i32.ge_u",            none,       "ii:i") \
+  \
+  X(0x50, i64_eqz,             "i64.eqz",             none,       "l:i") \
+  X(0x51, i64_eq,              "i64.eq",              none,       "ll:i") \
+  X(0x52, i64_ne,              "i64.ne",              none,       "ll:i") \
+  X(0x53, i64_lt_s,            "i64.lt_s",            none,       "ll:i") \
+  X(0x54, i64_lt_u,            "i64.lt_u",            none,       "ll:i") \
+  X(0x55, i64_gt_s,            "i64.gt_s",            none,       "ll:i") \
+  X(0x56, i64_gt_u,            "i64.gt_u",            none,       "ll:i") \
+  X(0x57, i64_le_s,            "i64.le_s",            none,       "ll:i") \
+  X(0x58, i64_le_u,            "i64.le_u",            none,       "ll:i") \
+  X(0x59, i64_ge_s,            "i64.ge_s",            none,       "ll:i") \
+  X(0x5a, i64_ge_u,            "i64.ge_u",            none,       "ll:i") \
+  \
+  X(0x5b, f32_eq,              "f32.eq",              none,       "ff:i") \
+  X(0x5c, f32_ne,              "f32.ne",              none,       "ff:i") \
+  X(0x5d, f32_lt,              "f32.lt",              none,       "ff:i") \
+  X(0x5e, f32_gt,              "f32.gt",              none,       "ff:i") \
+  X(0x5f, f32_le,              "f32.le",              none,       "ff:i") \
+  X(0x60, f32_ge,              "f32.ge",              none,       "ff:i") \
+  \
+  X(0x61, f64_eq,              "f64.eq",              none,       "dd:i") \
+  X(0x62, f64_ne,              "f64.ne",              none,       "dd:i") \
+  X(0x63, f64_lt,              "f64.lt",              none,       "dd:i") \
+  X(0x64, f64_gt,              "f64.gt",              none,       "dd:i") \
+  X(0x65, f64_le,              "f64.le",              none,       "dd:i") \
+  X(0x66, f64_ge,              "f64.ge",              none,       "dd:i") \
+  \
+  X(0x67, i32_clz,             "i32.clz",             none,       "i:i") \
+  X(0x68, i32_ctz,             "i32.ctz",             none,       "i:i") \
+  X(0x69, i32_popcnt,          "i32.popcnt",          none,       "i:i") \
+  X(0x6a, i32_add,             "i32.add",             none,       "ii:i") \
+  X(0x6b, i32_sub,             "i32.sub",             none,       "ii:i") \
+  X(0x6c, i32_mul,             "i32.mul",             none,       "ii:i") \
+  X(0x6d, i32_div_s,           "i32.div_s",           none,       "ii:i") \
+  X(0x6e, i32_div_u,           "i32.div_u",           none,       "ii:i") \
+  X(0x6f, i32_rem_s,           "i32.rem_s",           none,       "ii:i") \
+  X(0x70, i32_rem_u,           "i32.rem_u",           none,       "ii:i") \
+  X(0x71, i32_and,             "i32.and",             none,       "ii:i") \
+  X(0x72, i32_or,              "i32.or",              none,       "ii:i") \
+  X(0x73, i32_xor,             "i32.xor",             none,       "ii:i") \
+  X(0x74, i32_shl,             "i32.shl",             none,       "ii:i") \
+  X(0x75, i32_shr_s,           "i32.shr_s",           none,       "ii:i") \
+  X(0x76, i32_shr_u,           "i32.shr_u",           none,       "ii:i") \
+  X(0x77, i32_rotl,            "i32.rotl",            none,       "ii:i") \
+  X(0x78, i32_rotr,            "i32.rotr",            none,       "ii:i") \
+  \
+  X(0x79, i64_clz,             "i64.clz",             none,       "l:l") \
+  X(0x7a, i64_ctz,             "i64.ctz",             none,       "l:l") \
+  X(0x7b, i64_popcnt,          "i64.popcnt",          none,       "l:l") \
+  X(0x7c, i64_add,             "i64.add",             none,       "ll:l") \
+  X(0x7d, i64_sub,             "i64.sub",             none,       "ll:l") \
+  X(0x7e, i64_mul,             "i64.mul",             none,       "ll:l") \
+  X(0x7f, i64_div_s,           "i64.div_s",           none,       "ll:l") \
+  X(0x80, i64_div_u,           "i64.div_u",           none,       "ll:l") \
+  X(0x81, i64_rem_s,           "i64.rem_s",           none,       "ll:l") \
+  X(0x82, i64_rem_u,           "i64.rem_u",           none,       "ll:l") \
+  X(0x83, i64_and,             "i64.and",             none,       "ll:l") \
+  X(0x84, i64_or,              "i64.or",              none,       "ll:l") \
+  X(0x85, i64_xor,             "i64.xor",             none,       "ll:l") \
+  X(0x86, i64_shl,             "i64.shl",             none,       "ll:l") \
+  X(0x87, i64_shr_s,           "i64.shr_s",           none,       "ll:l") \
+  X(0x88, i64_shr_u,           "i64.shr_u",           none,       "ll:l") \
+  X(0x89, i64_rotl,            "i64.rotl",            none,       "ll:l") \
+  X(0x8a, i64_rotr,            "i64.rotr",            none,       "ll:l") \
+  \
+  X(0x8b, f32_abs,             "f32.abs",             none,       "f:f") \
+  X(0x8c, f32_neg,             "f32.neg",             none,       "f:f") \
+  X(0x8d, f32_ceil,            "f32.ceil",            none,       "f:f") \
+  X(0x8e, f32_floor,           "f32.floor",           none,       "f:f") \
+  X(0x8f, f32_trunc,           "f32.trunc",           none,       "f:f") \
+  X(0x90, f32_nearest,         "f32.nearest",         none,       "f:f") \
+  X(0x91, f32_sqrt,            "f32.sqrt",            none,       "f:f") \
+  X(0x92, f32_add,             "f32.add",             none,       "ff:f") \
+  X(0x93, f32_sub,             "f32.sub",             none,       "ff:f") \
+  X(0x94, f32_mul,             "f32.mul",             none,       "ff:f") \
+  X(0x95, f32_div,             "f32.div",             none,       "ff:f") \
+  X(0x96, f32_min,             "f32.min",             none,       "ff:f") \
+  X(0x97, f32_max,             "f32.max",             none,       "ff:f") \
+  X(0x98, f32_copysign,        "f32.copysign",        none,       "ff:f") \
+  \
+  X(0x99, f64_abs,             "f64.abs",             none,       "d:d") \
+  X(0x9a, f64_neg,             "f64.neg",             none,       "d:d") \
+  X(0x9b, f64_ceil,            "f64.ceil",            none,       "d:d") \
+  X(0x9c, f64_floor,           "f64.floor",           none,       "d:d") \
+  X(0x9d, f64_trunc,           "f64.trunc",           none,       "d:d") \
+  X(0x9e, f64_nearest,         "f64.nearest",         none,       "d:d") \
+  X(0x9f, f64_sqrt,            "f64.sqrt",            none,       "d:d") \
+  X(0xa0, f64_add,             "f64.add",             none,       "dd:d") \
+  X(0xa1, f64_sub,             "f64.sub",             none,       "dd:d") \
+  X(0xa2, f64_mul,             "f64.mul",             none,       "dd:d") \
+  X(0xa3, f64_div,             "f64.div",             none,       "dd:d") \
+  X(0xa4, f64_min,             "f64.min",             none,       "dd:d") \
+  X(0xa5, f64_max,             "f64.max",             none,       "dd:d") \
+  X(0xa6, f64_copysign,        "f64.copysign",        none,       "dd:d") \
+  \
+  X(0xa7, i32_wrap_i64,        "i32.wrap_i64",        none,       "l:i") \
+  X(0xa8, i32_trunc_f32_s,     "i32.trunc_f32_s",     none,       "f:i") \
+  X(0xa9, i32_trunc_f32_u,     "i32.trunc_f32_u",     none,       "f:i") \
+  X(0xaa, i32_trunc_f64_s,     "i32.trunc_f64_s",     none,       "d:i") \
+  X(0xab, i32_trunc_f64_u,     "i32.trunc_f64_u",     none,       "d:i") \
+  X(0xac, i64_extend_i32_s,    "i64.extend_i32_s",    none,       "i:l") \
+  X(0xad, i64_extend_i32_u,    "i64.extend_i32_u",    none,       "i:l") \
+  X(0xae, i64_trunc_f32_s,     "i64.trunc_f32_s",     none,       "f:l") \
+  X(0xaf, i64_trunc_f32_u,     "i64.trunc_f32_u",     none,       "f:l") \
+  X(0xb0, i64_trunc_f64_s,     "i64.trunc_f64_s",     none,       "d:l") \
+  X(0xb1, i64_trunc_f64_u,     "i64.trunc_f64_u",     none,       "d:l") \
+  X(0xb2, f32_convert_i32_s,   "f32.convert_i32_s",   none,       "i:f") \
+  X(0xb3, f32_convert_i32_u,   "f32.convert_i32_u",   none,       "i:f") \
+  X(0xb4, f32_convert_i64_s,   "f32.convert_i64_s",   none,       "l:f") \
+  X(0xb5, f32_convert_i64_u,   "f32.convert_i64_u",   none,       "l:f") \
+  X(0xb6, f32_demote_f64,      "f32.demote_f64",      none,       "d:f") \
+  X(0xb7, f64_convert_i32_s,   "f64.convert_i32_s",   none,       "i:d") \
+  X(0xb8, f64_convert_i32_u,   "f64.convert_i32_u",   none,       "i:d") \
+  X(0xb9, f64_convert_i64_s,   "f64.convert_i64_s",   none,       "l:d") \
+  X(0xba, f64_convert_i64_u,   "f64.convert_i64_u",   none,       "l:d") \
+  X(0xbb, f64_promote_f32,     "f64.promote_f32",     none,       "f:d") \
+  X(0xbc, i32_reinterpret_f32, "i32.reinterpret_f32", none,       "f:i") \
+  X(0xbd, i64_reinterpret_f64, "i64.reinterpret_f64", none,       "d:l") \
+  X(0xbe, f32_reinterpret_i32, "f32.reinterpret_i32", none,       "i:f") \
+  X(0xbf, f64_reinterpret_i64, "f64.reinterpret_i64", none,       "l:d") \
+  \
+  X(0xc0, i32_extend8_s,       "i32.extend8_s",       none,       "i:i") \
+  X(0xc1, i32_extend16_s,      "i32.extend16_s",      none,       "i:i") \
+  X(0xc2, i64_extend8_s,       "i64.extend8_s",       none,       "l:l") \
+  X(0xc3, i64_extend16_s,      "i64.extend16_s",      none,       "l:l") \
+  X(0xc4, i64_extend32_s,      "i64.extend32_s",      none,       "l:l") \
+  /* Prefixes of instructions with secondary opcodes (see below) */ \
+  X(0xfc, ext_prefix,          "",                    prefix,     "*") \
+  X(0xfd, simd_prefix,         "",                    prefix,     "*") \
+  X(0xfe, atomic_prefix,       "",                    prefix,     "*")
+
+// Secondary opcodes of instructions that follow k_instr_ext_prefix = 0xfc (a u32)
+#define WASMTOOLBOX_EXT_INSTRS(X) \
+  /* 5.4.7 Numeric Instructions (non-trapping float-to-int conversions) */ \
+  X(0x00, i32_trunc_sat_f32_s, "i32.trunc_sat_f32_s", none,          "f:i") \
+  X(0x01, i32_trunc_sat_f32_u, "i32.trunc_sat_f32_u", none,          "f:i") \
+  X(0x02, i32_trunc_sat_f64_s, "i32.trunc_sat_f64_s", none,          "d:i") \
+  X(0x03, i32_trunc_sat_f64_u, "i32.trunc_sat_f64_u", none,          "d:i") \
+  X(0x04, i64_trunc_sat_f32_s, "i64.trunc_sat_f32_s", none,          "f:l") \
+  X(0x05, i64_trunc_sat_f32_u, "i64.trunc_sat_f32_u", none,          "f:l") \
+  X(0x06, i64_trunc_sat_f64_s, "i64.trunc_sat_f64_s", none,          "d:l") \
+  X(0x07, i64_trunc_sat_f64_u, "i64.trunc_sat_f64_u", none,          "d:l") \
+  /* 5.4.6 Memory Instructions */ \
+  X(0x08, memory_init,         "memory.init",         u32_zero_byte, "iii:") \
+  X(0x09, data_drop,           "data.drop",           u32,           ":") \
+  X(0x0a, memory_copy,         "memory.copy",         zero_bytes_2,  "iii:") \
+  X(0x0b, memory_fill,         "memory.fill",         zero_byte,     "iii:") \
+  /* 5.4.5 Table Instructions */ \
+  X(0x0c, table_init,          "table.init",          u32_u32,       "iii:") \
+  X(0x0d, elem_drop,           "elem.drop",           u32,           ":") \
+  X(0x0e, table_copy,          "table.copy",          u32_u32,       "iii:") \
+  X(0x0f, table_grow,          "table.grow",          u32,           "*") \
+  X(0x10, table_size,          "table.size",          u32,           ":i") \
+  X(0x11, table_fill,          "table.fill",          u32,           "*")
+
+// Secondary opcodes of instructions that follow k_instr_simd_prefix = 0xfd (a u32).  All of fixed-width SIMD
+// fits in a byte; the gaps are opcodes that were retired before the proposal was finished.
+#define WASMTOOLBOX_SIMD_INSTRS(X) \
+  /* 5.4.8 Vector Instructions */ \
+  X(0x00, v128_load,                     "v128.load",                     memarg,      "i:v") \
+  X(0x01, v128_load8x8_s,                "v128.load8x8_s",                memarg,      "i:v") \
+  X(0x02, v128_load8x8_u,                "v128.load8x8_u",                memarg,      "i:v") \
+  X(0x03, v128_load16x4_s,               "v128.load16x4_s",               memarg,      "i:v") \
+  X(0x04, v128_load16x4_u,               "v128.load16x4_u",               memarg,      "i:v") \
+  X(0x05, v128_load32x2_s,               "v128.load32x2_s",               memarg,      "i:v") \
+  X(0x06, v128_load32x2_u,               "v128.load32x2_u",               memarg,      "i:v") \
+  X(0x07, v128_load8_splat,              "v128.load8_splat",              memarg,      "i:v") \
+  X(0x08, v128_load16_splat,             "v128.load16_splat",             memarg,      "i:v") \
+  X(0x09, v128_load32_splat,             "v128.load32_splat",             memarg,      "i:v") \
+  X(0x0a, v128_load64_splat,             "v128.load64_splat",             memarg,      "i:v") \
+  X(0x0b, v128_store,                    "v128.store",                    memarg,      "iv:") \
+  /* Constants, shuffles and lanes */ \
+  X(0x0c, v128_const,                    "v128.const",                    v128,        ":v") \
+  X(0x0d, i8x16_shuffle,                 "i8x16.shuffle",                 shuffle,     "vv:v") \
+  X(0x0e, i8x16_swizzle,                 "i8x16.swizzle",                 none,        "vv:v") \
+  X(0x0f, i8x16_splat,                   "i8x16.splat",                   none,        "i:v") \
+  X(0x10, i16x8_splat,                   "i16x8.splat",                   none,        "i:v") \
+  X(0x11, i32x4_splat,                   "i32x4.splat",                   none,        "i:v") \
+  X(0x12, i64x2_splat,                   "i64x2.splat",                   none,        "l:v") \
+  X(0x13, f32x4_splat,                   "f32x4.splat",                   none,        "f:v") \
+  X(0x14, f64x2_splat,                   "f64x2.splat",                   none,        "d:v") \
+  X(0x15, i8x16_extract_lane_s,          "i8x16.extract_lane_s",          lane,        "v:i") \
+  X(0x16, i8x16_extract_lane_u,          "i8x16.extract_lane_u",          lane,        "v:i") \
+  X(0x17, i8x16_replace_lane,            "i8x16.replace_lane",            lane,        "vi:v") \
+  X(0x18, i16x8_extract_lane_s,          "i16x8.extract_lane_s",          lane,        "v:i") \
+  X(0x19, i16x8_extract_lane_u,          "i16x8.extract_lane_u",          lane,        "v:i") \
+  X(0x1a, i16x8_replace_lane,            "i16x8.replace_lane",            lane,        "vi:v") \
+  X(0x1b, i32x4_extract_lane,            "i32x4.extract_lane",            lane,        "v:i") \
+  X(0x1c, i32x4_replace_lane,            "i32x4.replace_lane",            lane,        "vi:v") \
+  X(0x1d, i64x2_extract_lane,            "i64x2.extract_lane",            lane,        "v:l") \
+  X(0x1e, i64x2_replace_lane,            "i64x2.replace_lane",            lane,        "vl:v") \
+  X(0x1f, f32x4_extract_lane,            "f32x4.extract_lane",            lane,        "v:f") \
+  X(0x20, f32x4_replace_lane,            "f32x4.replace_lane",            lane,        "vf:v") \
+  X(0x21, f64x2_extract_lane,            "f64x2.extract_lane",            lane,        "v:d") \
+  X(0x22, f64x2_replace_lane,            "f64x2.replace_lane",            lane,        "vd:v") \
+  /* Comparisons */ \
+  X(0x23, i8x16_eq,                      "i8x16.eq",                      none,        "vv:v") \
+  X(0x24, i8x16_ne,                      "i8x16.ne",                      none,        "vv:v") \
+  X(0x25, i8x16_lt_s,                    "i8x16.lt_s",                    none,        "vv:v") \
+  X(0x26, i8x16_lt_u,                    "i8x16.lt_u",                    none,        "vv:v") \
+  X(0x27, i8x16_gt_s,                    "i8x16.gt_s",                    none,        "vv:v") \
+  X(0x28, i8x16_gt_u,                    "i8x16.gt_u",                    none,        "vv:v") \
+  X(0x29, i8x16_le_s,                    "i8x16.le_s",                    none,        "vv:v") \
+  X(0x2a, i8x16_le_u,                    "i8x16.le_u",                    none,        "vv:v") \
+  X(0x2b, i8x16_ge_s,                    "i8x16.ge_s",                    none,        "vv:v") \
+  X(0x2c, i8x16_ge_u,                    "i8x16.ge_u",                    none,        "vv:v") \
+  X(0x2d, i16x8_eq,                      "i16x8.eq",                      none,        "vv:v") \
+  X(0x2e, i16x8_ne,                      "i16x8.ne",                      none,        "vv:v") \
+  X(0x2f, i16x8_lt_s,                    "i16x8.lt_s",                    none,        "vv:v") \
+  X(0x30, i16x8_lt_u,                    "i16x8.lt_u",                    none,        "vv:v") \
+  X(0x31, i16x8_gt_s,                    "i16x8.gt_s",                    none,        "vv:v") \
+  X(0x32, i16x8_gt_u,                    "i16x8.gt_u",                    none,        "vv:v") \
+  X(0x33, i16x8_le_s,                    "i16x8.le_s",                    none,        "vv:v") \
+  X(0x34, i16x8_le_u,                    "i16x8.le_u",                    none,        "vv:v") \
+  X(0x35, i16x8_ge_s,                    "i16x8.ge_s",                    none,        "vv:v") \
+  X(0x36, i16x8_ge_u,                    "i16x8.ge_u",                    none,        "vv:v") \
+  X(0x37, i32x4_eq,                      "i32x4.eq",                      none,        "vv:v") \
+  X(0x38, i32x4_ne,                      "i32x4.ne",                      none,        "vv:v") \
+  X(0x39, i32x4_lt_s,                    "i32x4.lt_s",                    none,        "vv:v") \
+  X(0x3a, i32x4_lt_u,                    "i32x4.lt_u",                    none,        "vv:v") \
+  X(0x3b, i32x4_gt_s,                    "i32x4.gt_s",                    none,        "vv:v") \
+  X(0x3c, i32x4_gt_u,                    "i32x4.gt_u",                    none,        "vv:v") \
+  X(0x3d, i32x4_le_s,                    "i32x4.le_s",                    none,        "vv:v") \
+  X(0x3e, i32x4_le_u,                    "i32x4.le_u",                    none,        "vv:v") \
+  X(0x3f, i32x4_ge_s,                    "i32x4.ge_s",                    none,        "vv:v") \
+  X(0x40, i32x4_ge_u,                    "i32x4.ge_u",                    none,        "vv:v") \
+  X(0x41, f32x4_eq,                      "f32x4.eq",                      none,        "vv:v") \
+  X(0x42, f32x4_ne,                      "f32x4.ne",                      none,        "vv:v") \
+  X(0x43, f32x4_lt,                      "f32x4.lt",                      none,        "vv:v") \
+  X(0x44, f32x4_gt,                      "f32x4.gt",                      none,        "vv:v") \
+  X(0x45, f32x4_le,                      "f32x4.le",                      none,        "vv:v") \
+  X(0x46, f32x4_ge,                      "f32x4.ge",                      none,        "vv:v") \
+  X(0x47, f64x2_eq,                      "f64x2.eq",                      none,        "vv:v") \
+  X(0x48, f64x2_ne,                      "f64x2.ne",                      none,        "vv:v") \
+  X(0x49, f64x2_lt,                      "f64x2.lt",                      none,        "vv:v") \
+  X(0x4a, f64x2_gt,                      "f64x2.gt",                      none,        "vv:v") \
+  X(0x4b, f64x2_le,                      "f64x2.le",                      none,        "vv:v") \
+  X(0x4c, f64x2_ge,                      "f64x2.ge",                      none,        "vv:v") \
+  /* Bitwise operations */ \
+  X(0x4d, v128_not,                      "v128.not",                      none,        "v:v") \
+  X(0x4e, v128_and,                      "v128.and",                      none,        "vv:v") \
+  X(0x4f, v128_andnot,                   "v128.andnot",                   none,        "vv:v") \
+  X(0x50, v128_or,                       "v128.or",                       none,        "vv:v") \
+  X(0x51, v128_xor,                      "v128.xor",                      none,        "vv:v") \
+  X(0x52, v128_bitselect,                "v128.bitselect",                none,        "vvv:v") \
+  X(0x53, v128_any_true,                 "v128.any_true",                 none,        "v:i") \
+  /* Memory, continued */ \
+  X(0x54, v128_load8_lane,               "v128.load8_lane",               memarg_lane, "iv:v") \
+  X(0x55, v128_load16_lane,              "v128.load16_lane",              memarg_lane, "iv:v") \
+  X(0x56, v128_load32_lane,              "v128.load32_lane",              memarg_lane, "iv:v") \
+  X(0x57, v128_load64_lane,              "v128.load64_lane",              memarg_lane, "iv:v") \
+  X(0x58, v128_store8_lane,              "v128.store8_lane",              memarg_lane, "iv:") \
+  X(0x59, v128_store16_lane,             "v128.store16_lane",             memarg_lane, "iv:") \
+  X(0x5a, v128_store32_lane,             "v128.store32_lane",             memarg_lane, "iv:") \
+  X(0x5b, v128_store64_lane,             "v128.store64_lane",             memarg_lane, "iv:") \
+  X(0x5c, v128_load32_zero,              "v128.load32_zero",              memarg,      "i:v") \
+  X(0x5d, v128_load64_zero,              "v128.load64_zero",              memarg,      "i:v") \
+  /* Arithmetic and conversions */ \
+  X(0x5e, f32x4_demote_f64x2_zero,       "f32x4.demote_f64x2_zero",       none,        "v:v") \
+  X(0x5f, f64x2_promote_low_f32x4,       "f64x2.promote_low_f32x4",       none,        "v:v") \
+  X(0x60, i8x16_abs,                     "i8x16.abs",                     none,        "v:v") \
+  X(0x61, i8x16_neg,                     "i8x16.neg",                     none,        "v:v") \
+  X(0x62, i8x16_popcnt,                  "i8x16.popcnt",                  none,        "v:v") \
+  X(0x63, i8x16_all_true,                "i8x16.all_true",                none,        "v:i") \
+  X(0x64, i8x16_bitmask,                 "i8x16.bitmask",                 none,        "v:i") \
+  X(0x65, i8x16_narrow_i16x8_s,          "i8x16.narrow_i16x8_s",          none,        "vv:v") \
+  X(0x66, i8x16_narrow_i16x8_u,          "i8x16.narrow_i16x8_u",          none,        "vv:v") \
+  X(0x67, f32x4_ceil,                    "f32x4.ceil",                    none,        "v:v") \
+  X(0x68, f32x4_floor,                   "f32x4.floor",                   none,        "v:v") \
+  X(0x69, f32x4_trunc,                   "f32x4.trunc",                   none,        "v:v") \
+  X(0x6a, f32x4_nearest,                 "f32x4.nearest",                 none,        "v:v") \
+  X(0x6b, i8x16_shl,                     "i8x16.shl",                     none,        "vi:v") \
+  X(0x6c, i8x16_shr_s,                   "i8x16.shr_s",                   none,        "vi:v") \
+  X(0x6d, i8x16_shr_u,                   "i8x16.shr_u",                   none,        "vi:v") \
+  X(0x6e, i8x16_add,                     "i8x16.add",                     none,        "vv:v") \
+  X(0x6f, i8x16_add_sat_s,               "i8x16.add_sat_s",               none,        "vv:v") \
+  X(0x70, i8x16_add_sat_u,               "i8x16.add_sat_u",               none,        "vv:v") \
+  X(0x71, i8x16_sub,                     "i8x16.sub",                     none,        "vv:v") \
+  X(0x72, i8x16_sub_sat_s,               "i8x16.sub_sat_s",               none,        "vv:v") \
+  X(0x73, i8x16_sub_sat_u,               "i8x16.sub_sat_u",               none,        "vv:v") \
+  X(0x74, f64x2_ceil,                    "f64x2.ceil",                    none,        "v:v") \
+  X(0x75, f64x2_floor,                   "f64x2.floor",                   none,        "v:v") \
+  X(0x76, i8x16_min_s,                   "i8x16.min_s",                   none,        "vv:v") \
+  X(0x77, i8x16_min_u,                   "i8x16.min_u",                   none,        "vv:v") \
+  X(0x78, i8x16_max_s,                   "i8x16.max_s",                   none,        "vv:v") \
+  X(0x79, i8x16_max_u,                   "i8x16.max_u",                   none,        "vv:v") \
+  X(0x7a, f64x2_trunc,                   "f64x2.trunc",                   none,        "v:v") \
+  X(0x7b, i8x16_avgr_u,                  "i8x16.avgr_u",                  none,        "vv:v") \
+  X(0x7c, i16x8_extadd_pairwise_i8x16_s, "i16x8.extadd_pairwise_i8x16_s", none,        "v:v") \
+  X(0x7d, i16x8_extadd_pairwise_i8x16_u, "i16x8.extadd_pairwise_i8x16_u", none,        "v:v") \
+  X(0x7e, i32x4_extadd_pairwise_i16x8_s, "i32x4.extadd_pairwise_i16x8_s", none,        "v:v") \
+  X(0x7f, i32x4_extadd_pairwise_i16x8_u, "i32x4.extadd_pairwise_i16x8_u", none,        "v:v") \
+  X(0x80, i16x8_abs,                     "i16x8.abs",                     none,        "v:v") \
+  X(0x81, i16x8_neg,                     "i16x8.neg",                     none,        "v:v") \
+  X(0x82, i16x8_q15mulr_sat_s,           "i16x8.q15mulr_sat_s",           none,        "vv:v") \
+  X(0x83, i16x8_all_true,                "i16x8.all_true",                none,        "v:i") \
+  X(0x84, i16x8_bitmask,                 "i16x8.bitmask",                 none,        "v:i") \
+  X(0x85, i16x8_narrow_i32x4_s,          "i16x8.narrow_i32x4_s",          none,        "vv:v") \
+  X(0x86, i16x8_narrow_i32x4_u,          "i16x8.narrow_i32x4_u",          none,        "vv:v") \
+  X(0x87, i16x8_extend_low_i8x16_s,      "i16x8.extend_low_i8x16_s",      none,        "v:v") \
+  X(0x88, i16x8_extend_high_i8x16_s,     "i16x8.extend_high_i8x16_s",     none,        "v:v") \
+  X(0x89, i16x8_extend_low_i8x16_u,      "i16x8.extend_low_i8x16_u",      none,        "v:v") \
+  X(0x8a, i16x8_extend_high_i8x16_u,     "i16x8.extend_high_i8x16_u",     none,        "v:v") \
+  X(0x8b, i16x8_shl,                     "i16x8.shl",                     none,        "vi:v") \
+  X(0x8c, i16x8_shr_s,                   "i16x8.shr_s",                   none,        "vi:v") \
+  X(0x8d, i16x8_shr_u,                   "i16x8.shr_u",                   none,        "vi:v") \
+  X(0x8e, i16x8_add,                     "i16x8.add",                     none,        "vv:v") \
+  X(0x8f, i16x8_add_sat_s,               "i16x8.add_sat_s",               none,        "vv:v") \
+  X(0x90, i16x8_add_sat_u,               "i16x8.add_sat_u",               none,        "vv:v") \
+  X(0x91, i16x8_sub,                     "i16x8.sub",                     none,        "vv:v") \
+  X(0x92, i16x8_sub_sat_s,               "i16x8.sub_sat_s",               none,        "vv:v") \
+  X(0x93, i16x8_sub_sat_u,               "i16x8.sub_sat_u",               none,        "vv:v") \
+  X(0x94, f64x2_nearest,                 "f64x2.nearest",                 none,        "v:v") \
+  X(0x95, i16x8_mul,                     "i16x8.mul",                     none,        "vv:v") \
+  X(0x96, i16x8_min_s,                   "i16x8.min_s",                   none,        "vv:v") \
+  X(0x97, i16x8_min_u,                   "i16x8.min_u",                   none,        "vv:v") \
+  X(0x98, i16x8_max_s,                   "i16x8.max_s",                   none,        "vv:v") \
+  X(0x99, i16x8_max_u,                   "i16x8.max_u",                   none,        "vv:v") \
+  X(0x9b, i16x8_avgr_u,                  "i16x8.avgr_u",                  none,        "vv:v") \
+  X(0x9c, i16x8_extmul_low_i8x16_s,      "i16x8.extmul_low_i8x16_s",      none,        "vv:v") \
+  X(0x9d, i16x8_extmul_high_i8x16_s,     "i16x8.extmul_high_i8x16_s",     none,        "vv:v") \
+  X(0x9e, i16x8_extmul_low_i8x16_u,      "i16x8.extmul_low_i8x16_u",      none,        "vv:v") \
+  X(0x9f, i16x8_extmul_high_i8x16_u,     "i16x8.extmul_high_i8x16_u",     none,        "vv:v") \
+  X(0xa0, i32x4_abs,                     "i32x4.abs",                     none,        "v:v") \
+  X(0xa1, i32x4_neg,                     "i32x4.neg",                     none,        "v:v") \
+  X(0xa3, i32x4_all_true,                "i32x4.all_true",                none,        "v:i") \
+  X(0xa4, i32x4_bitmask,                 "i32x4.bitmask",                 none,        "v:i") \
+  X(0xa7, i32x4_extend_low_i16x8_s,      "i32x4.extend_low_i16x8_s",      none,        "v:v") \
+  X(0xa8, i32x4_extend_high_i16x8_s,     "i32x4.extend_high_i16x8_s",     none,        "v:v") \
+  X(0xa9, i32x4_extend_low_i16x8_u,      "i32x4.extend_low_i16x8_u",      none,        "v:v") \
+  X(0xaa, i32x4_extend_high_i16x8_u,     "i32x4.extend_high_i16x8_u",     none,        "v:v") \
+  X(0xab, i32x4_shl,                     "i32x4.shl",                     none,        "vi:v") \
+  X(0xac, i32x4_shr_s,                   "i32x4.shr_s",                   none,        "vi:v") \
+  X(0xad, i32x4_shr_u,                   "i32x4.shr_u",                   none,        "vi:v") \
+  X(0xae, i32x4_add,                     "i32x4.add",                     none,        "vv:v") \
+  X(0xb1, i32x4_sub,                     "i32x4.sub",                     none,        "vv:v") \
+  X(0xb5, i32x4_mul,                     "i32x4.mul",                     none,        "vv:v") \
+  X(0xb6, i32x4_min_s,                   "i32x4.min_s",                   none,        "vv:v") \
+  X(0xb7, i32x4_min_u,                   "i32x4.min_u",                   none,        "vv:v") \
+  X(0xb8, i32x4_max_s,                   "i32x4.max_s",                   none,        "vv:v") \
+  X(0xb9, i32x4_max_u,                   "i32x4.max_u",                   none,        "vv:v") \
+  X(0xba, i32x4_dot_i16x8_s,             "i32x4.dot_i16x8_s",             none,        "vv:v") \
+  X(0xbc, i32x4_extmul_low_i16x8_s,      "i32x4.extmul_low_i16x8_s",      none,        "vv:v") \
+  X(0xbd, i32x4_extmul_high_i16x8_s,     "i32x4.extmul_high_i16x8_s",     none,        "vv:v") \
+  X(0xbe, i32x4_extmul_low_i16x8_u,      "i32x4.extmul_low_i16x8_u",      none,        "vv:v") \
+  X(0xbf, i32x4_extmul_high_i16x8_u,     "i32x4.extmul_high_i16x8_u",     none,        "vv:v") \
+  X(0xc0, i64x2_abs,                     "i64x2.abs",                     none,        "v:v") \
+  X(0xc1, i64x2_neg,                     "i64x2.neg",                     none,        "v:v") \
+  X(0xc3, i64x2_all_true,                "i64x2.all_true",                none,        "v:i") \
+  X(0xc4, i64x2_bitmask,                 "i64x2.bitmask",                 none,        "v:i") \
+  X(0xc7, i64x2_extend_low_i32x4_s,      "i64x2.extend_low_i32x4_s",      none,        "v:v") \
+  X(0xc8, i64x2_extend_high_i32x4_s,     "i64x2.extend_high_i32x4_s",     none,        "v:v") \
+  X(0xc9, i64x2_extend_low_i32x4_u,      "i64x2.extend_low_i32x4_u",      none,        "v:v") \
+  X(0xca, i64x2_extend_high_i32x4_u,     "i64x2.extend_high_i32x4_u",     none,        "v:v") \
+  X(0xcb, i64x2_shl,                     "i64x2.shl",                     none,        "vi:v") \
+  X(0xcc, i64x2_shr_s,                   "i64x2.shr_s",                   none,        "vi:v") \
+  X(0xcd, i64x2_shr_u,                   "i64x2.shr_u",                   none,        "vi:v") \
+  X(0xce, i64x2_add,                     "i64x2.add",                     none,        "vv:v") \
+  X(0xd1, i64x2_sub,                     "i64x2.sub",                     none,        "vv:v") \
+  X(0xd5, i64x2_mul,                     "i64x2.mul",                     none,        "vv:v") \
+  X(0xd6, i64x2_eq,                      "i64x2.eq",                      none,        "vv:v") \
+  X(0xd7, i64x2_ne,                      "i64x2.ne",                      none,        "vv:v") \
+  X(0xd8, i64x2_lt_s,                    "i64x2.lt_s",                    none,        "vv:v") \
+  X(0xd9, i64x2_gt_s,                    "i64x2.gt_s",                    none,        "vv:v") \
+  X(0xda, i64x2_le_s,                    "i64x2.le_s",                    none,        "vv:v") \
+  X(0xdb, i64x2_ge_s,                    "i64x2.ge_s",                    none,        "vv:v") \
+  X(0xdc, i64x2_extmul_low_i32x4_s,      "i64x2.extmul_low_i32x4_s",      none,        "vv:v") \
+  X(0xdd, i64x2_extmul_high_i32x4_s,     "i64x2.extmul_high_i32x4_s",     none,        "vv:v") \
+  X(0xde, i64x2_extmul_low_i32x4_u,      "i64x2.extmul_low_i32x4_u",      none,        "vv:v") \
+  X(0xdf, i64x2_extmul_high_i32x4_u,     "i64x2.extmul_high_i32x4_u",     none,        "vv:v") \
+  X(0xe0, f32x4_abs,                     "f32x4.abs",                     none,        "v:v") \
+  X(0xe1, f32x4_neg,                     "f32x4.neg",                     none,        "v:v") \
+  X(0xe3, f32x4_sqrt,                    "f32x4.sqrt",                    none,        "v:v") \
+  X(0xe4, f32x4_add,                     "f32x4.add",                     none,        "vv:v") \
+  X(0xe5, f32x4_sub,                     "f32x4.sub",                     none,        "vv:v") \
+  X(0xe6, f32x4_mul,                     "f32x4.mul",                     none,        "vv:v") \
+  X(0xe7, f32x4_div,                     "f32x4.div",                     none,        "vv:v") \
+  X(0xe8, f32x4_min,                     "f32x4.min",                     none,        "vv:v") \
+  X(0xe9, f32x4_max,                     "f32x4.max",                     none,        "vv:v") \
+  X(0xea, f32x4_pmin,                    "f32x4.pmin",                    none,        "vv:v") \
+  X(0xeb, f32x4_pmax,                    "f32x4.pmax",                    none,        "vv:v") \
+  X(0xec, f64x2_abs,                     "f64x2.abs",                     none,        "v:v") \
+  X(0xed, f64x2_neg,                     "f64x2.neg",                     none,        "v:v") \
+  X(0xef, f64x2_sqrt,                    "f64x2.sqrt",                    none,        "v:v") \
+  X(0xf0, f64x2_add,                     "f64x2.add",                     none,        "vv:v") \
+  X(0xf1, f64x2_sub,                     "f64x2.sub",                     none,        "vv:v") \
+  X(0xf2, f64x2_mul,                     "f64x2.mul",                     none,        "vv:v") \
+  X(0xf3, f64x2_div,                     "f64x2.div",                     none,        "vv:v") \
+  X(0xf4, f64x2_min,                     "f64x2.min",                     none,        "vv:v") \
+  X(0xf5, f64x2_max,                     "f64x2.max",                     none,        "vv:v") \
+  X(0xf6, f64x2_pmin,                    "f64x2.pmin",                    none,        "vv:v") \
+  X(0xf7, f64x2_pmax,                    "f64x2.pmax",                    none,        "vv:v") \
+  X(0xf8, i32x4_trunc_sat_f32x4_s,       "i32x4.trunc_sat_f32x4_s",       none,        "v:v") \
+  X(0xf9, i32x4_trunc_sat_f32x4_u,       "i32x4.trunc_sat_f32x4_u",       none,        "v:v") \
+  X(0xfa, f32x4_convert_i32x4_s,         "f32x4.convert_i32x4_s",         none,        "v:v") \
+  X(0xfb, f32x4_convert_i32x4_u,         "f32x4.convert_i32x4_u",         none,        "v:v") \
+  X(0xfc, i32x4_trunc_sat_f64x2_s_zero,  "i32x4.trunc_sat_f64x2_s_zero",  none,        "v:v") \
+  X(0xfd, i32x4_trunc_sat_f64x2_u_zero,  "i32x4.trunc_sat_f64x2_u_zero",  none,        "v:v") \
+  X(0xfe, f64x2_convert_low_i32x4_s,     "f64x2.convert_low_i32x4_s",     none,        "v:v") \
+  X(0xff, f64x2_convert_low_i32x4_u,     "f64x2.convert_low_i32x4_u",     none,        "v:v")
+
+// Secondary opcodes of instructions that follow k_instr_atomic_prefix = 0xfe (a u32)
+#define WASMTOOLBOX_ATOMIC_INSTRS(X) \
+  /* 5.4.4 Atomic Memory Instructions (Threads spec) */ \
+  X(0x00, memory_atomic_notify,       "memory.atomic.notify",       memarg,    "ii:i") \
+  X(0x01, memory_atomic_wait32,       "memory.atomic.wait32",       memarg,    "iil:i") \
+  X(0x02, memory_atomic_wait64,       "memory.atomic.wait64",       memarg,    "ill:i") \
+  X(0x03, atomic_fence,               "atomic.fence",               zero_byte, ":") \
+  \
+  X(0x10, i32_atomic_load,            "i32.atomic.load",            memarg,    "i:i") \
+  X(0x11, i64_atomic_load,            "i64.atomic.load",            memarg,    "i:l") \
+  X(0x12, i32_atomic_load8_u,         "i32.atomic.load8.u",         memarg,    "i:i") \
+  X(0x13, i32_atomic_load16_u,        "i32.atomic.load16.u",        memarg,    "i:i") \
+  X(0x14, i64_atomic_load8_u,         "i64.atomic.load8.u",         memarg,    "i:l") \
+  X(0x15, i64_atomic_load16_u,        "i64.atomic.load16.u",        memarg,    "i:l") \
+  X(0x16, i64_atomic_load32_u,        "i64.atomic.load32.u",        memarg,    "i:l") \
+  X(0x17, i32_atomic_store,           "i32.atomic.store",           memarg,    "ii:") \
+  X(0x18, i64_atomic_store,           "i64.atomic.store",           memarg,    "il:") \
+  X(0x19, i32_atomic_store8,          "i32.atomic.store8",          memarg,    "ii:") \
+  X(0x1a, i32_atomic_store16,         "i32.atomic.store16",         memarg,    "ii:") \
+  X(0x1b, i64_atomic_store8,          "i64.atomic.store8",          memarg,    "il:") \
+  X(0x1c, i64_atomic_store16,         "i64.atomic.store16",         memarg,    "il:") \
+  X(0x1d, i64_atomic_store32,         "i64.atomic.store32",         memarg,    "il:") \
+  \
+  X(0x1e, i32_atomic_rmw_add,         "i32.atomic.rmw.add",         memarg,    "ii:i") \
+  X(0x1f, i64_atomic_rmw_add,         "i64.atomic.rmw.add",         memarg,    "il:l") \
+  X(0x20, i32_atomic_rmw8_add_u,      "i32.atomic.rmw8.add_u",      memarg,    "ii:i") \
+  X(0x21, i32_atomic_rmw16_add_u,     "i32.atomic.rmw16.add_u",     memarg,    "ii:i") \
+  X(0x22, i64_atomic_rmw8_add_u,      "i64.atomic.rmw8.add_u",      memarg,    "il:l") \
+  X(0x23, i64_atomic_rmw16_add_u,     "i64.atomic.rmw16.add_u",     memarg,    "il:l") \
+  X(0x24, i64_atomic_rmw32_add_u,     "i64.atomic.rmw32.add_u",     memarg,    "il:l") \
+  \
+  X(0x25, i32_atomic_rmw_sub,         "i32.atomic.rmw.sub",         memarg,    "ii:i") \
+  X(0x26, i64_atomic_rmw_sub,         "i64.atomic.rmw.sub",         memarg,    "il:l") \
+  X(0x27, i32_atomic_rmw8_sub_u,      "i32.atomic.rmw8.sub_u",      memarg,    "ii:i") \
+  X(0x28, i32_atomic_rmw16_sub_u,     "i32.atomic.rmw16.sub_u",     memarg,    "ii:i") \
+  X(0x29, i64_atomic_rmw8_sub_u,      "i64.atomic.rmw8.sub_u",      memarg,    "il:l") \
+  X(0x2a, i64_atomic_rmw16_sub_u,     "i64.atomic.rmw16.sub_u",     memarg,    "il:l") \
+  X(0x2b, i64_atomic_rmw32_sub_u,     "i64.atomic.rmw32.sub_u",     memarg,    "il:l") \
+  \
+  X(0x2c, i32_atomic_rmw_and,         "i32.atomic.rmw.and",         memarg,    "ii:i") \
+  X(0x2d, i64_atomic_rmw_and,         "i64.atomic.rmw.and",         memarg,    "il:l") \
+  X(0x2e, i32_atomic_rmw8_and_u,      "i32.atomic.rmw8.and_u",      memarg,    "ii:i") \
+  X(0x2f, i32_atomic_rmw16_and_u,     "i32.atomic.rmw16.and_u",     memarg,    "ii:i") \
+  X(0x30, i64_atomic_rmw8_and_u,      "i64.atomic.rmw8.and_u",      memarg,    "il:l") \
+  X(0x31, i64_atomic_rmw16_and_u,     "i64.atomic.rmw16.and_u",     memarg,    "il:l") \
+  X(0x32, i64_atomic_rmw32_and_u,     "i64.atomic.rmw32.and_u",     memarg,    "il:l") \
+  \
+  X(0x33, i32_atomic_rmw_or,          "i32.atomic.rmw.or",          memarg,    "ii:i") \
+  X(0x34, i64_atomic_rmw_or,          "i64.atomic.rmw.or",          memarg,    "il:l") \
+  X(0x35, i32_atomic_rmw8_or_u,       "i32.atomic.rmw8.or_u",       memarg,    "ii:i") \
+  X(0x36, i32_atomic_rmw16_or_u,      "i32.atomic.rmw16.or_u",      memarg,    "ii:i") \
+  X(0x37, i64_atomic_rmw8_or_u,       "i64.atomic.rmw8.or_u",       memarg,    "il:l") \
+  X(0x38, i64_atomic_rmw16_or_u,      "i64.atomic.rmw16.or_u",      memarg,    "il:l") \
+  X(0x39, i64_atomic_rmw32_or_u,      "i64.atomic.rmw32.or_u",      memarg,    "il:l") \
+  \
+  X(0x3a, i32_atomic_rmw_xor,         "i32.atomic.rmw.xor",         memarg,    "ii:i") \
+  X(0x3b, i64_atomic_rmw_xor,         "i64.atomic.rmw.xor",         memarg,    "il:l") \
+  X(0x3c, i32_atomic_rmw8_xor_u,      "i32.atomic.rmw8.xor_u",      memarg,    "ii:i") \
+  X(0x3d, i32_atomic_rmw16_xor_u,     "i32.atomic.rmw16.xor_u",     memarg,    "ii:i") \
+  X(0x3e, i64_atomic_rmw8_xor_u,      "i64.atomic.rmw8.xor_u",      memarg,    "il:l") \
+  X(0x3f, i64_atomic_rmw16_xor_u,     "i64.atomic.rmw16.xor_u",     memarg,    "il:l") \
+  X(0x40, i64_atomic_rmw32_xor_u,     "i64.atomic.rmw32.xor_u",     memarg,    "il:l") \
+  \
+  X(0x41, i32_atomic_rmw_xchg,        "i32.atomic.rmw.xchg",        memarg,    "ii:i") \
+  X(0x42, i64_atomic_rmw_xchg,        "i64.atomic.rmw.xchg",        memarg,    "il:l") \
+  X(0x43, i32_atomic_rmw8_xchg_u,     "i32.atomic.rmw8.xchg_u",     memarg,    "ii:i") \
+  X(0x44, i32_atomic_rmw16_xchg_u,    "i32.atomic.rmw16.xchg_u",    memarg,    "ii:i") \
+  X(0x45, i64_atomic_rmw8_xchg_u,     "i64.atomic.rmw8.xchg_u",     memarg,    "il:l") \
+  X(0x46, i64_atomic_rmw16_xchg_u,    "i64.atomic.rmw16.xchg_u",    memarg,    "il:l") \
+  X(0x47, i64_atomic_rmw32_xchg_u,    "i64.atomic.rmw32.xchg_u",    memarg,    "il:l") \
+  \
+  X(0x48, i32_atomic_rmw_cmpxchg,     "i32.atomic.rmw.cmpxchg",     memarg,    "iii:i") \
+  X(0x49, i64_atomic_rmw_cmpxchg,     "i64.atomic.rmw.cmpxchg",     memarg,    "ill:l") \
+  X(0x4a, i32_atomic_rmw8_cmpxchg_u,  "i32.atomic.rmw8.cmpxchg_u",  memarg,    "iii:i") \
+  X(0x4b, i32_atomic_rmw16_cmpxchg_u, "i32.atomic.rmw16.cmpxchg_u", memarg,    "iii:i") \
+  X(0x4c, i64_atomic_rmw8_cmpxchg_u,  "i64.atomic.rmw8.cmpxchg_u",  memarg,    "ill:l") \
+  X(0x4d, i64_atomic_rmw16_cmpxchg_u, "i64.atomic.rmw16.cmpxchg_u", memarg,    "ill:l") \
+  X(0x4e, i64_atomic_rmw32_cmpxchg_u, "i64.atomic.rmw32.cmpxchg_u", memarg,    "ill:l")
+
+
+enum Instr_opcode : uint8_t {
+#define WASMTOOLBOX_X(opcode, name, mnemonic, imm, effect) k_instr_##name = opcode,
+  WASMTOOLBOX_INSTRS(WASMTOOLBOX_X)
+#undef WASMTOOLBOX_X
+};
+
+enum Ext_instr_ : uint32_t {
+#define WASMTOOLBOX_X(opcode, name, mnemonic, imm, effect) k_ext_instr_##name = opcode,
+  WASMTOOLBOX_EXT_INSTRS(WASMTOOLBOX_X)
+#undef WASMTOOLBOX_X
+};
+
+enum Simd_instr_opcode : uint32_t {
+#define WASMTOOLBOX_X(opcode, name, mnemonic, imm, effect) k_simd_instr_##name = opcode,
+  WASMTOOLBOX_SIMD_INSTRS(WASMTOOLBOX_X)
+#undef WASMTOOLBOX_X
+};
+
+enum Thread_instr_secondary_opcode : uint8_t {
+#define WASMTOOLBOX_X(opcode, name, mnemonic, imm, effect) k_atomic_instr_##name = opcode,
+  WASMTOOLBOX_ATOMIC_INSTRS(WASMTOOLBOX_X)
+#undef WASMTOOLBOX_X
+};
+
+// What follows an opcode, and where it goes in Ast_instr (see ast.h)
+enum class Imm_kind : uint8_t {
+  k_invalid,        // not an opcode
+  k_none,
+  k_block,          // blocktype, then the block's instructions up to its end (block, loop, if, try)
+  k_structured,     // only valid as part of an enclosing block (else, end, catch, catch_all, delegate)
+  k_u32,            // a = some index (labelidx, funcidx, localidx, ...)
+  k_u32_u32,        // a, b = two indices (e.g., typeidx and tableidx for call_indirect)
+  k_br_table,       // vec(labelidx) labelidx
+  k_reftype,        // a = Ast_reftype
+  k_select_t,       // vec(valtype); a = the first one
+  k_memarg,         // a = align, b = offset
+  k_zero_byte,      // a reserved 0x00 byte (a memidx in the multi-memory proposal)
+  k_zero_bytes_2,   // two of them
+  k_u32_zero_byte,  // a = some index, then a reserved 0x00 byte
+  k_i32,            // a = value
+  k_i64,            // a, b = low and high 32 bits
+  k_f32,            // a = bit pattern
+  k_f64,            // a, b = low and high 32 bits of the bit pattern
+  k_v128,           // 16 bytes; a = their index in Ast_func::v128_imms
+  k_shuffle,        // 16 lane indices, one byte each; a = their index in Ast_func::v128_imms
+  k_lane,           // lane = a lane index (one byte)
+  k_memarg_lane,    // a = align, b = offset, lane = a lane index
+  k_prefix,         // a secondary opcode (u32) in subopcode, then its immediates
+};
+
+namespace opcodes_internal {
+
+// Natural alignment (log2 of the access size) of a memory instruction.  The access size is spelled out in the
+// mnemonic (e.g., i64.load8_s, i32.atomic.rmw16.add_u, v128.load32_zero) unless it's the full width of the type
+// (e.g., f64.store, memory.atomic.notify, v128.load).  Vector loads that extend lanes (e.g., v128.load8x8_s)
+// always read 64 bits.
+constexpr auto natural_alignment(std::string_view mnemonic) -> uint8_t {
+  auto op = mnemonic.substr(mnemonic.find('.'));
+  if (mnemonic.starts_with("v128")) {
+    if (op.find('x') != op.npos) { return 3; }
+    if (op == ".load" || op == ".store") { return 4; }
+  }
+  if (op.find("64") != op.npos) { return 3; }
+  if (op.find("32") != op.npos) { return 2; }
+  if (op.find("16") != op.npos) { return 1; }
+  if (op.find("8") != op.npos) { return 0; }
+  return mnemonic.starts_with("i64") || mnemonic.starts_with("f64") ? 3 : 2;
+}
+
+// How many lanes a vector instruction's lane immediates can pick from: those of its shape (e.g., 16 for
+// i8x16.extract_lane_s), of the vector accessed (16 / access size for v128.load8_lane and the like), or of
+// both operands of i8x16.shuffle
+constexpr auto lane_count(std::string_view mnemonic, Imm_kind imm) -> uint8_t {
+  switch (imm) {
+    case Imm_kind::k_shuffle: return 32;
+    case Imm_kind::k_memarg_lane: return static_cast<uint8_t>(16 >> natural_alignment(mnemonic));
+    default: {
+      auto count = uint8_t{0};
+      for (auto c : mnemonic.substr(mnemonic.find('x') + 1, mnemonic.find('.') - mnemonic.find('x') - 1)) {
+        count = static_cast<uint8_t>(count * 10 + (c - '0'));
+      }
+      return count;
+    }
+  }
+}
+
+struct Instr_table {
+  std::array<Imm_kind, 256> imm_kinds{};  // k_invalid
+  std::array<std::string_view, 256> mnemonics{};
+  std::array<std::string_view, 256> stack_effects{};
+  std::array<uint8_t, 256> natural_alignments{};  // memory instructions only
+  std::array<uint8_t, 256> lane_counts{};         // instructions with lane immediates only
+
+  constexpr auto add(uint32_t opcode, std::string_view mnemonic, Imm_kind imm, std::string_view effect) -> void {
+    if (imm_kinds.at(opcode) != Imm_kind::k_invalid) { throw "opcode listed twice"; }  // fails to compile
+    imm_kinds[opcode] = imm;
+    mnemonics[opcode] = mnemonic;
+    stack_effects[opcode] = effect;
+    if (imm == Imm_kind::k_memarg || imm == Imm_kind::k_memarg_lane) {
+      natural_alignments[opcode] = natural_alignment(mnemonic);
+    }
+    if (imm == Imm_kind::k_lane || imm == Imm_kind::k_memarg_lane || imm == Imm_kind::k_shuffle) {
+      lane_counts[opcode] = lane_count(mnemonic, imm);
+    }
+  }
+};
+
+#define WASMTOOLBOX_X(opcode, name, mnemonic, imm, effect) table.add(opcode, mnemonic, Imm_kind::k_##imm, effect);
+
+constexpr auto k_instrs = [] {
+  auto table = Instr_table{};
+  WASMTOOLBOX_INSTRS(WASMTOOLBOX_X)
+  return table;
+}();
+
+constexpr auto k_ext_instrs = [] {
+  auto table = Instr_table{};
+  WASMTOOLBOX_EXT_INSTRS(WASMTOOLBOX_X)
+  return table;
+}();
+
+constexpr auto k_simd_instrs = [] {
+  auto table = Instr_table{};
+  WASMTOOLBOX_SIMD_INSTRS(WASMTOOLBOX_X)
+  return table;
+}();
+
+constexpr auto k_atomic_instrs = [] {
+  auto table = Instr_table{};
+  WASMTOOLBOX_ATOMIC_INSTRS(WASMTOOLBOX_X)
+  return table;
+}();
+
+#undef WASMTOOLBOX_X
+
+}  // namespace opcodes_internal
+
+// Indexed by opcode (or by secondary opcode, for the ext, SIMD and atomic tables, which all fit in a byte)
+constexpr auto k_instr_imm_kinds = opcodes_internal::k_instrs.imm_kinds;
+constexpr auto k_instr_mnemonics = opcodes_internal::k_instrs.mnemonics;  // "" if not an opcode (or a prefix)
+constexpr auto k_instr_stack_effects = opcodes_internal::k_instrs.stack_effects;
+constexpr auto k_instr_natural_alignments = opcodes_internal::k_instrs.natural_alignments;
+
+constexpr auto k_ext_instr_imm_kinds = opcodes_internal::k_ext_instrs.imm_kinds;
+constexpr auto k_ext_instr_mnemonics = opcodes_internal::k_ext_instrs.mnemonics;
+constexpr auto k_ext_instr_stack_effects = opcodes_internal::k_ext_instrs.stack_effects;
+constexpr auto k_ext_instr_natural_alignments = opcodes_internal::k_ext_instrs.natural_alignments;
+
+constexpr auto k_simd_instr_imm_kinds = opcodes_internal::k_simd_instrs.imm_kinds;
+constexpr auto k_simd_instr_mnemonics = opcodes_internal::k_simd_instrs.mnemonics;
+constexpr auto k_simd_instr_stack_effects = opcodes_internal::k_simd_instrs.stack_effects;
+constexpr auto k_simd_instr_natural_alignments = opcodes_internal::k_simd_instrs.natural_alignments;
+constexpr auto k_simd_instr_lane_counts = opcodes_internal::k_simd_instrs.lane_counts;
+
+constexpr auto k_atomic_instr_imm_kinds = opcodes_internal::k_atomic_instrs.imm_kinds;
+constexpr auto k_atomic_instr_mnemonics = opcodes_internal::k_atomic_instrs.mnemonics;
+constexpr auto k_atomic_instr_stack_effects = opcodes_internal::k_atomic_instrs.stack_effects;
+constexpr auto k_atomic_instr_natural_alignments = opcodes_internal::k_atomic_instrs.natural_alignments;
+
+}  // namespace wasmtoolbox
+
+#endif /* WASMTOOLBOX_OPCODES_H */
@@ -0,0 +1,111 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "output_sink.h"
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+namespace wasmtoolbox {
+
+Output_sink::Output_sink(int fd, size_t capacity)
+    : fd_{fd}, buffer_{new char[capacity]}, cur_{buffer_.get()}, end_{buffer_.get() + capacity} {}
+
+Output_sink::Output_sink(std::ostream& os, size_t capacity)
+    : os_{&os}, buffer_{new char[capacity]}, cur_{buffer_.get()}, end_{buffer_.get() + capacity} {}
+
+Output_sink::Output_sink(std::string& str, size_t capacity)
+    : str_{&str}, buffer_{new char[capacity]}, cur_{buffer_.get()}, end_{buffer_.get() + capacity} {}
+
+Output_sink::~Output_sink() {
+  flush();
+}
+
+auto Output_sink::fill(char c, size_t n) -> void {
+  while (n != 0) {
+    if (cur_ == end_) { flush(); }
+    auto count = std::min(n, static_cast<size_t>(end_ - cur_));
+    std::memset(cur_, c, count);
+    cur_ += count;
+    n -= count;
+  }
+}
+
+auto Output_sink::flush() -> void {
+  write_out({buffer_.get(), static_cast<size_t>(cur_ - buffer_.get())});
+  cur_ = buffer_.get();
+  if (os_ != nullptr && ok_) { ok_ = static_cast<bool>(os_->flush()); }
+}
+
+// Doesn't fit: if it's at least as big as the whole buffer, don't bother copying it in
+auto Output_sink::append_slow(std::string_view s) -> void {
+  auto capacity = static_cast<size_t>(end_ - buffer_.get());
+  auto buffered = std::string_view{buffer_.get(), static_cast<size_t>(cur_ - buffer_.get())};
+  cur_ = buffer_.get();
+  if (s.size() >= capacity) {
+    write_out(buffered, s);
+  } else {
+    write_out(buffered);
+    append(s);
+  }
+}
+
+// Writes first then second, in a single system call if possible
+auto Output_sink::write_out(std::string_view first, std::string_view second) -> void {
+  if (not ok_) { return; }
+  if (str_ != nullptr) {
+    str_->append(first).append(second);
+    return;
+  }
+  if (os_ != nullptr) {
+    ok_ = os_->write(first.data(), std::ssize(first)) && os_->write(second.data(), std::ssize(second));
+    return;
+  }
+
+  iovec iov[2] = {{const_cast<char*>(first.data()), first.size()},
+                  {const_cast<char*>(second.data()), second.size()}};
+  auto* pending = iov;
+  auto num_pending = 2;
+  while (num_pending != 0) {
+    if (pending->iov_len == 0) {
+      ++pending;
+      --num_pending;
+      continue;
+    }
+    auto n = ::writev(fd_, pending, num_pending);
+    if (n < 0) {
+      if (errno == EINTR) { continue; }
+      ok_ = false;
+      return;
+    }
+    // Partial write: skip what made it out
+    for (auto written = static_cast<size_t>(n); written != 0;) {
+      auto step = std::min(written, pending->iov_len);
+      pending->iov_base = static_cast<char*>(pending->iov_base) + step;
+      pending->iov_len -= step;
+      written -= step;
+      if (pending->iov_len == 0 && written != 0) {
+        ++pending;
+        --num_pending;
+      }
+    }
+  }
+}
+
+}  // namespace wasmtoolbox
@@ -0,0 +1,88 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WASMTOOLBOX_OUTPUT_SINK_H
+#define WASMTOOLBOX_OUTPUT_SINK_H
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace wasmtoolbox {
+
+// Where Text_format_writer's output goes.
+//
+// Tokens are appended to one large contiguous buffer, which only reaches the file descriptor (through
+// write(2)/writev(2)), std::ostream or std::string behind it in big blocks: when it fills up, on flush() and on
+// destruction.
+// So printing a module costs a memcpy per token, rather than a trip through the iostream machinery (sentry,
+// locale, virtual calls) for every character.
+//
+// Write errors are sticky, like an ostream's badbit: once one happens, ok() is false and later output is
+// dropped.
+class Output_sink {
+ public:
+  static constexpr auto k_default_capacity = size_t{256} * 1024;
+
+  explicit Output_sink(int fd, size_t capacity = k_default_capacity);
+  explicit Output_sink(std::ostream& os, size_t capacity = k_default_capacity);
+  explicit Output_sink(std::string& str, size_t capacity = k_default_capacity);  // appends to str
+
+  Output_sink(const Output_sink&) = delete;
+  auto operator=(const Output_sink&) -> Output_sink& = delete;
+  ~Output_sink();  // flushes
+
+  auto append(std::string_view s) -> void {
+    if (s.empty()) { return; }  // s.data() may be null, which memcpy doesn't allow
+    if (s.size() <= static_cast<size_t>(end_ - cur_)) [[likely]] {
+      std::memcpy(cur_, s.data(), s.size());
+      cur_ += s.size();
+    } else {
+      append_slow(s);
+    }
+  }
+
+  auto put(char c) -> void {
+    if (cur_ == end_) [[unlikely]] { flush(); }
+    *cur_++ = c;
+  }
+
+  auto fill(char c, size_t n) -> void;  // n copies of c (e.g., indentation)
+
+  // Hands everything appended so far to the file descriptor or stream (and flushes the stream)
+  auto flush() -> void;
+
+  auto ok() const -> bool { return ok_; }
+
+ private:
+  auto append_slow(std::string_view s) -> void;
+  auto write_out(std::string_view first, std::string_view second = {}) -> void;
+
+  int fd_ = -1;
+  std::ostream* os_ = nullptr;  // instead of fd_
+  std::string* str_ = nullptr;  // ditto
+  std::unique_ptr<char[]> buffer_;
+  char* cur_;
+  char* end_;
+  bool ok_ = true;
+};
+
+}  // namespace wasmtoolbox
+
+#endif /* WASMTOOLBOX_OUTPUT_SINK_H */
@@ -0,0 +1,112 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "parallel_decode.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+namespace wasmtoolbox {
+
+namespace {
+
+// Batches per thread: enough to even out bodies that are slower to decode than their size suggests, few
+// enough that picking up a batch is cheap next to decoding it
+constexpr auto k_batches_per_thread = size_t{8};
+
+// Splits codes into consecutive batches of roughly total_size / num_batches bytes each.  Returns the index
+// of the first entry of each batch, plus codes.size() at the end.
+auto split_into_batches(std::span<const Ast_code> codes, size_t num_batches) -> std::vector<size_t> {
+  auto total_size = size_t{0};
+  for (const auto& code : codes) { total_size += code.size; }
+  auto target_size = std::max(total_size / num_batches, size_t{1});
+
+  auto boundaries = std::vector<size_t>{0};
+  auto batch_size = size_t{0};
+  for (auto i = size_t{0}; i != codes.size(); ++i) {
+    batch_size += codes[i].size;
+    if (batch_size >= target_size && i + 1 != codes.size()) {
+      boundaries.push_back(i + 1);
+      batch_size = 0;
+    }
+  }
+  boundaries.push_back(codes.size());
+  return boundaries;
+}
+
+}  // namespace
+
+auto decode_funcs_in_parallel(std::span<Ast_code> codes, Ast_arena& arena, int num_threads,
+                              const Ast_module* validate_against) -> std::optional<Parse_error> {
+  if (codes.empty()) { return std::nullopt; }
+  num_threads = std::max(num_threads, 1);
+  auto boundaries = split_into_batches(codes, std::min(codes.size(), num_threads * k_batches_per_thread));
+  auto num_batches = boundaries.size() - 1;
+  auto num_workers = std::min(static_cast<size_t>(num_threads), num_batches);
+
+  // The arena isn't thread-safe, so each thread allocates from its own, which the arena adopts at the end
+  auto resources = std::vector<std::unique_ptr<std::pmr::monotonic_buffer_resource>>{};
+  for (auto t = size_t{0}; t != num_workers; ++t) {
+    resources.push_back(std::make_unique<std::pmr::monotonic_buffer_resource>());
+  }
+
+  // Each batch stops at its first error, which is also its lowest-offset one.  Batches after the earliest
+  // failed batch so far can't hold the lowest-offset error, so they're skipped.
+  auto errors = std::vector<std::optional<Parse_error>>(num_batches);
+  auto next_batch = std::atomic<size_t>{0};
+  auto first_failed_batch = std::atomic<size_t>{num_batches};
+
+  auto work = [&](std::pmr::memory_resource* resource) {
+    auto parser = Wasm_parser{std::span<const uint8_t>{}, 0, resource};  // reused for all of this thread's bodies
+    if (validate_against != nullptr) { parser.validator.begin_module(*validate_against); }
+    while (true) {
+      auto batch = next_batch.fetch_add(1, std::memory_order_relaxed);
+      if (batch >= num_batches) { break; }
+      if (batch > first_failed_batch.load(std::memory_order_relaxed)) { continue; }
+
+      for (auto i = boundaries[batch]; i != boundaries[batch + 1]; ++i) {
+        auto funcidx = validate_against != nullptr ? std::optional{static_cast<uint32_t>(i)} : std::nullopt;
+        auto result = try_parse_lazy_func(parser, codes[i], funcidx);
+        if (not result.has_value()) {
+          errors[batch] = result.error();
+          auto failed = first_failed_batch.load(std::memory_order_relaxed);
+          while (batch < failed && not first_failed_batch.compare_exchange_weak(failed, batch)) {}
+          break;
+        }
+        codes[i].func = std::move(result).value();
+        codes[i].body = {};
+      }
+    }
+  };
+
+  {
+    auto workers = std::vector<std::jthread>{};
+    for (auto t = size_t{1}; t < num_workers; ++t) { workers.emplace_back(work, resources[t].get()); }
+    work(resources[0].get());
+  }  // joins the workers
+
+  for (auto& resource : resources) { arena.adopt(std::move(resource)); }
+
+  auto failed = first_failed_batch.load();
+  if (failed != num_batches) { return errors[failed]; }
+  return std::nullopt;
+}
+
+}  // namespace wasmtoolbox
@@ -0,0 +1,43 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WASMTOOLBOX_PARALLEL_DECODE_H
+#define WASMTOOLBOX_PARALLEL_DECODE_H
+
+#include <optional>
+#include <span>
+
+#include "ast.h"
+#include "parser.h"
+
+namespace wasmtoolbox {
+
+// Decodes the undecoded function bodies in `codes` (see Parse_options::lazy_function_bodies) on up to
+// num_threads threads, filling in each Ast_code::func and clearing its body.  The funcs' memory ends up in
+// `arena`.
+//
+// The bodies are split into batches of roughly equal byte counts, which the threads pick up in order.
+// On malformed input, returns the error with the lowest offset, regardless of how the work got scheduled;
+// the funcs of the entries that failed (and possibly others) are left empty.
+//
+// With validate_against, the bodies are also validated against that module's types (see Func_validator), with
+// codes[i] being its i-th function.
+auto decode_funcs_in_parallel(std::span<Ast_code> codes, Ast_arena& arena, int num_threads,
+                              const Ast_module* validate_against = nullptr) -> std::optional<Parse_error>;
+
+}  // namespace wasmtoolbox
+
+#endif /* WASMTOOLBOX_PARALLEL_DECODE_H */
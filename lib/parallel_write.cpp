@@ -0,0 +1,171 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "parallel_write.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "text_format.h"
+
+namespace wasmtoolbox {
+
+namespace {
+
+// As in parallel_decode.cpp: enough batches to even out the threads, few enough to be cheap to hand out
+constexpr auto k_batches_per_thread = size_t{8};
+
+// How many batches past the last one written the threads may get to, per thread
+constexpr auto k_lookahead_per_thread = size_t{4};
+
+// Capacity of each thread's Output_sink, which only buffers on the way to the batch's string
+constexpr auto k_batch_sink_capacity = size_t{64} * 1024;
+
+auto field_weight(const Ast_module& module, size_t i) -> size_t {
+  auto first_func = module.types.size() + module.imports.size();
+  if (i < first_func) { return 1; }
+  const auto& code = module.codes[i - first_func];
+  return code.func.has_value() ? code.func->body.size() + code.func->locals.size() + 1 : 1;
+}
+
+// Splits the module's fields into consecutive batches of roughly equal weight.  Returns the index of the
+// first field of each batch, plus the number of fields at the end.
+auto split_into_batches(const Ast_module& module, size_t num_batches) -> std::vector<size_t> {
+  auto num_fields = Text_format_writer::num_module_fields(module);
+  auto total_weight = size_t{0};
+  for (auto i = size_t{0}; i != num_fields; ++i) { total_weight += field_weight(module, i); }
+  auto target_weight = std::max(total_weight / num_batches, size_t{1});
+
+  auto boundaries = std::vector<size_t>{0};
+  auto batch_weight = size_t{0};
+  for (auto i = size_t{0}; i != num_fields; ++i) {
+    batch_weight += field_weight(module, i);
+    if (batch_weight >= target_weight && i + 1 != num_fields) {
+      boundaries.push_back(i + 1);
+      batch_weight = 0;
+    }
+  }
+  boundaries.push_back(num_fields);
+  return boundaries;
+}
+
+struct Batch {
+  std::string text{};
+  std::exception_ptr error{};
+  bool done = false;
+};
+
+}  // namespace
+
+auto write_module_in_parallel(Output_sink& out, const Ast_module& module, int num_threads,
+                              Text_format_options options) -> void {
+  auto w = Text_format_writer{out};
+  w.options = options;
+  auto num_fields = Text_format_writer::num_module_fields(module);
+  if (num_threads <= 1 || num_fields <= 1) {
+    w.write_module(module);
+    return;
+  }
+
+  w.write_module_start(module);
+  const auto& start_state = w;  // not touched again until all the fields are out
+  auto boundaries = split_into_batches(module, std::min(num_fields, num_threads * k_batches_per_thread));
+  auto num_batches = boundaries.size() - 1;
+  auto num_workers = std::min(static_cast<size_t>(num_threads), num_batches);
+  auto lookahead = num_workers * k_lookahead_per_thread;
+
+  auto batches = std::vector<Batch>(num_batches);
+  auto next_batch = std::atomic<size_t>{0};
+  auto mutex = std::mutex{};
+  auto batch_done = std::condition_variable{};  // signalled by the workers
+  auto batch_written = std::condition_variable{};  // signalled by the sequencer
+  auto num_written = size_t{0};
+  auto stopping = false;
+
+  auto work = [&] {
+    while (true) {
+      auto batch = next_batch.fetch_add(1, std::memory_order_relaxed);
+      if (batch >= num_batches) { break; }
+      {
+        auto lock = std::unique_lock{mutex};
+        batch_written.wait(lock, [&] { return stopping || batch < num_written + lookahead; });
+        if (stopping) { break; }
+      }
+
+      // On an exception, text keeps what was written up to it (batch_out flushes as it goes away)
+      auto text = std::string{};
+      auto error = std::exception_ptr{};
+      try {
+        auto batch_out = Output_sink{text, k_batch_sink_capacity};
+        auto batch_w = Text_format_writer{batch_out};
+        batch_w.options = start_state.options;
+        batch_w.indent_level = start_state.indent_level;
+        batch_w.need_ws = start_state.need_ws;
+        batch_w.just_closed_sexp = start_state.just_closed_sexp;
+        for (auto i = boundaries[batch]; i != boundaries[batch + 1]; ++i) { batch_w.write_module_field(module, i); }
+      } catch (...) {
+        error = std::current_exception();
+      }
+
+      auto lock = std::lock_guard{mutex};
+      batches[batch] = Batch{.text = std::move(text), .error = error, .done = true};
+      batch_done.notify_all();
+    }
+  };
+
+  {
+    auto workers = std::vector<std::jthread>{};
+    auto stop = [&] {
+      auto lock = std::lock_guard{mutex};
+      stopping = true;
+      batch_written.notify_all();
+    };
+    try {
+      for (auto t = size_t{0}; t != num_workers; ++t) { workers.emplace_back(work); }
+
+      for (auto batch = size_t{0}; batch != num_batches; ++batch) {
+        auto text = std::string{};
+        auto error = std::exception_ptr{};
+        {
+          auto lock = std::unique_lock{mutex};
+          batch_done.wait(lock, [&] { return batches[batch].done; });
+          text = std::move(batches[batch].text);
+          error = batches[batch].error;
+        }
+        out.append(text);
+        if (error) { std::rethrow_exception(error); }
+        {
+          auto lock = std::lock_guard{mutex};
+          num_written = batch + 1;
+          batch_written.notify_all();
+        }
+      }
+    } catch (...) {
+      stop();
+      throw;
+    }
+  }  // joins the workers
+
+  w.write_module_end();
+}
+
+}  // namespace wasmtoolbox
@@ -0,0 +1,41 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WASMTOOLBOX_PARALLEL_WRITE_H
+#define WASMTOOLBOX_PARALLEL_WRITE_H
+
+#include "ast.h"
+#include "output_sink.h"
+#include "text_format.h"
+
+namespace wasmtoolbox {
+
+// Writes `module` to `out` exactly as Text_format_writer::write_module() would, byte for byte, but with its
+// fields (see Text_format_writer::write_module_field()) formatted on up to num_threads threads.
+//
+// The fields are split into batches of roughly equal weight (functions weigh as much as their instructions),
+// which each thread formats into a private buffer with its own writer.  The calling thread sequences the
+// batches: it hands each one to `out` as soon as it and all the ones before it are done.  Threads only run a
+// bounded number of batches ahead of the output, so memory use doesn't grow with the module.
+//
+// If formatting a field throws (e.g., on an invalid identifier), the output stops where the serial writer's
+// would have, and the exception is rethrown once the other threads are done.
+auto write_module_in_parallel(Output_sink& out, const Ast_module& module, int num_threads,
+                              Text_format_options options = {}) -> void;
+
+}  // namespace wasmtoolbox
+
+#endif /* WASMTOOLBOX_PARALLEL_WRITE_H */
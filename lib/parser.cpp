@@ -16,29 +16,267 @@
 
 #include "parser.h"
 
+#include <algorithm>
+#include <bit>
 #include <optional>
 
 #include "absl/log/check.h"
 #include "absl/strings/str_format.h"
 
+#include "leb128.h"
+#include "leb128_simd.h"
+#include "parallel_decode.h"
+
 namespace wasmtoolbox {
 
-auto Wasm_parser::prime() -> void {
-  cur_byte = is_->get();
-  cur_offset = 0;
+namespace {
+
+// Packing of immediates into Ast_instr (see ast.h)
+auto set_memarg(Ast_instr& instr, Ast_memarg memarg) -> void {
+  instr.a = memarg.align;
+  instr.b = memarg.offset;
 }
 
-auto Wasm_parser::skip_bytes(std::streamsize count) -> void {
-  if (count <= 0) { return; }
-  
-  auto offset = cur_offset;
-  is_->ignore(count - 1);
-  if (is_->eof()) {
-    throw std::logic_error(absl::StrFormat(
-        "Unexpected end of file when skipping %d bytes from offset %d", count, offset));
+auto set_imm64(Ast_instr& instr, uint64_t value) -> void {
+  instr.a = static_cast<uint32_t>(value);
+  instr.b = static_cast<uint32_t>(value >> 32);
+}
+
+// Enough bytes for any LEB128-encoded integer of up to 64 bits
+constexpr auto k_max_leb128_size = long{10};
+
+// LEB128 decoding, shared by the bounds-checked and unchecked paths of internal_parse_uN/sN.
+// next_byte() is called at most ceil(N/7) times before the decoder either returns or reports an invalid
+// encoding with invalid(middle_byte) and returns 0.
+auto decode_uN(int N, std::invocable auto next_byte, std::invocable<bool> auto invalid) -> uint64_t {
+  auto result = uint64_t{0};
+  auto N_now = N;
+  auto shift = 0;
+  while (true) {
+    auto n = uint8_t{next_byte()};
+    result |= uint64_t{n & 0x7fu} << shift;
+    if ((n & 0x80) == 0) {
+      // High bit unset => end of number
+      if (N_now < 8 && n >= (1 << N_now)) {
+        invalid(false);
+        return 0;
+      }
+      break;
+    } else {
+      // High bit set => rest of number follows
+      if (N_now <= 7) {
+        invalid(true);
+        return 0;
+      }
+      shift += 7;
+      N_now -= 7;
+    }
+  }
+  return result;
+}
+
+auto decode_sN(int N, std::invocable auto next_byte, std::invocable<bool> auto invalid) -> int64_t {
+  auto result = int64_t{0};
+  auto N_now = N;
+  auto shift = 0;
+  while (true) {
+    auto n = uint8_t{next_byte()};
+    if ((n & 0x80) == 0) {
+      // High bit unset => end of number
+      if ((n & 0x40) == 0) {  // it's a positive number
+        if (N_now < 8 && n >= (1 << (N_now - 1))) {
+          invalid(false);
+          return 0;
+        }
+        result |= static_cast<int64_t>(uint64_t{n & 0x3fu} << shift);
+      } else {  // it's a negative number
+        if (N_now < 8 && n < ((1 << 7) - (1 << (N_now - 1)))) {
+          invalid(false);
+          return 0;
+        }
+        // Sign-extend from the top bit of this byte (shift left as unsigned to avoid UB for negative values)
+        result |= static_cast<int64_t>(static_cast<uint64_t>(int64_t{n} - int64_t{0x80}) << shift);
+      }
+      break;
+    } else {
+      // High bit set => rest of number follows
+      if (N_now <= 7) {
+        invalid(true);
+        return 0;
+      }
+      result |= static_cast<int64_t>(uint64_t{n & 0x7fu} << shift);
+      shift += 7;
+      N_now -= 7;
+    }
+  }
+  return result;
+}
+
+auto valtype_name(int64_t t) -> std::string_view {
+  switch (t) {
+    case k_numtype_i32: return "i32";
+    case k_numtype_i64: return "i64";
+    case k_numtype_f32: return "f32";
+    case k_numtype_f64: return "f64";
+    case k_vectype_v128: return "v128";
+    case k_reftype_funcref: return "funcref";
+    case k_reftype_externref: return "externref";
+    default: return "?";
+  }
+}
+
+auto index_space_name(int64_t space) -> std::string_view {
+  switch (static_cast<Ast_index_space>(space)) {
+    case Ast_index_space::k_type: return "type";
+    case Ast_index_space::k_func: return "function";
+    case Ast_index_space::k_table: return "table";
+    case Ast_index_space::k_mem: return "memory";
+    case Ast_index_space::k_global: return "global";
+    case Ast_index_space::k_tag: return "tag";
+    case Ast_index_space::k_elem: return "element segment";
+    case Ast_index_space::k_data: return "data segment";
+    case Ast_index_space::k_local: return "local";
+    case Ast_index_space::k_label: return "label";
+  }
+  return "?";
+}
+
+}  // namespace
+
+auto Parse_error::message() const -> std::string {
+  auto [a, b, c] = args;
+  switch (code) {
+    case Parse_error_code::k_unexpected_eof:
+      return absl::StrFormat("Unexpected end of file at offset %d", offset);
+    case Parse_error_code::k_unexpected_end_of_section:
+      return absl::StrFormat("Unexpected end of section id %d at offset %d", section.value_or(k_section_custom), offset);
+    case Parse_error_code::k_truncated_read:
+      return absl::StrFormat("Unexpected end of file when reading %d bytes from offset %d", a, offset);
+    case Parse_error_code::k_truncated_skip:
+      return absl::StrFormat("Unexpected end of file when skipping %d bytes from offset %d", a, offset);
+    case Parse_error_code::k_vector_too_long:
+      return absl::StrFormat("Vector of %d elements at offset %d can't fit in the %d bytes remaining", a, offset, b);
+    case Parse_error_code::k_unexpected_byte:
+      return absl::StrFormat("Expected byte 0x%02x at offset %d, found 0x%02x instead", a, offset, b);
+    case Parse_error_code::k_invalid_leb128:
+      return absl::StrFormat("Invalid encoding of %c%d at offset %d: more than %d bits in encoded by %s byte",
+                             b ? 's' : 'u', a, offset, a, c ? "middle" : "trailing");
+    case Parse_error_code::k_unrecognized_numtype:
+      return absl::StrFormat("Unrecognized numtype 0x%02x at offset %d", a, offset);
+    case Parse_error_code::k_unrecognized_vectype:
+      return absl::StrFormat("Unrecognized vectype 0x%02x at offset %d", a, offset);
+    case Parse_error_code::k_unrecognized_reftype:
+      return absl::StrFormat("Unrecognized reftype 0x%02x at offset %d", a, offset);
+    case Parse_error_code::k_unrecognized_valtype:
+      return absl::StrFormat("Unrecognized valtype 0x%02x at offset %d", a, offset);
+    case Parse_error_code::k_unrecognized_limits:
+      return absl::StrFormat("Unrecognized limits flags 0x%02x at offset %d", a, offset);
+    case Parse_error_code::k_unrecognized_mut:
+      return absl::StrFormat("Unrecognized mut type 0x%02x at offset %d", a, offset);
+    case Parse_error_code::k_unrecognized_opcode:
+      return absl::StrFormat("Unrecognized instruction opcode 0x%02x at offset %d", a, offset);
+    case Parse_error_code::k_unrecognized_atomic_opcode:
+      return absl::StrFormat("Unrecognized atomic memory instruction secondary opcode 0x%02x at offset %d", a, offset);
+    case Parse_error_code::k_unrecognized_ext_opcode:
+      return absl::StrFormat("Unrecognized extended instruction secondary opcode %d at offset %d", a, offset);
+    case Parse_error_code::k_unrecognized_simd_opcode:
+      return absl::StrFormat("Unrecognized vector instruction secondary opcode %d at offset %d", a, offset);
+    case Parse_error_code::k_too_deeply_nested:
+      return absl::StrFormat("Block at offset %d nested more than %d deep", offset, a);
+    case Parse_error_code::k_invalid_blocktype:
+      return absl::StrFormat("Invalid blocktype %d at offset %d: not a typeidx", a, offset);
+    case Parse_error_code::k_unrecognized_importdesc:
+      return absl::StrFormat("Unrecognized importdesc type 0x%02x at offset %d", a, offset);
+    case Parse_error_code::k_unrecognized_exportdesc:
+      return absl::StrFormat("Unrecognized exportdesc type 0x%02x at offset %d", a, offset);
+    case Parse_error_code::k_unrecognized_elem:
+      return absl::StrFormat("Unrecognized elem discriminant %d at offset %d", a, offset);
+    case Parse_error_code::k_unrecognized_data:
+      return absl::StrFormat("Unrecognized data discriminant %d at offset %d", a, offset);
+    case Parse_error_code::k_section_too_long:
+      return absl::StrFormat("Section id %d at offset %d declares size %d, past the end of the input at offset %d",
+                             a, offset, b, c);
+    case Parse_error_code::k_section_size_mismatch:
+      return absl::StrFormat(
+          "Invalid section id %d in byte range [%d,%d): declared size %d doesn't match actual size %d",
+          a, offset, offset + c, b, c);
+    case Parse_error_code::k_name_subsection_too_long:
+      return absl::StrFormat(
+          "Name subsection id %d at offset %d declares size %d, past the end of its section at offset %d",
+          a, offset, b, c);
+    case Parse_error_code::k_name_subsection_size_mismatch:
+      return absl::StrFormat(
+          "Invalid name subsection id %d in byte range [%d,%d): declared size %d doesn't match actual size %d",
+          a, offset, offset + c, b, c);
+    case Parse_error_code::k_code_size_mismatch:
+      return absl::StrFormat(
+          "Invalid code entry in byte range [%d,%d): declared size %d doesn't match actual size %d",
+          offset, offset + b, a, b);
+    case Parse_error_code::k_trailing_data:
+      return absl::StrFormat("Expected end of file at offset %d, but the data continues: 0x%02x...", offset, a);
+
+    case Parse_error_code::k_type_mismatch:
+      return absl::StrFormat("Type mismatch at offset %d: expected %s, found %s",
+                             offset, a < 0 ? "any value" : valtype_name(a), b < 0 ? "nothing" : valtype_name(b));
+    case Parse_error_code::k_unknown_index:
+      return absl::StrFormat("Unknown %s index %d at offset %d", index_space_name(a), b, offset);
+    case Parse_error_code::k_immutable_global:
+      return absl::StrFormat("Global %d set at offset %d is immutable", a, offset);
+    case Parse_error_code::k_invalid_alignment:
+      return absl::StrFormat("Alignment 2^%d at offset %d is invalid for an access of natural alignment 2^%d",
+                             a, offset, b);
+    case Parse_error_code::k_invalid_lane_index:
+      return absl::StrFormat("Lane index %d at offset %d is out of range for %d lanes", a, offset, b);
+    case Parse_error_code::k_unused_values:
+      return absl::StrFormat("Block ending at offset %d leaves %d unused values on the stack", offset, a);
+    case Parse_error_code::k_label_arity_mismatch:
+      return absl::StrFormat("Labels of br_table at offset %d have different arities: %d vs %d", offset, a, b);
+    case Parse_error_code::k_invalid_select_arity:
+      return absl::StrFormat("Typed select at offset %d has %d types instead of 1", offset, a);
+    case Parse_error_code::k_untyped_select_of_reftype:
+      return absl::StrFormat("Select without types at offset %d can't choose between %s values",
+                             offset, valtype_name(a));
+    case Parse_error_code::k_invalid_rethrow:
+      return absl::StrFormat("Label %d of rethrow at offset %d isn't a catch block", a, offset);
+    case Parse_error_code::k_missing_data_count:
+      return absl::StrFormat("Instruction at offset %d needs a data count section", offset);
+    case Parse_error_code::k_too_many_locals:
+      return absl::StrFormat("Function at offset %d has more than 2^32 locals", offset);
+    case Parse_error_code::k_func_count_mismatch:
+      return absl::StrFormat("Code section at offset %d doesn't match the %d functions of the function section "
+                             "(seen %d)", offset, a, b);
+  }
+  return absl::StrFormat("Parse error %d at offset %d", static_cast<int>(code), offset);
+}
+
+template<Byte_source Source>
+auto Wasm_parser<Source>::fail(Parse_error_code code, long offset, int64_t arg0, int64_t arg1, int64_t arg2)
+    -> void {
+  fail(Parse_error{code, offset, cur_section, {arg0, arg1, arg2}});
+}
+
+template<Byte_source Source>
+auto Wasm_parser<Source>::fail(const Parse_error& error) -> void {
+  if (throw_errors) {
+    throw std::logic_error(error.message());
+  }
+  if (ok()) {
+    first_error = error;
+  }
+}
+
+auto Section_index::find(Section_id id) const -> const Section_entry* {
+  for (const auto& entry : sections) {
+    if (entry.id == id) { return &entry; }
+  }
+  return nullptr;
+}
+
+template<Byte_source Source>
+auto Wasm_parser<Source>::skip_bytes(std::streamsize count) -> void {
+  if (not src_.skip(count)) {
+    fail(Parse_error_code::k_truncated_skip, cur_offset(), count);
   }
-  cur_byte = is_->get();
-  cur_offset += count;
 }
 
 // 5.1 Conventions
@@ -47,16 +285,23 @@ auto Wasm_parser::skip_bytes(std::streamsize count) -> void {
 // 5.1.3 Vectors
 // -------------
 
-auto Wasm_parser::parse_vec(std::invocable<uint32_t /*i*/> auto element_parser)
-    -> std::vector<decltype(element_parser(0))> {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_vec(std::invocable<uint32_t /*i*/> auto element_parser)
+    -> std::pmr::vector<decltype(element_parser(0))> {
   using Elem_type = decltype(element_parser(0));
-  auto result = std::vector<Elem_type>{};
+  auto result = std::pmr::vector<Elem_type>{resource};
   
   auto n = parse_u32();
+  // Every element takes at least one byte, which bounds n before we allocate anything.  (For a stream, whose
+  // length isn't known, the bound is the end of the current section.)
+  if (auto bytes_left = src_.limit() - cur_offset(); n > bytes_left) {
+    fail(Parse_error_code::k_vector_too_long, cur_offset(), n, bytes_left);
+    return result;
+  }
   result.reserve(n);
   CHECK_NE(n, std::numeric_limits<uint32_t>::max()) << "would overflow loop!";
   
-  for (auto i = uint32_t{0}; i != n; ++i) {
+  for (auto i = uint32_t{0}; i != n && ok(); ++i) {
     result.push_back(std::invoke(element_parser, i));
   }
 
@@ -64,34 +309,112 @@ auto Wasm_parser::parse_vec(std::invocable<uint32_t /*i*/> auto element_parser)
 }
 
 
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_u32_vec(std::pmr::vector<uint32_t>& out) -> void {
+  auto n = parse_u32();
+  // As in parse_vec()
+  if (auto bytes_left = src_.limit() - cur_offset(); n > bytes_left) {
+    fail(Parse_error_code::k_vector_too_long, cur_offset(), n, bytes_left);
+    out.clear();
+    return;
+  }
+  out.resize(n);
+  auto i = uint32_t{0};
+  if constexpr (Source::k_contiguous) {
+    auto [count, size] = bulk_decode_u32(src_.data(), src_.data() + src_.available(), out.data(), n);
+    src_.advance(size);
+    i = static_cast<uint32_t>(count);
+  }
+
+  // Whatever the bulk decoder left over (the end of the input, or an invalid encoding to diagnose)
+  for (; i != n && ok(); ++i) {
+    out[i] = parse_u32();
+  }
+}
+
+
 // 5.2 Values
 // ==========
 
 // 5.2.1 Bytes
 // -----------
 
-auto Wasm_parser::parse_byte() -> uint8_t {
-  if (is_->eof()) {
-    throw std::logic_error(absl::StrFormat(
-        "Unexpected end of file at offset %d", cur_offset));
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_byte() -> uint8_t {
+  if (at_eof()) {
+    fail(cur_section.has_value() && cur_offset() == src_.limit()
+         ? Parse_error_code::k_unexpected_end_of_section
+         : Parse_error_code::k_unexpected_eof,
+         cur_offset());
+    return 0;
+  }
+  return src_.next();
+}
+
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_bytes(uint8_t* dst, long count) -> void {
+  auto offset = cur_offset();
+  if (not src_.read(dst, count)) {
+    fail(Parse_error_code::k_truncated_read, offset, count);
   }
-  auto result = cur_byte;
-  cur_byte = static_cast<uint8_t>(is_->get());
-  ++cur_offset;
-  return result;
 }
 
-auto Wasm_parser::match_byte(uint8_t expected) -> void {
-  auto offset = cur_offset;
+// Bytes to keep in the AST as they are: a span into the input if possible, or else a copy in the module's arena
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_kept_bytes(Ast_module& module, long count) -> std::span<const uint8_t> {
+  if (count > src_.limit() - cur_offset()) {
+    fail(Parse_error_code::k_truncated_read, cur_offset(), count);
+    return {};
+  }
+  if constexpr (Source::k_contiguous) {
+    if (not options.copy_bytes) {
+      auto result = std::span{src_.data(), static_cast<size_t>(count)};
+      src_.advance(count);
+      return result;
+    }
+  }
+  auto storage = module.arena.allocate_bytes(count);
+  parse_bytes(storage, count);
+  return {storage, static_cast<size_t>(count)};
+}
+
+// Like parse_kept_bytes, but for whatever `parse` consumes (e.g., an expression)
+template<Byte_source Source>
+auto Wasm_parser<Source>::capture_kept_bytes(Ast_module& module, std::invocable<> auto parse)
+    -> std::span<const uint8_t> {
+  auto bytes = std::span<const uint8_t>{};
+  auto captured = std::vector<uint8_t>{};
+  if constexpr (Source::k_contiguous) {
+    auto start = src_.data();
+    parse();
+    bytes = {start, src_.data()};
+    if (not options.copy_bytes) { return bytes; }
+  } else {
+    struct Untap {
+      Source& src;
+      ~Untap() { src.tap_ = nullptr; }
+    } untap{src_};
+    src_.tap_ = &captured;
+    parse();
+    bytes = captured;
+  }
+  auto storage = module.arena.allocate_bytes(bytes.size());
+  std::copy(bytes.begin(), bytes.end(), storage);
+  return {storage, bytes.size()};
+}
+
+template<Byte_source Source>
+auto Wasm_parser<Source>::match_byte(uint8_t expected) -> void {
+  auto offset = cur_offset();
   auto actual = parse_byte();
-  if (actual != expected) {
-    throw std::logic_error(absl::StrFormat(
-        "Expected byte 0x%02x at offset %d, found 0x%02x instead", expected, offset, actual));
+  if (actual != expected && ok()) {
+    fail(Parse_error_code::k_unexpected_byte, offset, expected, actual);
   }
 }
 
-auto Wasm_parser::maybe_match_byte(uint8_t probe) -> bool {
-  if (cur_byte == probe) {
+template<Byte_source Source>
+auto Wasm_parser<Source>::maybe_match_byte(uint8_t probe) -> bool {
+  if (cur_byte() == probe) {
     (void) parse_byte();
     return true;
   } else {
@@ -102,151 +425,172 @@ auto Wasm_parser::maybe_match_byte(uint8_t probe) -> bool {
 // 5.2.2 Integers
 // --------------
 
-auto Wasm_parser::parse_u8() -> uint8_t {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_u8() -> uint8_t {
   return static_cast<uint8_t>(internal_parse_uN(8));
 }
 
-auto Wasm_parser::parse_u16() -> uint16_t {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_u16() -> uint16_t {
   return static_cast<uint16_t>(internal_parse_uN(16));
 }
 
-auto Wasm_parser::parse_u32() -> uint32_t {
-  return static_cast<uint32_t>(internal_parse_uN(32));
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_u32() -> uint32_t {
+  return static_cast<uint32_t>(internal_fast_parse_uN<32>());
 }
 
-auto Wasm_parser::internal_parse_uN(int N) -> uint64_t {
+template<Byte_source Source>
+auto Wasm_parser<Source>::internal_parse_uN(int N) -> uint64_t {
   DCHECK_GE(N, 0);
   DCHECK_LE(N, 64);
-  auto offset = cur_offset;
-  auto result = uint64_t{0};
-  auto N_now = N;
-  auto shift = 0;
-  while (true) {
-    auto n = parse_byte();
-    result |= (n & 0x7f) << shift;
-    if ((n & 0x80) == 0) {
-      // High bit unset => end of number
-      if (N_now < 8 && n >= (1 << N_now)) {
-        throw std::logic_error(absl::StrFormat(
-            "Invalid encoding of u%d at offset %d: more than %d bits in encoded by trailing byte",
-            N, offset, N));
-      }
-      break;
-    } else {
-      // High bit set => rest of number follows
-      if (N_now <= 7) {
-        throw std::logic_error(absl::StrFormat(
-            "Invalid enconding of u%d at offset %d: more than %d bits in encoded by middle byte",
-            N, offset, N));
+  auto offset = cur_offset();
+  auto invalid = [&](bool middle_byte) { fail(Parse_error_code::k_invalid_leb128, offset, N, 0, middle_byte); };
+  if constexpr (Source::k_contiguous) {
+    // A valid encoding never needs more than k_max_leb128_size bytes, so one bounds check covers them all
+    if (src_.available() >= k_max_leb128_size) {
+      auto p = src_.data();
+      auto result = decode_uN(N, [&] { return *p++; }, invalid);
+      src_.advance(p - src_.data());
+      return result;
+    }
+  }
+  return decode_uN(N, [&] { return parse_byte(); }, invalid);
+}
+
+template<Byte_source Source>
+template<int N>
+auto Wasm_parser<Source>::internal_fast_parse_uN() -> uint64_t {
+  if constexpr (Source::k_contiguous) {
+    if (src_.available() >= k_leb128_fast_path_bytes<N>) {
+      auto [value, size] = fast_decode_uN<N>(src_.data());
+      if (size != 0) {
+        src_.advance(size);
+        return value;
       }
-      shift += 7;
-      N_now -= 7;
+      // Otherwise, the encoding is invalid: let internal_parse_uN() diagnose it
     }
   }
-  return result;
+  return internal_parse_uN(N);
 }
 
-auto Wasm_parser::parse_s8() -> int8_t {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_s8() -> int8_t {
   return static_cast<int8_t>(internal_parse_sN(8));
 }
 
-auto Wasm_parser::parse_s16() -> int16_t {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_s16() -> int16_t {
   return static_cast<int16_t>(internal_parse_sN(16));
 }
 
-auto Wasm_parser::parse_s33() -> int64_t {
-  return static_cast<int64_t>(internal_parse_sN(33));
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_s33() -> int64_t {
+  return static_cast<int64_t>(internal_fast_parse_sN<33>());
 }
 
-auto Wasm_parser::internal_parse_sN(int N) -> int64_t {
+template<Byte_source Source>
+auto Wasm_parser<Source>::internal_parse_sN(int N) -> int64_t {
   DCHECK_GE(N, 0);
   DCHECK_LE(N, 64);
-  auto offset = cur_offset;
-  auto result = int64_t{0};
-  auto N_now = N;
-  auto shift = 0;
-  while (true) {
-    auto n = parse_byte();
-    if ((n & 0x80) == 0) {
-      // High bit unset => end of number
-      if ((n & 0x40) == 0) {  // it's a positive number
-        if (N_now < 8 && n >= (1 << (N_now - 1))) {
-          throw std::logic_error(absl::StrFormat(
-              "Invalid encoding of s%d at offset %d: more than %d bits in encoded by trailing byte",
-              N, offset, N));
-        }
-        result |= (n & 0x3f) << shift;
-      } else {  // it's a negative number
-        if (N_now < 8 && n < ((1 << 7) - (1 << (N_now - 1)))) {
-          throw std::logic_error(absl::StrFormat(
-              "Invalid encoding of s%d at offset %d: more than %d bits in encoded by trailing byte",
-              N, offset, N));
-        }
-        result |= (int64_t{n} - int64_t{0x80}) << shift;
-      }
-      break;
-    } else {
-      // High bit set => rest of number follows
-      if (N_now <= 7) {
-        throw std::logic_error(absl::StrFormat(
-            "Invalid enconding of s%d at offset %d: more than %d bits in encoded by middle byte",
-            N, offset, N));
+  auto offset = cur_offset();
+  auto invalid = [&](bool middle_byte) { fail(Parse_error_code::k_invalid_leb128, offset, N, 1, middle_byte); };
+  if constexpr (Source::k_contiguous) {
+    if (src_.available() >= k_max_leb128_size) {
+      auto p = src_.data();
+      auto result = decode_sN(N, [&] { return *p++; }, invalid);
+      src_.advance(p - src_.data());
+      return result;
+    }
+  }
+  return decode_sN(N, [&] { return parse_byte(); }, invalid);
+}
+
+template<Byte_source Source>
+template<int N>
+auto Wasm_parser<Source>::internal_fast_parse_sN() -> int64_t {
+  if constexpr (Source::k_contiguous) {
+    if (src_.available() >= k_leb128_fast_path_bytes<N>) {
+      auto [value, size] = fast_decode_sN<N>(src_.data());
+      if (size != 0) {
+        src_.advance(size);
+        return value;
       }
-      result |= (n & 0x7f) << shift;
-      shift += 7;
-      N_now -= 7;
     }
   }
-  return result;
+  return internal_parse_sN(N);
 }
 
-auto Wasm_parser::parse_i32() -> int32_t {
-  return static_cast<int32_t>(internal_parse_sN(32));
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_i32() -> int32_t {
+  return static_cast<int32_t>(internal_fast_parse_sN<32>());
 }
 
-auto Wasm_parser::parse_i64() -> int64_t {
-  return static_cast<int64_t>(internal_parse_sN(64));
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_i64() -> int64_t {
+  return static_cast<int64_t>(internal_fast_parse_sN<64>());
 }
 
 // 5.2.3 Floating-Point
 // --------------------
 
-auto Wasm_parser::parse_f32() -> float {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_f32() -> float {
+  uint8_t b[4] = {};
+  parse_bytes(b, 4);
   auto bits = uint32_t{0};
-  bits |= parse_byte() <<  0;
-  bits |= parse_byte() <<  8;
-  bits |= parse_byte() << 16;
-  bits |= parse_byte() << 24;
+  bits |= uint32_t{b[0]} <<  0;
+  bits |= uint32_t{b[1]} <<  8;
+  bits |= uint32_t{b[2]} << 16;
+  bits |= uint32_t{b[3]} << 24;
   return std::bit_cast<float>(bits);
 }
 
-auto Wasm_parser::parse_f64() -> double {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_f64() -> double {
+  uint8_t b[8] = {};
+  parse_bytes(b, 8);
   auto bits = uint64_t{0};
-  bits |= uint64_t{parse_byte()} <<  0;
-  bits |= uint64_t{parse_byte()} <<  8;
-  bits |= uint64_t{parse_byte()} << 16;
-  bits |= uint64_t{parse_byte()} << 24;
-  bits |= uint64_t{parse_byte()} << 32;
-  bits |= uint64_t{parse_byte()} << 40;
-  bits |= uint64_t{parse_byte()} << 48;
-  bits |= uint64_t{parse_byte()} << 56;
+  bits |= uint64_t{b[0]} <<  0;
+  bits |= uint64_t{b[1]} <<  8;
+  bits |= uint64_t{b[2]} << 16;
+  bits |= uint64_t{b[3]} << 24;
+  bits |= uint64_t{b[4]} << 32;
+  bits |= uint64_t{b[5]} << 40;
+  bits |= uint64_t{b[6]} << 48;
+  bits |= uint64_t{b[7]} << 56;
   return std::bit_cast<double>(bits);
 }
 
 // 5.2.4 Names
 // -----------
 
-auto Wasm_parser::parse_name() -> std::string {
-  // Don't use parse_vec to avoid creating a std::vector<char> followed by a copy
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_name() -> std::string_view {
+  // Bulk copy (or none at all), rather than a vec(byte) one byte at a time
   auto n = parse_u32();
-  auto result = std::string{};
-  result.reserve(n);
-  CHECK_NE(n, std::numeric_limits<uint32_t>::max()) << "would overflow loop!";
-  for (auto i = uint32_t{0}; i != n; ++i) {
-    result.push_back(parse_byte());
+  if (n > src_.limit() - cur_offset()) {
+    fail(Parse_error_code::k_truncated_read, cur_offset(), n);
+    return {};
   }
+  if constexpr (Source::k_contiguous) {
+    auto result = std::string_view{reinterpret_cast<const char*>(src_.data()), n};
+    src_.advance(n);
+    return result;
+  } else {
+    scratch_name.resize(n);
+    parse_bytes(reinterpret_cast<uint8_t*>(scratch_name.data()), n);
+    return scratch_name;
+  }
+}
 
-  return result;
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_kept_name(Ast_module& module) -> Ast_name {
+  auto name = parse_name();
+  if constexpr (Source::k_contiguous) {
+    if (not options.copy_bytes) { return name; }
+  }
+  return module.interned_names.intern(name);
 }
 
 // 5.3 Types
@@ -255,8 +599,9 @@ auto Wasm_parser::parse_name() -> std::string {
 // 5.3.1 Number Types
 // ------------------
 
-auto Wasm_parser::parse_numtype() -> Ast_numtype {
-  auto b_offset = cur_offset;
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_numtype() -> Ast_numtype {
+  auto b_offset = cur_offset();
   auto b = parse_byte();
   switch (b) {
     case 0x7F: return k_numtype_i32;
@@ -264,45 +609,48 @@ auto Wasm_parser::parse_numtype() -> Ast_numtype {
     case 0x7D: return k_numtype_f32;
     case 0x7C: return k_numtype_f64;
     default:
-      throw std::logic_error(absl::StrFormat(
-          "Unrecognized numtype 0x%02x at offset %d", b, b_offset));
+      fail(Parse_error_code::k_unrecognized_numtype, b_offset, b);
+      return k_numtype_i32;
   }
 }
 
 // 5.3.2 Vector Types
 // ------------------
 
-auto Wasm_parser::parse_vectype() -> Ast_vectype {
-  auto b_offset = cur_offset;
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_vectype() -> Ast_vectype {
+  auto b_offset = cur_offset();
   auto b = parse_byte();
   switch (b) {
     case 0x7B: return k_vectype_v128;
     default:
-      throw std::logic_error(absl::StrFormat(
-          "Unrecognized vectype 0x%02x at offset %d", b, b_offset));
+      fail(Parse_error_code::k_unrecognized_vectype, b_offset, b);
+      return k_vectype_v128;
   }
 }
 
 // 5.3.3 Reference Types
 // ---------------------
 
-auto Wasm_parser::parse_reftype() -> Ast_reftype {
-  auto b_offset = cur_offset;
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_reftype() -> Ast_reftype {
+  auto b_offset = cur_offset();
   auto b = parse_byte();
   switch (b) {
     case 0x70: return k_reftype_funcref;
     case 0x6F: return k_reftype_externref;
     default:
-      throw std::logic_error(absl::StrFormat(
-          "Unrecognized reftype 0x%02x at offset %d", b, b_offset));
+      fail(Parse_error_code::k_unrecognized_reftype, b_offset, b);
+      return k_reftype_funcref;
   }
 }
 
 // 5.3.4 Value Types
 // -----------------
 
-auto Wasm_parser::can_parse_valtype() -> bool {
-  switch (cur_byte) {
+template<Byte_source Source>
+auto Wasm_parser<Source>::can_parse_valtype() -> bool {
+  switch (cur_byte()) {
     case 0x7F:
     case 0x7E:
     case 0x7D:
@@ -316,8 +664,9 @@ auto Wasm_parser::can_parse_valtype() -> bool {
   }
 }
 
-auto Wasm_parser::parse_valtype() -> Ast_valtype {
-  switch (cur_byte) {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_valtype() -> Ast_valtype {
+  switch (cur_byte()) {
     case 0x7F:
     case 0x7E:
     case 0x7D:
@@ -329,97 +678,120 @@ auto Wasm_parser::parse_valtype() -> Ast_valtype {
     case 0x6F:
       return parse_reftype();
     default:
-      throw std::logic_error(absl::StrFormat(
-          "Unrecognized valtype 0x%02x at offset %d", cur_byte, cur_offset));
+      fail(Parse_error_code::k_unrecognized_valtype, cur_offset(), cur_byte());
+      return k_numtype_i32;
   }
 }
 
 // 5.3.5 Result Types
 // ------------------
 
-auto Wasm_parser::parse_resulttype() -> Ast_resulttype {
-  return parse_vec([&](auto /*i*/) {
-    return parse_valtype();
-  });
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_resulttype(std::pmr::vector<Ast_valtype>& out) -> void {
+  auto n = parse_u32();
+  // As in parse_vec()
+  if (auto bytes_left = src_.limit() - cur_offset(); n > bytes_left) {
+    fail(Parse_error_code::k_vector_too_long, cur_offset(), n, bytes_left);
+    return;
+  }
+  out.reserve(out.size() + n);
+  for (auto i = uint32_t{0}; i != n && ok(); ++i) {
+    out.push_back(parse_valtype());
+  }
 }
 
 // 5.3.6 Function Types
 // --------------------
 
-auto Wasm_parser::parse_functype() -> Ast_functype {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_functype() -> Ast_functype {
   match_byte(0x60);
-  auto params = parse_resulttype();
-  auto results = parse_resulttype();
+  scratch_valtypes.clear();
+  parse_resulttype(scratch_valtypes);
+  auto num_params = scratch_valtypes.size();
+  parse_resulttype(scratch_valtypes);
+  auto valtypes = std::span<const Ast_valtype>{scratch_valtypes};
   return Ast_functype{
-    .params = std::move(params),
-    .results = std::move(results)
+    .params = valtypes.first(num_params),
+    .results = valtypes.subspan(num_params)
   };
 }
 
 // 5.3.7 Limits
 // ------------
-auto Wasm_parser::parse_limits() -> void {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_limits() -> Ast_limits {
   // Including thread extensions
-  auto b_offset = cur_offset;
+  auto b_offset = cur_offset();
   auto b = parse_byte();
+  auto result = Ast_limits{};
   switch (b) {
     case 0x00:     // unshared, min-only
-      parse_u32();  // n
+      result.min = parse_u32();  // n
       break;
     case 0x01:     // unshared, min-max
-      parse_u32();  // n
-      parse_u32();  // m
+      result.min = parse_u32();  // n
+      result.max = parse_u32();  // m
       break;
     case 0x02:     // shared, min-only
-      parse_u32();  // n
+      result.min = parse_u32();  // n
+      result.shared = true;
       break;
     case 0x03:     // shared, min-max
-      parse_u32();  // n
-      parse_u32();  // m
+      result.min = parse_u32();  // n
+      result.max = parse_u32();  // m
+      result.shared = true;
       break;
     default:
-      throw std::logic_error(absl::StrFormat(
-          "Unrecognized limits flags 0x%02x at offset %d", b, b_offset));
+      fail(Parse_error_code::k_unrecognized_limits, b_offset, b);
   }
+  return result;
 }
 
 // 5.3.8 Memory Types
 // ------------------
-auto Wasm_parser::parse_memtype() -> void {
-  parse_limits(); // lim
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_memtype() -> Ast_memtype {
+  return parse_limits(); // lim
 }
 
 // 5.3.9 Table Types
 // -----------------
 
-auto Wasm_parser::parse_tabletype() -> void {
-  parse_reftype(); // et
-  parse_limits();  // lim
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_tabletype() -> Ast_tabletype {
+  auto et = parse_reftype();
+  auto lim = parse_limits();
+  return Ast_tabletype{.et = et, .limits = lim};
 }
 
 // 5.3.10 Global Types
 // -------------------
 
-auto Wasm_parser::parse_globaltype() -> void {
-  parse_valtype(); // t
-  parse_mut();
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_globaltype() -> Ast_globaltype {
+  auto t = parse_valtype();
+  auto m = parse_mut();
+  return Ast_globaltype{.t = t, .mut = m};
 }
 
-auto Wasm_parser::parse_mut() -> void {
-  auto b_offset = cur_offset;
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_mut() -> Ast_mut {
+  auto b_offset = cur_offset();
   auto b = parse_byte();
   switch (b) {
-    case 0x00: return;  // const
-    case 0x01: return;  // var
+    case 0x00: return Ast_mut::k_const;
+    case 0x01: return Ast_mut::k_var;
     default:
-      throw std::logic_error(absl::StrFormat(
-          "Unrecognized mut type 0x%02x at offset %d", b, b_offset));
+      fail(Parse_error_code::k_unrecognized_mut, b_offset, b);
+      return Ast_mut::k_const;
   }
 }
 
 // [EXTRA] Tag Types (5.3.11 in the Exception Handling Spec)
 
-auto Wasm_parser::parse_tagtype() -> void {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_tagtype() -> void {
   match_byte(0x00);
   parse_functype();  // f
 }
@@ -429,318 +801,259 @@ auto Wasm_parser::parse_tagtype() -> void {
 // ================
 
 // <instr> is defined over several subsections...
-auto Wasm_parser::parse_instr() -> void {
-  // Instructions added here as needed for parsing
-  auto opcode_offset = cur_offset;
+//
+// Appends the instruction to out.body (see Ast_instr).  Blocks aren't decoded recursively: the ones still
+// open are kept in control_stack, which parse_expr() sets up, so nesting costs no native stack.  Returns
+// whether the instruction was the end of the expression.  What to decode after the opcode comes from the
+// tables in opcodes.h.
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_instr(Ast_func& out) -> bool {
+  auto opcode_offset = cur_offset();
   auto opcode = parse_byte();
-  switch (opcode) {
-
-    // 5.4.1 Control Instructions
-    case k_instr_unreachable: break;
-    case k_instr_nop: break;
-    case k_instr_block: {
-      parse_blocktype();
-      while (cur_byte != k_instr_end) {
-        parse_instr();
-      }
-      match_byte(k_instr_end);
+  auto i = static_cast<uint32_t>(out.body.size());
+  out.body.push_back(Ast_instr{.opcode = opcode});
+  auto kind = k_instr_imm_kinds[opcode];
+  switch (kind) {
+    case Imm_kind::k_invalid:
+      fail(Parse_error_code::k_unrecognized_opcode, opcode_offset, opcode);
       break;
-    }
-    case k_instr_loop: {
-      parse_blocktype();
-      while (cur_byte != k_instr_end) {
-        parse_instr();
+    case Imm_kind::k_block:
+      out.body[i].a = parse_blocktype();
+      if (control_stack.size() >= options.max_nesting) {
+        fail(Parse_error_code::k_too_deeply_nested, opcode_offset, options.max_nesting);
+        break;
       }
-      match_byte(k_instr_end);
+      control_stack.push_back(Control_frame{.block = i, .clause = opcode});
+      break;
+    case Imm_kind::k_structured:
+      return parse_clause(out, i, opcode_offset);
+    case Imm_kind::k_br_table: {
+      parse_u32_vec(scratch_u32s);  // l*
+      auto& labels = out.br_table_labels;
+      out.body[i].a = static_cast<uint32_t>(labels.size());
+      out.body[i].b = static_cast<uint32_t>(scratch_u32s.size() + 1);
+      labels.insert(labels.end(), scratch_u32s.begin(), scratch_u32s.end());
+      labels.push_back(parse_labelidx());  // l_N
       break;
     }
-    case k_instr_if: {
-      parse_blocktype();
-      while (cur_byte != k_instr_else && cur_byte != k_instr_end) {
-        parse_instr();
-      }
-      if (cur_byte == k_instr_else) {
-        match_byte(k_instr_else);
-        while (cur_byte != k_instr_end) {
-          parse_instr();
-        }
-      }
-      match_byte(k_instr_end);
+    case Imm_kind::k_select_t: {
+      auto n = parse_u32();  // t*, kept with the br_table labels
+      auto& pool = out.br_table_labels;
+      out.body[i].a = static_cast<uint32_t>(pool.size());
+      out.body[i].b = n;
+      for (auto j = uint32_t{0}; j != n && ok(); ++j) { pool.push_back(parse_valtype()); }
       break;
     }
-    case k_instr_try: {
-      parse_blocktype();
-      while (cur_byte != k_instr_catch &&
-             cur_byte != k_instr_catch_all &&
-             cur_byte != k_instr_delegate &&
-             cur_byte != k_instr_end) {
-        parse_instr();
-      }
-      if (cur_byte == k_instr_delegate) {
-        // try-delegate
-        match_byte(k_instr_delegate);
-        parse_labelidx();
+    case Imm_kind::k_prefix: {
+      auto kind2 = parse_secondary_opcode(out.body[i]);
+      if (kind2 == Imm_kind::k_v128 || kind2 == Imm_kind::k_shuffle) {
+        out.body[i].a = static_cast<uint32_t>(out.v128_imms.size());
+        out.v128_imms.push_back(parse_v128());
       } else {
-        // try-catch
-        while (cur_byte == k_instr_catch) {
-          match_byte(k_instr_catch);
-          parse_tagidx();
-          while (cur_byte != k_instr_catch && cur_byte != k_instr_catch_all && cur_byte != k_instr_end) {
-            parse_instr();
-          }
-        }
-        while (cur_byte == k_instr_catch_all) {
-          match_byte(k_instr_catch_all);
-          while (cur_byte != k_instr_catch_all && cur_byte != k_instr_end) {
-            parse_instr();
-          }
-        }
-        match_byte(k_instr_end);
+        parse_immediates(kind2, out.body[i]);
       }
       break;
     }
-    case k_instr_throw: parse_tagidx(); break;
-    case k_instr_rethrow: parse_labelidx(); break;
-    case k_instr_br: parse_labelidx(); break;
-    case k_instr_br_if: parse_labelidx(); break;
-    case k_instr_br_table: {
-      parse_vec([&](auto /*i*/) {
-        parse_labelidx();
-        return Ast_TODO{};
-      });
-      parse_labelidx();
+    default:
+      parse_immediates(kind, out.body[i]);
+  }
+  return false;
+}
+
+// Decodes the immediates of the simpler instructions into `instr` (v128.const and i8x16.shuffle are only
+// checked: parse_instr() keeps their immediates)
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_immediates(Imm_kind kind, Ast_instr& instr) -> void {
+  switch (kind) {
+    case Imm_kind::k_none: break;
+    case Imm_kind::k_u32: instr.a = parse_u32(); break;
+    case Imm_kind::k_u32_u32:
+      instr.a = parse_u32();
+      instr.b = parse_u32();
       break;
-    }
-    case k_instr_return: break;
-    case k_instr_call: parse_funcidx(); break;
-    case k_instr_call_indirect: {
-      parse_typeidx();  // y
-      parse_tableidx(); // x
+    case Imm_kind::k_reftype: instr.a = parse_reftype(); break;
+    case Imm_kind::k_memarg: set_memarg(instr, parse_memarg()); break;
+    case Imm_kind::k_zero_byte: match_byte(0x00); break;
+    case Imm_kind::k_zero_bytes_2:
+      match_byte(0x00);
+      match_byte(0x00);
+      break;
+    case Imm_kind::k_u32_zero_byte:
+      instr.a = parse_u32();
+      match_byte(0x00);
       break;
-    }
 
-      // 5.4.3 Parametric Instructions
-    case k_instr_drop: break;
-    case k_instr_select: break;
-      
-      // 5.4.4 Variable Instructions
-    case k_instr_local_get:    parse_localidx(); break;
-    case k_instr_local_set:    parse_localidx(); break;
-    case k_instr_local_tee:    parse_localidx(); break;
-    case k_instr_global_get:   parse_globalidx(); break;
-    case k_instr_global_set:   parse_globalidx(); break;
-
-      // 5.4.6 Memory Instructions
-    case k_instr_i32_load:     parse_memarg(); break;
-    case k_instr_i64_load:     parse_memarg(); break;
-    case k_instr_f32_load:     parse_memarg(); break;
-    case k_instr_f64_load:     parse_memarg(); break;
-    case k_instr_i32_load8_s:  parse_memarg(); break;
-    case k_instr_i32_load8_u:  parse_memarg(); break;
-    case k_instr_i32_load16_s: parse_memarg(); break;
-    case k_instr_i32_load16_u: parse_memarg(); break;
-    case k_instr_i64_load8_s:  parse_memarg(); break;
-    case k_instr_i64_load8_u:  parse_memarg(); break;
-    case k_instr_i64_load16_s: parse_memarg(); break;
-    case k_instr_i64_load16_u: parse_memarg(); break;
-    case k_instr_i64_load32_s: parse_memarg(); break;
-    case k_instr_i64_load32_u: parse_memarg(); break;
-    case k_instr_i32_store:    parse_memarg(); break;
-    case k_instr_i64_store:    parse_memarg(); break;
-    case k_instr_f32_store:    parse_memarg(); break;
-    case k_instr_f64_store:    parse_memarg(); break;
-    case k_instr_i32_store8:   parse_memarg(); break;
-    case k_instr_i32_store16:  parse_memarg(); break;
-    case k_instr_i64_store8:   parse_memarg(); break;
-    case k_instr_i64_store16:  parse_memarg(); break;
-    case k_instr_i64_store32:  parse_memarg(); break;
-    case k_instr_memory_size:  match_byte(0x00); break;
-      
-      // 5.4.6bis Atomic Memory Instructions (5.4.5 in Threads Spec)
-    case k_instr_atomic_prefix: {
-      auto opcode2_offset = cur_offset;
-      auto opcode2 = parse_u32();
-      switch (opcode2) {
-        case k_atomic_instr_memory_atomic_notify:      parse_memarg(); break;
-        case k_atomic_instr_memory_atomic_wait32:      parse_memarg(); break;
-          
-        case k_atomic_instr_i32_atomic_load:           parse_memarg(); break;
-        case k_atomic_instr_i64_atomic_load:           parse_memarg(); break;
-        case k_atomic_instr_i32_atomic_load8:          parse_memarg(); break;
-        case k_atomic_instr_i32_atomic_store:          parse_memarg(); break;
-        case k_atomic_instr_i64_atomic_store:          parse_memarg(); break;
-        case k_atomic_instr_i32_atomic_store8:         parse_memarg(); break;
-        
-        case k_atomic_instr_i32_atomic_rmw_add:        parse_memarg(); break;
-          
-        case k_atomic_instr_i32_atomic_rmw_sub:        parse_memarg(); break;
-
-        case k_atomic_instr_i32_atomic_rmw_or:         parse_memarg(); break;
-
-        case k_atomic_instr_i32_atomic_rmw_xchg:       parse_memarg(); break;
-        case k_atomic_instr_i32_atomic_rmw8_xchg_u:    parse_memarg(); break;
-          
-        case k_atomic_instr_i32_atomic_rmw_cmpxchg:    parse_memarg(); break;
-        case k_atomic_instr_i32_atomic_rmw8_cmpxchg_u: parse_memarg(); break;
-          
-        default:
-          throw std::logic_error(absl::StrFormat(
-              "Unrecognized atomic memory instruction secondary opcode 0x%02x at offset %d", opcode2, opcode2_offset));
-      }
+      // 5.4.7 Numeric Instructions
+    case Imm_kind::k_i32: instr.a = static_cast<uint32_t>(parse_i32()); break;
+    case Imm_kind::k_i64: set_imm64(instr, static_cast<uint64_t>(parse_i64())); break;
+    case Imm_kind::k_f32: instr.a = std::bit_cast<uint32_t>(parse_f32()); break;
+    case Imm_kind::k_f64: set_imm64(instr, std::bit_cast<uint64_t>(parse_f64())); break;
+
+      // 5.4.8 Vector Instructions
+    case Imm_kind::k_v128:
+    case Imm_kind::k_shuffle:
+      parse_v128();
+      break;
+    case Imm_kind::k_lane: instr.lane = parse_byte(); break;
+    case Imm_kind::k_memarg_lane:
+      set_memarg(instr, parse_memarg());
+      instr.lane = parse_byte();
       break;
+
+    case Imm_kind::k_invalid:
+    case Imm_kind::k_block:
+    case Imm_kind::k_structured:
+    case Imm_kind::k_br_table:
+    case Imm_kind::k_select_t:
+    case Imm_kind::k_prefix:
+      CHECK(false) << "parse_immediates() called for an instruction with structured immediates";
+  }
+}
+
+// Reads the secondary opcode after a prefix byte (0xfc, 0xfd or 0xfe, now in instr.opcode) into
+// instr.subopcode, and returns what kind of immediates follow it (k_none after reporting an error if it's
+// unknown)
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_secondary_opcode(Ast_instr& instr) -> Imm_kind {
+  auto opcode2_offset = cur_offset();
+  auto opcode2 = parse_u32();
+  instr.subopcode = opcode2;
+  auto [kinds, error_code] = [&] {
+    switch (instr.opcode) {
+      case k_instr_ext_prefix:
+        return std::pair{&k_ext_instr_imm_kinds, Parse_error_code::k_unrecognized_ext_opcode};
+      case k_instr_simd_prefix:
+        return std::pair{&k_simd_instr_imm_kinds, Parse_error_code::k_unrecognized_simd_opcode};
+      default:
+        return std::pair{&k_atomic_instr_imm_kinds, Parse_error_code::k_unrecognized_atomic_opcode};
     }
-      
-      // 5.4.7 Numeric instructions
-    case k_instr_i32_const:  parse_i32();  break;
-    case k_instr_i64_const:  parse_i64();  break;
-    case k_instr_f32_const:  parse_f32();  break;
-    case k_instr_f64_const:  parse_f64();  break;
-      
-    case k_instr_i32_eqz: break;
-    case k_instr_i32_eq: break;
-    case k_instr_i32_ne: break;
-    case k_instr_i32_lt_s: break;
-    case k_instr_i32_lt_u: break;
-    case k_instr_i32_gt_s: break;
-    case k_instr_i32_gt_u: break;
-    case k_instr_i32_le_s: break;
-    case k_instr_i32_le_u: break;
-    case k_instr_i32_ge_s: break;
-    case k_instr_i32_ge_u: break;
-
-    case k_instr_i64_eqz: break;
-    case k_instr_i64_eq: break;
-    case k_instr_i64_ne: break;
-    case k_instr_i64_lt_s: break;
-    case k_instr_i64_lt_u: break;
-    case k_instr_i64_gt_s: break;
-    case k_instr_i64_gt_u: break;
-    case k_instr_i64_le_s: break;
-    case k_instr_i64_le_u: break;
-    case k_instr_i64_ge_s: break;
-    case k_instr_i64_ge_u: break;
-
-    case k_instr_f64_eq: break;
-    case k_instr_f64_ne: break;
-    case k_instr_f64_lt: break;
-    case k_instr_f64_gt: break;
-    case k_instr_f64_le: break;
-    case k_instr_f64_ge: break;
-      
-    case k_instr_i32_clz: break;
-    case k_instr_i32_ctz: break;
-    case k_instr_i32_add: break;
-    case k_instr_i32_sub: break;
-    case k_instr_i32_mul: break;
-    case k_instr_i32_div_s: break;
-    case k_instr_i32_div_u: break;
-    case k_instr_i32_rem_s: break;
-    case k_instr_i32_rem_u: break;
-    case k_instr_i32_and: break;
-    case k_instr_i32_or: break;
-    case k_instr_i32_xor: break;
-    case k_instr_i32_shl: break;
-    case k_instr_i32_shr_s: break;
-    case k_instr_i32_shr_u: break;
-    case k_instr_i32_rotl: break;
-      
-    case k_instr_i64_clz: break;
-    case k_instr_i64_ctz: break;
-    case k_instr_i64_add: break;
-    case k_instr_i64_sub: break;
-    case k_instr_i64_mul: break;
-    case k_instr_i64_div_s: break;
-    case k_instr_i64_div_u: break;
-    case k_instr_i64_rem_s: break;
-    case k_instr_i64_rem_u: break;
-    case k_instr_i64_and: break;
-    case k_instr_i64_or: break;
-    case k_instr_i64_xor: break;
-    case k_instr_i64_shl: break;
-    case k_instr_i64_shr_s: break;
-    case k_instr_i64_shr_u: break;
-
-    case k_instr_f32_mul: break;
-
-    case k_instr_f64_abs: break;
-    case k_instr_f64_neg: break;
-    case k_instr_f64_ceil: break;
-    case k_instr_f64_floor: break;
-    case k_instr_f64_sqrt: break;
-    case k_instr_f64_add: break;
-    case k_instr_f64_sub: break;
-    case k_instr_f64_mul: break;
-    case k_instr_f64_div: break;
-      
-    case k_instr_i32_wrap_i64: break;
-    case k_instr_i32_trunc_f64_s: break;
-    case k_instr_i32_trunc_f64_u: break;
-    case k_instr_i64_extend_i32_s: break;
-    case k_instr_i64_extend_i32_u: break;
-    case k_instr_i64_trunc_f64_s: break;
-    case k_instr_i64_trunc_f64_u: break;
-    case k_instr_f32_convert_i32_s: break;
-    case k_instr_f32_demote_f64: break;
-    case k_instr_f64_convert_i32_s: break;
-    case k_instr_f64_convert_i32_u: break;
-    case k_instr_f64_convert_i64_s: break;
-    case k_instr_f64_convert_i64_u: break;
-    case k_instr_f64_promote_f32: break;
-    case k_instr_i32_reinterpret_f32: break;
-    case k_instr_i64_reinterpret_f64: break;
-    case k_instr_f32_reinterpret_i32: break;
-    case k_instr_f64_reinterpret_i64: break;
-
-    case k_instr_i32_extend8_s: break;
-    case k_instr_i32_extend16_s: break;
-    case k_instr_i64_extend8_s: break;
-    case k_instr_i64_extend16_s: break;
-    
-      // Extended instructions
-    case k_instr_ext_prefix: {
-      auto opcode2_offset = cur_offset;
-      auto opcode2 = parse_u32();
-      switch (opcode2) {
-        
-        // 5.4.6 Memory Instructions
-        case k_ext_instr_memory_init:
-          parse_dataidx();
-          match_byte(0x00);
-          break;
-        case k_ext_instr_data_drop: parse_dataidx(); break;
-        case k_ext_instr_memory_copy:
-          match_byte(0x00);
-          match_byte(0x00);
-          break;
-        case k_ext_instr_memory_fill:
-          match_byte(0x00);
-          break;
-          
-        default:
-          throw std::logic_error(absl::StrFormat(
-              "Unrecognized extended instruction secondary opcode %d at offset %d", opcode2, opcode2_offset));
+  }();
+  auto kind = opcode2 < kinds->size() ? (*kinds)[opcode2] : Imm_kind::k_invalid;
+  if (kind == Imm_kind::k_invalid) {
+    fail(error_code, opcode2_offset, opcode2);
+    return Imm_kind::k_none;
+  }
+  return kind;
+}
+
+// Skips over an instruction without keeping it, but decodes (and so checks) everything along the way
+// except for how blocks nest, which is left to the caller: returns +1 if the instruction opens a block,
+// -1 if it closes one (end or delegate), and 0 otherwise
+template<Byte_source Source>
+auto Wasm_parser<Source>::skip_instr() -> int {
+  auto opcode_offset = cur_offset();
+  auto instr = Ast_instr{.opcode = parse_byte()};
+  auto kind = k_instr_imm_kinds[instr.opcode];
+  switch (kind) {
+    case Imm_kind::k_invalid:
+      fail(Parse_error_code::k_unrecognized_opcode, opcode_offset, instr.opcode);
+      return 0;
+    case Imm_kind::k_block:
+      parse_blocktype();
+      return +1;
+    case Imm_kind::k_structured:
+      switch (instr.opcode) {
+        case k_instr_catch: parse_tagidx(); return 0;
+        case k_instr_end: return -1;
+        case k_instr_delegate: parse_labelidx(); return -1;
+        default: return 0;  // else, catch_all
       }
-      break;
+    case Imm_kind::k_br_table: {
+      auto n = parse_u32();
+      for (auto j = uint32_t{0}; j <= n && ok(); ++j) { parse_labelidx(); }  // l* l_N
+      return 0;
     }
-
-      
+    case Imm_kind::k_select_t: {
+      auto n = parse_u32();
+      for (auto j = uint32_t{0}; j != n && ok(); ++j) { parse_valtype(); }  // t*
+      return 0;
+    }
+    case Imm_kind::k_prefix:
+      parse_immediates(parse_secondary_opcode(instr), instr);
+      return 0;
     default:
-      throw std::logic_error(absl::StrFormat(
-          "Unrecognized instruction opcode 0x%02x at offset %d", opcode, opcode_offset));
+      parse_immediates(kind, instr);
+      return 0;
   }
 }
 
 // 5.4.1 Control Instructions
 // --------------------------
 
-auto Wasm_parser::parse_blocktype() -> void {
+// An instruction that continues or closes the innermost open block (else, catch, catch_all, end or delegate),
+// just appended as out.body[i].  Returns whether it was the end of the whole expression.
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_clause(Ast_func& out, uint32_t i, long opcode_offset) -> bool {
+  auto opcode = out.body[i].opcode;
+  if (control_stack.empty()) {
+    if (opcode == k_instr_end) {
+      out.body[i].a = k_no_instr;
+      return true;
+    }
+    fail(Parse_error_code::k_unrecognized_opcode, opcode_offset, opcode);
+    return false;
+  }
+
+  auto& frame = control_stack.back();
+  auto block = frame.block;
+  auto allowed = [&] {
+    switch (opcode) {
+      case k_instr_else: return frame.clause == k_instr_if;
+      case k_instr_catch:
+      case k_instr_catch_all: return frame.clause == k_instr_try || frame.clause == k_instr_catch;
+      case k_instr_delegate: return frame.clause == k_instr_try;
+      default: return true;  // end
+    }
+  }();
+  if (not allowed) {
+    fail(Parse_error_code::k_unrecognized_opcode, opcode_offset, opcode);
+    return false;
+  }
+
+  switch (opcode) {
+    case k_instr_else:
+      out.body[i].a = block;
+      out.body[block].subopcode = i;
+      frame.clause = opcode;
+      break;
+    case k_instr_catch:
+      out.body[i].a = parse_tagidx();
+      frame.clause = opcode;
+      break;
+    case k_instr_catch_all:
+      frame.clause = opcode;
+      break;
+    case k_instr_delegate:
+      out.body[i].a = parse_labelidx();
+      out.body[block].b = i;
+      control_stack.pop_back();
+      break;
+    default:  // end
+      out.body[i].a = block;
+      out.body[block].b = i;
+      if (frame.clause == k_instr_else) { out.body[out.body[block].subopcode].b = i; }
+      control_stack.pop_back();
+  }
+  return false;
+}
+
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_blocktype() -> uint32_t {
   if (maybe_match_byte(0x40)) {
-    // epsilon
+    return k_blocktype_empty;  // epsilon
   } else {
     if (can_parse_valtype()) {
-      parse_valtype();  // t
+      return k_blocktype_valtype | parse_valtype();  // t
     } else {
-      parse_s33();
+      // x, which must be non-negative (and not clash with the k_blocktype_* encodings, which no module has
+      // enough types to reach)
+      auto x_offset = cur_offset();
+      auto x = parse_s33();
+      if (x < 0 || x >= int64_t{k_blocktype_valtype}) {
+        fail(Parse_error_code::k_invalid_blocktype, x_offset, x);
+        return k_blocktype_empty;
+      }
+      return static_cast<Ast_typeidx>(x);
     }
   }
 }
@@ -748,17 +1061,59 @@ auto Wasm_parser::parse_blocktype() -> void {
 // 5.4.6 Memory Instructions
 // -------------------------
 
-auto Wasm_parser::parse_memarg() -> void {
-  parse_u32(); // a
-  parse_u32(); // o
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_memarg() -> Ast_memarg {
+  auto a = parse_u32();
+  auto o = parse_u32();
+  return Ast_memarg{.align = a, .offset = o};
+}
+
+// 5.4.8 Vector Instructions
+// -------------------------
+
+// The 16 bytes of a v128.const or i8x16.shuffle, read in one go rather than byte by byte
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_v128() -> Ast_v128 {
+  auto result = Ast_v128{};
+  parse_bytes(result.data(), static_cast<long>(result.size()));
+  return result;
 }
 
 // 5.4.9 Expressions
 // -----------------
 
-auto Wasm_parser::parse_expr() -> void {
-  while (cur_byte != k_instr_end) {  // opcode for "end"
-    parse_instr();
+// With `validate`, each instruction is also checked by the validator (see Func_validator::begin_func()) as
+// soon as it's decoded
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_expr(Ast_func& out, bool validate) -> void {
+  control_stack.clear();
+  if (not validate) {
+    while (ok() && not parse_instr(out)) {}
+    return;
+  }
+
+  auto done = false;
+  while (ok() && not done) {
+    auto opcode_offset = cur_offset();
+    done = parse_instr(out);
+    if (ok() && not validator.validate(out, static_cast<uint32_t>(out.body.size() - 1))) {
+      const auto& args = validator.error_args;
+      fail(validator.error_code, opcode_offset, args[0], args[1], args[2]);
+    }
+  }
+}
+
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_expr() -> void {
+  auto depth = long{0};
+  while (ok() && (depth != 0 || cur_byte() != k_instr_end)) {
+    auto opcode_offset = cur_offset();
+    depth += skip_instr();
+    if (depth < 0) {
+      fail(Parse_error_code::k_unrecognized_opcode, opcode_offset, k_instr_delegate);  // closes nothing
+    } else if (depth > long{options.max_nesting}) {
+      fail(Parse_error_code::k_too_deeply_nested, opcode_offset, options.max_nesting);
+    }
   }
   match_byte(k_instr_end);
 }
@@ -770,64 +1125,79 @@ auto Wasm_parser::parse_expr() -> void {
 // 5.5.1 Indices
 // -------------
 
-auto Wasm_parser::parse_typeidx() -> void {
-  parse_u32();
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_typeidx() -> Ast_typeidx {
+  return parse_u32();
 }
 
-auto Wasm_parser::parse_funcidx() -> void {
-  parse_u32();
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_funcidx() -> Ast_funcidx {
+  return parse_u32();
 }
 
-auto Wasm_parser::parse_tableidx() -> void {
-  parse_u32();
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_tableidx() -> Ast_tableidx {
+  return parse_u32();
 }
 
-auto Wasm_parser::parse_memidx() -> void {
-  parse_u32();
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_memidx() -> Ast_memidx {
+  return parse_u32();
 }
 
-auto Wasm_parser::parse_tagidx() -> void {
-  parse_u32();
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_tagidx() -> Ast_tagidx {
+  return parse_u32();
 }
 
-auto Wasm_parser::parse_globalidx() -> void {
-  parse_u32();
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_globalidx() -> Ast_globalidx {
+  return parse_u32();
 }
 
-auto Wasm_parser::parse_dataidx() -> void {
-  parse_u32();
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_dataidx() -> Ast_dataidx {
+  return parse_u32();
 }
 
-auto Wasm_parser::parse_localidx() -> void {
-  parse_u32();
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_localidx() -> Ast_localidx {
+  return parse_u32();
 }
 
-auto Wasm_parser::parse_labelidx() -> void {
-  parse_u32();
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_labelidx() -> Ast_labelidx {
+  return parse_u32();
 }
 
 // 5.5.2 Sections
 // --------------
 
-auto Wasm_parser::parse_section(Section_id section_id, std::invocable<uint32_t /*size*/> auto section_parser)
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_section(Section_id section_id, std::invocable<uint32_t /*size*/> auto section_parser)
     -> decltype(section_parser(0)) {
   match_byte(section_id);  // section id
   auto declared_size = parse_u32();
-  auto start_offset = cur_offset;
+  auto start_offset = cur_offset();
+  if (not ok()) { return {}; }
+  if (declared_size > src_.limit() - start_offset) {
+    fail(Parse_error_code::k_section_too_long, start_offset, section_id, declared_size, src_.limit());
+    return {};
+  }
 
-  // TODO: Really need to bound reading within section_parser to declared_size
-  // Otherwise, the beginning of a following section may be confused with more bytes from this section
-  // (e.g., empty name custom section followed by another custom section, vs
-  //  a name custom section with a module name subsection)
+  // Bound section_parser to declared_size, so that an overrun is caught right at the section boundary
+  // instead of misreading the start of the next section as more bytes of this one
+  auto saved_limit = src_.push_limit(declared_size);
+  auto saved_section = std::exchange(cur_section, section_id);
   auto result = std::invoke(section_parser, declared_size);
+  cur_section = saved_section;
+  src_.pop_limit(saved_limit);
   
-  auto end_offset = cur_offset;
+  auto end_offset = cur_offset();
   auto actual_size = end_offset - start_offset;
   
-  if (actual_size != declared_size) {
-    throw std::logic_error(absl::StrFormat(
-        "Invalid section id %d in byte range [%d,%d): declared size %d doesn't match actual size %d",
-        section_id, start_offset, end_offset, declared_size, actual_size)); 
+  if (actual_size != declared_size && ok()) {
+    fail(Parse_error_code::k_section_size_mismatch, start_offset, section_id, declared_size, actual_size);
   }
 
   return result;
@@ -837,39 +1207,55 @@ auto Wasm_parser::parse_section(Section_id section_id, std::invocable<uint32_t /
 // --------------------
 
 
-auto Wasm_parser::parse_namesubsection(
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_namesubsection(
     Name_subsection_id N,
     std::invocable<uint32_t /*size*/> auto subsection_parser)
     -> decltype(subsection_parser(0)) {
   match_byte(N);
   auto size = parse_u32();
-  return std::invoke(subsection_parser, size);
+  auto start_offset = cur_offset();
+  if (not ok()) { return {}; }
+  if (size > src_.limit() - start_offset) {
+    fail(Parse_error_code::k_name_subsection_too_long, start_offset, N, size, src_.limit());
+    return {};
+  }
+
+  auto saved_limit = src_.push_limit(size);
+  auto result = std::invoke(subsection_parser, size);
+  src_.pop_limit(saved_limit);
+
+  auto end_offset = cur_offset();
+  auto actual_size = end_offset - start_offset;
+  if (actual_size != size && ok()) {
+    fail(Parse_error_code::k_name_subsection_size_mismatch, start_offset, N, size, actual_size);
+  }
+
+  return result;
 }
 
-auto Wasm_parser::parse_customsec(Ast_module& module) -> void {
-  parse_section(k_section_custom, [&](auto size) {
-    auto start_offset = cur_offset;
-    auto end_offset = start_offset + size;
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_customsec(Ast_module& module) -> void {
+  parse_section(k_section_custom, [&](auto /*size*/) {
     [[maybe_unused]] auto name = parse_name();
     //std::cerr << "Custom section '" << name << "'\n";
     if (name == "name") {
       // Including additions from extended name section spec
-      while (cur_offset < end_offset) {
-        auto N_offset = cur_offset;
-        auto N = Name_subsection_id{cur_byte};
+      while (ok() && not at_eof()) {
+        auto N_offset = cur_offset();
+        auto N = Name_subsection_id{cur_byte()};
         switch (N) {
-          case k_name_subsection_module:
-            module.name = parse_modulenamesubsec();
-            break;
-          case k_name_subsection_functions:        parse_funcnamesubsec(); break;
-          case k_name_subsection_locals:           parse_localnamesubsec(); break;
-          case k_name_subsection_globals:          parse_globalnamesubsec(); break;
-          case k_name_subsection_data_segments:    parse_datasegmentnamesubsec(); break;
+          case k_name_subsection_module:        module.name = parse_modulenamesubsec(module); break;
+          case k_name_subsection_functions:     module.func_names = parse_funcnamesubsec(module); break;
+          case k_name_subsection_locals:        parse_localnamesubsec(); break;
+          case k_name_subsection_globals:       module.global_names = parse_globalnamesubsec(module); break;
+          case k_name_subsection_data_segments: module.data_names = parse_datasegmentnamesubsec(module); break;
           default:
             parse_namesubsection(N, [&](auto subsection_size) {
               std::cerr << absl::StreamFormat(
                   "Unrecognized namesubsection id %d at offset %d, skipping %d bytes\n", N, N_offset, subsection_size);
               skip_bytes(subsection_size);
+              return Ast_TODO{};
             });
             break;
         }
@@ -877,193 +1263,224 @@ auto Wasm_parser::parse_customsec(Ast_module& module) -> void {
     } else if (name == "sourceMappingURL") {
       auto url = parse_name();
       std::cerr << "Source mapping url: " << url << "\n";
-      if (cur_offset != end_offset) {
+      if (not at_eof()) {
         std::cerr << "??\n";
-        skip_bytes(end_offset - cur_offset);
+        skip_bytes(src_.limit() - cur_offset());
       }
     } else {
-      skip_bytes(size - (cur_offset - start_offset));
+      skip_bytes(src_.limit() - cur_offset());
     }
     return Ast_TODO{};
   });
 }
 
-auto Wasm_parser::parse_modulenamesubsec() -> std::string {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_modulenamesubsec(Ast_module& module) -> Ast_name {
   return parse_namesubsection(k_name_subsection_module, [&](auto /*size*/){
-    return parse_name();
+    return parse_kept_name(module);
   });
 }
 
-auto Wasm_parser::parse_funcnamesubsec() -> void {
-  parse_namesubsection(k_name_subsection_functions, [&](auto /*size*/){
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_funcnamesubsec(Ast_module& module) -> Ast_namemap {
+  return parse_namesubsection(k_name_subsection_functions, [&](auto /*size*/){
     //std::cerr << "Function names:\n";
-    parse_namemap(false);
+    return parse_namemap(module, false);
   });
 }
 
-auto Wasm_parser::parse_localnamesubsec() -> void {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_localnamesubsec() -> void {
   parse_namesubsection(k_name_subsection_locals, [&](auto /*size*/) {
     //std::cerr << "Local names:\n";
     parse_indirectnamemap(false);
+    return Ast_TODO{};
   });
 }
 
-auto Wasm_parser::parse_globalnamesubsec() -> void {
-  parse_namesubsection(k_name_subsection_globals, [&](auto /*size*/){
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_globalnamesubsec(Ast_module& module) -> Ast_namemap {
+  return parse_namesubsection(k_name_subsection_globals, [&](auto /*size*/){
     //std::cerr << "Global names:\n";
-    parse_namemap(false);
+    return parse_namemap(module, false);
   });
 }
 
-auto Wasm_parser::parse_datasegmentnamesubsec() -> void {
-  parse_namesubsection(k_name_subsection_data_segments, [&](auto /*size*/){
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_datasegmentnamesubsec(Ast_module& module) -> Ast_namemap {
+  return parse_namesubsection(k_name_subsection_data_segments, [&](auto /*size*/){
     //std::cerr << "Data segment names:\n";
-    parse_namemap(false);
+    return parse_namemap(module, false);
   });
 }
 
-auto Wasm_parser::parse_namemap(bool dump) -> std::vector<Ast_TODO> {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_namemap(Ast_module& module, bool dump) -> Ast_namemap {
   return parse_vec([&](auto /*i*/) {
-    parse_nameassoc(dump);
-    return Ast_TODO{};
+    return parse_nameassoc(module, dump);
   });
 }
 
-auto Wasm_parser::parse_nameassoc(bool dump) -> void {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_nameassoc(Ast_module& module, bool dump) -> Ast_nameassoc {
   auto idx = parse_u32();
-  auto name = parse_name();
+  auto name = parse_kept_name(module);
   if (dump) {
     std::cerr << absl::StreamFormat("- %d -> %s\n", idx, name);
   }
+  return Ast_nameassoc{.idx = idx, .name = name};
 }
 
-auto Wasm_parser::parse_indirectnamemap(bool dump) -> std::vector<Ast_TODO> {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_indirectnamemap(bool dump) -> std::pmr::vector<Ast_TODO> {
   return parse_vec([&](auto /*i*/) {
     parse_indirectnameassoc(dump);
     return Ast_TODO{};
   });
 }
 
-auto Wasm_parser::parse_indirectnameassoc(bool dump) -> void {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_indirectnameassoc(bool dump) -> void {
   auto idx = parse_u32();
   if (dump) {
     std::cerr << absl::StreamFormat("[%d]:\n", idx);
   }
-  parse_namemap(dump);
+  // Local names aren't kept (yet), so don't bother interning them
+  parse_vec([&](auto /*i*/) {
+    auto local_idx = parse_u32();
+    auto name = parse_name();
+    if (dump) {
+      std::cerr << absl::StreamFormat("- %d -> %s\n", local_idx, name);
+    }
+    return Ast_TODO{};
+  });
 }
 
 // 5.5.4 Type Section
 // ------------------
 
-auto Wasm_parser::parse_typesec() -> std::vector<Ast_functype> {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_typesec() -> Ast_type_table {
   return parse_section(k_section_type, [&](auto /*size*/) {
-    return parse_vec([&](auto /*i*/) {
-      return parse_functype();
+    auto types = Ast_type_table{resource};
+    parse_vec([&](auto /*i*/) {
+      types.add(parse_functype());
+      return Ast_TODO{};
     });
+    return types;
   });
 }
 
 // 5.5.5 Import Section
 // --------------------
 
-auto Wasm_parser::parse_importsec() -> std::vector<Ast_import> {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_importsec(Ast_module& module) -> std::pmr::vector<Ast_import> {
   return parse_section(k_section_import, [&](auto /*size*/) {
     return parse_vec([&](auto /*i*/) {
-      return parse_import();
+      return parse_import(module);
     });
   });
 }
 
-auto Wasm_parser::parse_import() -> Ast_import {
-  auto module = parse_name();
-  auto name = parse_name();
-  parse_importdesc();
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_import(Ast_module& module) -> Ast_import {
+  auto mod = parse_kept_name(module);
+  auto name = parse_kept_name(module);
+  auto desc = parse_importdesc();
   return Ast_import{
-    .module = std::move(module),
-    .name = std::move(name)
+    .module = mod,
+    .name = name,
+    .desc = desc
   };
 }
 
-auto Wasm_parser::parse_importdesc() -> void {
-  auto b_offset = cur_offset;
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_importdesc() -> Ast_importdesc {
+  auto b_offset = cur_offset();
   auto b = parse_byte();
+  auto result = Ast_importdesc{.kind = Ast_externkind{b}};
   switch (b) {
-    case 0x00: return parse_typeidx();     // func
-    case 0x01: return parse_tabletype();   // table
-    case 0x02: return parse_memtype();     // mem
-    case 0x03: return parse_globaltype();  // global
-    case 0x04: return parse_tag();         // tag
+    case 0x00: result.typeidx = parse_typeidx(); break;    // func
+    case 0x01: result.table = parse_tabletype(); break;    // table
+    case 0x02: result.mem = parse_memtype(); break;        // mem
+    case 0x03: result.global = parse_globaltype(); break;  // global
+    case 0x04: result.typeidx = parse_tag().type; break;   // tag
     default:
-      throw std::logic_error(absl::StrFormat(
-          "Unrecognized importdesc type 0x%02x at offset %d", b, b_offset));
-  }
+      fail(Parse_error_code::k_unrecognized_importdesc, b_offset, b);
+  }  return result;
 }
 
 // 5.5.6 Function Section
 // ----------------------
 
-auto Wasm_parser::parse_funcsec() -> std::vector<Ast_TODO> {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_funcsec() -> std::pmr::vector<Ast_typeidx> {
   return parse_section(k_section_function, [&](auto /*size*/) {
-    return parse_vec([&](auto /*i*/) {
-      parse_typeidx();
-      return Ast_TODO{};
-    });
+    auto typeidxs = std::pmr::vector<Ast_typeidx>{resource};
+    parse_u32_vec(typeidxs);
+    return typeidxs;
   });
 }
 
 // 5.5.7 Table Section
 // -------------------
 
-auto Wasm_parser::parse_tablesec() -> std::vector<Ast_TODO> {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_tablesec() -> std::pmr::vector<Ast_tabletype> {
   return parse_section(k_section_table, [&](auto /*size*/) {
     return parse_vec([&](auto /*i*/) {
-      parse_table();
-      return Ast_TODO{};
+      return parse_table();
     });
   });
 }
 
-auto Wasm_parser::parse_table() -> void {
-  parse_tabletype();
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_table() -> Ast_tabletype {
+  return parse_tabletype();
 }
 
 // 5.5.8 Memory Section
 // --------------------
 
-auto Wasm_parser::parse_memsec() -> std::vector<Ast_TODO> {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_memsec() -> std::pmr::vector<Ast_memtype> {
   return parse_section(k_section_memory, [&](auto /*size*/) {
     return parse_vec([&](auto /*i*/) {
-      parse_mem();
-      return Ast_TODO{};
+      return parse_mem();
     });
   });
 }
 
-auto Wasm_parser::parse_mem() -> void {
-  parse_memtype();
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_mem() -> Ast_memtype {
+  return parse_memtype();
 }
 
 // 5.5.9 Global Section
 // --------------------
 
-auto Wasm_parser::parse_globalsec() -> std::vector<Ast_TODO> {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_globalsec() -> std::pmr::vector<Ast_global> {
   return parse_section(k_section_global, [&](auto /*size*/) {
     return parse_vec([&](auto /*i*/) {
-      parse_global();
-      return Ast_TODO{};
+      return parse_global();
     });
   });
 }
 
-auto Wasm_parser::parse_global() -> void {
-  parse_globaltype();  // gt
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_global() -> Ast_global {
+  auto gt = parse_globaltype();
   parse_expr();  // e
+  return Ast_global{.type = gt};
 }
 
 // 5.5.10 Export Section
 // ---------------------
 
-auto Wasm_parser::parse_exportsec() -> std::vector<Ast_TODO> {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_exportsec() -> std::pmr::vector<Ast_TODO> {
   return parse_section(k_section_export, [&](auto /*size*/) {
     return parse_vec([&](auto /*i*/) {
       parse_export();
@@ -1072,147 +1489,219 @@ auto Wasm_parser::parse_exportsec() -> std::vector<Ast_TODO> {
   });
 }
 
-auto Wasm_parser::parse_export() -> void {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_export() -> void {
   parse_name(); // nm
   parse_exportdesc(); // d
 }
 
-auto Wasm_parser::parse_exportdesc() -> void {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_exportdesc() -> void {
   // Including additions from the exception handling spec
-  auto b_offset = cur_offset;
+  auto b_offset = cur_offset();
   auto b = parse_byte();
   switch (b) {
-    case 0x00: return parse_funcidx();     // func
-    case 0x01: return parse_tableidx();    // table
-    case 0x02: return parse_memidx();      // mem
-    case 0x03: return parse_globalidx();   // global
-    case 0x04: return parse_tagidx();      // tag
+    case 0x00: parse_funcidx(); return;    // func
+    case 0x01: parse_tableidx(); return;   // table
+    case 0x02: parse_memidx(); return;     // mem
+    case 0x03: parse_globalidx(); return;  // global
+    case 0x04: parse_tagidx(); return;     // tag
     default:
-      throw std::logic_error(absl::StrFormat(
-          "Unrecognized exportdesc type 0x%02x at offset %d", b, b_offset));
+      fail(Parse_error_code::k_unrecognized_exportdesc, b_offset, b);
   }
 }
 
 // 5.5.11 Start Section
 // --------------------
 
-auto Wasm_parser::parse_startsec() -> void {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_startsec() -> void {
   parse_section(k_section_start, [&](auto /*size*/) {
     parse_start();
     return Ast_TODO{};
   });
 }
 
-auto Wasm_parser::parse_start() -> void {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_start() -> void {
   parse_funcidx();
 }
 
 // 5.5.12 Element Section
 // ----------------------
 
-auto Wasm_parser::parse_elemsec() -> std::vector<Ast_TODO> {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_elemsec() -> std::pmr::vector<Ast_elem> {
   return parse_section(k_section_element, [&](auto /*size*/) {
     return parse_vec([&](auto /*i*/) {
-      parse_elem();
-      return Ast_TODO{};
+      return parse_elem();
     });
   });
 }
 
-auto Wasm_parser::parse_elem() -> void {
-  auto discriminant_offset = cur_offset;
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_elem() -> Ast_elem {
+  auto discriminant_offset = cur_offset();
   auto discriminant = parse_u32();
   switch (discriminant) {
     case 0:
       parse_expr();
-      parse_vec([&](auto /*i*/) {
-        parse_funcidx();
-        return Ast_TODO{};
-      });
+      parse_u32_vec(scratch_u32s);  // y*
       break;
 
       // TODO: Add parsing for other discriminants
       
     default:
-      throw std::logic_error(absl::StrFormat(
-          "Unrecognized elem discriminant %d at offset %d", discriminant, discriminant_offset));
+      fail(Parse_error_code::k_unrecognized_elem, discriminant_offset, discriminant);
   }
+  return Ast_elem{};
 }
 
 // 5.5.13 Code Section
 // -------------------
 
-auto Wasm_parser::parse_codesec() -> std::vector<Ast_TODO> {
-  return parse_section(k_section_code, [&](auto /*size*/) {
-    return parse_vec([&](auto /*i*/) {
-      parse_code();
-      return Ast_TODO{};
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_codesec(Ast_module& module) -> std::pmr::vector<Ast_code> {
+  // In parallel mode, grab all the bodies quickly (each one starts with its size), then decode them at once
+  auto parallel = Source::k_contiguous && options.num_threads > 1 && not options.lazy_function_bodies;
+  auto saved_lazy = std::exchange(options.lazy_function_bodies, options.lazy_function_bodies || parallel);
+  auto validate = options.validate && not options.lazy_function_bodies;
+  if (validate) { validator.begin_module(module); }
+  auto section_offset = cur_offset();
+  // In parallel mode, a malformed body before the point where grabbing the bodies fails is what decoding
+  // them in order would have run into first, so hold on to that failure until they've been decoded
+  auto saved_throw_errors = std::exchange(throw_errors, throw_errors && not parallel);
+  auto num_grabbed = size_t{0};
+  auto codes = parse_section(k_section_code, [&](auto /*size*/) {
+    return parse_vec([&](auto i) {
+      auto code = parse_code(module, validate ? std::optional{i} : std::nullopt);
+      if (ok()) { ++num_grabbed; }
+      return code;
     });
   });
+  throw_errors = saved_throw_errors;
+  options.lazy_function_bodies = saved_lazy;
+
+  if (parallel) {
+    auto grab_error = std::exchange(first_error, std::nullopt);
+    auto validate_against = options.validate ? &module : nullptr;
+    auto grabbed = std::span{codes}.first(num_grabbed);
+    if (auto error = decode_funcs_in_parallel(grabbed, module.arena, options.num_threads, validate_against)) {
+      fail(*error);
+    } else if (grab_error) {
+      fail(*grab_error);
+    }
+  }
+  if (ok() && options.validate && codes.size() != module.func_types.size()) {
+    fail(Parse_error_code::k_func_count_mismatch, section_offset, module.func_types.size(), codes.size());
+  }
+  return codes;
 }
 
-auto Wasm_parser::parse_code() -> void {
-  parse_u32();  // size
-  parse_func();  // Assume ||func|| == size
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_code(Ast_module& module, std::optional<uint32_t> funcidx) -> Ast_code {
+  auto size = parse_u32();
+  auto offset = cur_offset();
+  if (not ok()) { return {}; }
+  if (size > src_.limit() - offset) {
+    fail(Parse_error_code::k_unexpected_end_of_section, src_.limit());
+    return {};
+  }
+
+  if (options.lazy_function_bodies) {
+    // Just grab the bytes: no need to look inside until someone asks for this function
+    return Ast_code{.offset = offset, .size = size, .body = parse_kept_bytes(module, size)};
+  }
+
+  auto saved_limit = src_.push_limit(size);
+  auto func = parse_func(funcidx);
+  src_.pop_limit(saved_limit);
+
+  auto actual_size = cur_offset() - offset;
+  if (actual_size != size && ok()) {
+    fail(Parse_error_code::k_code_size_mismatch, offset, size, actual_size);
+  }
+  return Ast_code{.offset = offset, .size = size, .func = std::move(func)};
 }
 
-auto Wasm_parser::parse_func() -> void {
-  parse_vec([&](auto /*i*/) {
-    parse_locals();
-    return Ast_TODO{};
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_func(std::optional<uint32_t> funcidx) -> Ast_func {
+  auto locals_offset = cur_offset();
+  auto locals = parse_vec([&](auto /*i*/) {
+    return parse_locals();
   });
-  parse_expr();
-}
+  if (funcidx && ok() && not validator.begin_func(*funcidx, locals)) {
+    const auto& args = validator.error_args;
+    fail(validator.error_code, locals_offset, args[0], args[1], args[2]);
+  }
 
-auto Wasm_parser::parse_locals() -> void {
-  parse_u32();  // n
-  parse_valtype();  // t
+  // Decode into scratch space first, so that the body takes up exactly as much of the arena as it needs
+  scratch_func.body.clear();
+  scratch_func.br_table_labels.clear();
+  scratch_func.v128_imms.clear();
+  parse_expr(scratch_func, funcidx.has_value());
+  const auto& body = scratch_func.body;
+  const auto& labels = scratch_func.br_table_labels;
+  const auto& v128_imms = scratch_func.v128_imms;
+  return Ast_func{
+    .locals = std::move(locals),
+    .body = std::pmr::vector<Ast_instr>{body.begin(), body.end(), resource},
+    .br_table_labels = std::pmr::vector<uint32_t>{labels.begin(), labels.end(), resource},
+    .v128_imms = std::pmr::vector<Ast_v128>{v128_imms.begin(), v128_imms.end(), resource}};
+}
+
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_locals() -> Ast_locals {
+  auto n = parse_u32();
+  auto t = parse_valtype();
+  return Ast_locals{.n = n, .t = t};
 }
 
 // 5.5.14 Data Section
 // -------------------
 
-auto Wasm_parser::parse_datasec() -> std::vector<Ast_TODO> {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_datasec(Ast_module& module) -> std::pmr::vector<Ast_data> {
   return parse_section(k_section_data, [&](auto /*size*/) {
     return parse_vec([&](auto /*i*/) {
-      parse_data();
-      return Ast_TODO{};
+      return parse_data(module);
     });
   });
 }
 
-auto Wasm_parser::parse_data() -> void {
-  auto discriminant_offset = cur_offset;
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_data(Ast_module& module) -> Ast_data {
+  auto result = Ast_data{};
+  auto discriminant_offset = cur_offset();
   auto discriminant = parse_u32();
   switch (discriminant) {
     case 0: // active, implicit memory index 0
-      parse_expr();  // e
-      parse_vec([&](auto /*i*/) {
-        return parse_byte();
-      });
+      result.mode = Ast_datamode::k_active;
+      result.offset = capture_kept_bytes(module, [&] { parse_expr(); });  // e
       break;
     case 1: // passive
-      parse_vec([&](auto /*i*/) {
-        return parse_byte();
-      });
       break;
     case 2: // active, explicit memory
-      parse_memidx();  // x
-      parse_expr();  // e
-      parse_vec([&](auto /*i*/) {
-        return parse_byte();
-      });
+      result.mode = Ast_datamode::k_active;
+      result.memory = parse_u32();  // x
+      result.offset = capture_kept_bytes(module, [&] { parse_expr(); });  // e
       break;
     default:
-      throw std::logic_error(absl::StrFormat(
-          "Unrecognized data discriminant %d at offset %d", discriminant, discriminant_offset));
+      fail(Parse_error_code::k_unrecognized_data, discriminant_offset, discriminant);
+      return result;
   }
+
+  // b*: potentially megabytes, so no per-byte work
+  auto n = parse_u32();
+  result.init = parse_kept_bytes(module, n);
+  return result;
 }
 
 // 5.5.15 Data Count Section
 // -------------------------
 
-auto Wasm_parser::parse_datacountsec() -> uint32_t {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_datacountsec() -> uint32_t {
   return parse_section(k_section_data_count, [&](auto /*size*/) {
     return parse_u32();  // n
   });
@@ -1221,77 +1710,119 @@ auto Wasm_parser::parse_datacountsec() -> uint32_t {
 // [EXTRA] Tag Section (5.5.16 in Exception Handling Spec)
 // -------------------------------------------------------
 
-auto Wasm_parser::parse_tagsec() -> std::vector<Ast_TODO> {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_tagsec() -> std::pmr::vector<Ast_tag> {
   return parse_section(k_section_tag, [&](auto /*size*/) {
     return parse_vec([&](auto /*i*/) {
-      parse_tag();
-      return Ast_TODO{};
+      return parse_tag();
     });
   });
 }
 
-auto Wasm_parser::parse_tag() -> void {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_tag() -> Ast_tag {
   match_byte(0x00);
-  parse_typeidx();  // x
+  auto x = parse_typeidx();
+  return Ast_tag{.type = x};
 }
 
 // 5.5.16 Modules
 // --------------
 
-auto Wasm_parser::parse_magic() -> void {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_magic() -> void {
   match_byte(0x00); match_byte(0x61); match_byte(0x73); match_byte(0x6D);
 }
 
-auto Wasm_parser::parse_version() -> void {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_version() -> void {
   match_byte(0x01); match_byte(0x00); match_byte(0x00); match_byte(0x00);
 }
 
-auto Wasm_parser::parse_module() -> Ast_module {
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_module() -> Ast_module {
   auto module = Ast_module{};
-  auto parse_opt_customsecs = [&]{
-    while (not is_->eof() && cur_byte == k_section_custom) { parse_customsec(module); }
-  };
-  
   parse_magic();
   parse_version();
-  parse_opt_customsecs();
-  if (not is_->eof() && cur_byte == k_section_type) {
-    module.types = parse_typesec();
-  }
-  parse_opt_customsecs();
-  if (not is_->eof() && cur_byte == k_section_import) {
-    module.imports = parse_importsec();
-  }
-  parse_opt_customsecs();
-  if (not is_->eof() && cur_byte == k_section_function) { parse_funcsec(); }
-  parse_opt_customsecs();
-  if (not is_->eof() && cur_byte == k_section_table) { parse_tablesec(); }
-  parse_opt_customsecs();
-  if (not is_->eof() && cur_byte == k_section_memory) { parse_memsec(); }
-  parse_opt_customsecs();
-  if (not is_->eof() && cur_byte == k_section_tag) { parse_tagsec(); }
-  parse_opt_customsecs();
-  if (not is_->eof() && cur_byte == k_section_global) { parse_globalsec(); }
-  parse_opt_customsecs();
-  if (not is_->eof() && cur_byte == k_section_export) { parse_exportsec(); }
-  parse_opt_customsecs();
-  if (not is_->eof() && cur_byte == k_section_start) { parse_startsec(); }
-  parse_opt_customsecs();
-  if (not is_->eof() && cur_byte == k_section_element) { parse_elemsec(); }
-  parse_opt_customsecs();
-  if (not is_->eof() && cur_byte == k_section_data_count) { parse_datacountsec(); }
-  parse_opt_customsecs();
-  if (not is_->eof() && cur_byte == k_section_code) { parse_codesec(); }
-  parse_opt_customsecs();
-  if (not is_->eof() && cur_byte == k_section_data) { parse_datasec(); }
-  parse_opt_customsecs();
+  auto last_order = 0;
+  while (ok() && can_parse_module_section(last_order)) {
+    parse_module_section(module, last_order);
+  }
   
-  if (not is_->eof()) {
-    throw std::logic_error(absl::StrFormat(
-        "Expected end of file at offset %d, but the data continues: 0x%02x...", cur_offset, cur_byte));
+  if (ok() && not at_eof()) {
+    fail(Parse_error_code::k_trailing_data, cur_offset(), cur_byte());
   }
 
   return module;
 }
 
+template<Byte_source Source>
+auto Wasm_parser<Source>::can_parse_module_section(int last_order) -> bool {
+  if (at_eof()) { return false; }
+  auto order = section_order(cur_byte());
+  return order == 0 || order > last_order;
+}
+
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_module_section(Ast_module& module, int& last_order) -> void {
+  DCHECK(can_parse_module_section(last_order));
+  resource = module.arena.resource();
+  auto id = Section_id{cur_byte()};
+  switch (id) {
+    case k_section_custom:     parse_customsec(module); break;
+    case k_section_type:       module.types = parse_typesec(); break;
+    case k_section_import:     module.imports = parse_importsec(module); break;
+    case k_section_function:   module.func_types = parse_funcsec(); break;
+    case k_section_table:      module.tables = parse_tablesec(); break;
+    case k_section_memory:     module.mems = parse_memsec(); break;
+    case k_section_tag:        module.tags = parse_tagsec(); break;
+    case k_section_global:     module.globals = parse_globalsec(); break;
+    case k_section_export:     parse_exportsec(); break;
+    case k_section_start:      parse_startsec(); break;
+    case k_section_element:    module.elems = parse_elemsec(); break;
+    case k_section_data_count: module.data_count = parse_datacountsec(); break;
+    case k_section_code:       module.codes = parse_codesec(module); break;
+    case k_section_data:       module.datas = parse_datasec(module); break;
+  }
+  if (id != k_section_custom) {
+    last_order = section_order(id);
+  }
+}
+
+// [EXTRA] Section index
+// ----------------------
+
+template<Byte_source Source>
+auto Wasm_parser<Source>::parse_section_index() -> Section_index {
+  auto index = Section_index{};
+  parse_magic();
+  parse_version();
+  auto last_order = 0;
+  while (ok() && can_parse_module_section(last_order)) {
+    auto entry = Section_entry{.id = Section_id{cur_byte()}, .offset = cur_offset()};
+    parse_section(entry.id, [&](auto size) {
+      entry.contents_offset = cur_offset();
+      entry.size = size;
+      if (entry.id == k_section_custom) {
+        entry.name = parse_name();
+      }
+      skip_bytes(src_.limit() - cur_offset());
+      return Ast_TODO{};
+    });
+    if (entry.id != k_section_custom) {
+      last_order = section_order(entry.id);
+    }
+    index.sections.push_back(std::move(entry));
+  }
+
+  if (ok() && not at_eof()) {
+    fail(Parse_error_code::k_trailing_data, cur_offset(), cur_byte());
+  }
+
+  return index;
+}
+
+template struct Wasm_parser<Istream_byte_source>;
+template struct Wasm_parser<Span_byte_source>;
+
 }  // namespace wasmtoolbox
@@ -18,8 +18,18 @@
 #define WASMTOOLBOX_PARSER_H
 
 #include <iostream>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
 
 #include "ast.h"
+#include "byte_source.h"
+#include "opcodes.h"
+#include "validator.h"
 
 namespace wasmtoolbox {
 
@@ -54,6 +64,46 @@ enum Section_id : uint8_t {
   k_section_tag        = 13
 };
 
+// [EXTRA] Where each section of a module lives, found without decoding the section contents (only the
+// names of custom sections are read).  Useful to jump straight to the sections of interest.
+struct Section_entry {
+  Section_id id = k_section_custom;
+  long offset = 0;           // of the section id
+  long contents_offset = 0;  // of the section contents, just past the size
+  uint32_t size = 0;         // of the contents
+  std::string name{};        // custom sections only
+
+  auto end_offset() const -> long { return contents_offset + size; }
+};
+
+struct Section_index {
+  std::vector<Section_entry> sections{};  // in order of appearance
+
+  auto find(Section_id id) const -> const Section_entry*;  // first such section, or nullptr
+};
+
+// 5.5.16 Modules: apart from custom sections, which can appear anywhere, each section appears at most once
+// and in this order.  Returns 0 for custom sections and -1 for unknown section ids.
+constexpr auto section_order(uint8_t id) -> int {
+  switch (id) {
+    case k_section_custom:     return  0;
+    case k_section_type:       return  1;
+    case k_section_import:     return  2;
+    case k_section_function:   return  3;
+    case k_section_table:      return  4;
+    case k_section_memory:     return  5;
+    case k_section_tag:        return  6;
+    case k_section_global:     return  7;
+    case k_section_export:     return  8;
+    case k_section_start:      return  9;
+    case k_section_element:    return 10;
+    case k_section_data_count: return 11;
+    case k_section_code:       return 12;
+    case k_section_data:       return 13;
+    default:                   return -1;
+  }
+}
+
 // 7.4.1 Name section
 enum Name_subsection_id : uint8_t {
   k_name_subsection_module        = 0,
@@ -63,229 +113,181 @@ enum Name_subsection_id : uint8_t {
   k_name_subsection_data_segments = 9
 };
 
-// 5.4 Instructions
-enum Instr_opcode : uint8_t {
-  k_instr_ext_prefix          = 0xfc,  // used by some Table Instructions, Memory Instructions and Numeric Instructions
-  
-  // 5.4.1 Control Instructions
-  k_instr_unreachable         = 0x00,
-  k_instr_nop                 = 0x01,
-  k_instr_block               = 0x02,
-  k_instr_loop                = 0x03,
-  k_instr_if                  = 0x04,
-  k_instr_else                = 0x05,
-  k_instr_try                 = 0x06,
-  k_instr_catch               = 0x07,
-  k_instr_throw               = 0x08,
-  k_instr_rethrow             = 0x09,
-  k_instr_end                 = 0x0b,
-  k_instr_br                  = 0x0c,
-  k_instr_br_if               = 0x0d,
-  k_instr_br_table            = 0x0e,
-  k_instr_return              = 0x0f,
-  k_instr_call                = 0x10,
-  k_instr_call_indirect       = 0x11,
-  k_instr_delegate            = 0x18,
-  k_instr_catch_all           = 0x19,
-
-  // 5.4.3 Parametric Instructions
-  k_instr_drop                = 0x1a,
-  k_instr_select              = 0x1b,
-  
-  // 5.4.4 Variable instructions
-  k_instr_local_get           = 0x20,
-  k_instr_local_set           = 0x21,
-  k_instr_local_tee           = 0x22,
-  k_instr_global_get          = 0x23,
-  k_instr_global_set          = 0x24,
-
-  // 5.4.6 Memory Instructions
-  k_instr_i32_load            = 0x28,
-  k_instr_i64_load            = 0x29,
-  k_instr_f32_load            = 0x2a,
-  k_instr_f64_load            = 0x2b,
-  k_instr_i32_load8_s         = 0x2c,
-  k_instr_i32_load8_u         = 0x2d,
-  k_instr_i32_load16_s        = 0x2e,
-  k_instr_i32_load16_u        = 0x2f,
-  k_instr_i64_load8_s         = 0x30,
-  k_instr_i64_load8_u         = 0x31,
-  k_instr_i64_load16_s        = 0x32,
-  k_instr_i64_load16_u        = 0x33,
-  k_instr_i64_load32_s        = 0x34,
-  k_instr_i64_load32_u        = 0x35,
-  k_instr_i32_store           = 0x36,
-  k_instr_i64_store           = 0x37,
-  k_instr_f32_store           = 0x38,
-  k_instr_f64_store           = 0x39,
-  k_instr_i32_store8          = 0x3a,
-  k_instr_i32_store16         = 0x3b,
-  k_instr_i64_store8          = 0x3c,
-  k_instr_i64_store16         = 0x3d,
-  k_instr_i64_store32         = 0x3e,
-  k_instr_memory_size         = 0x3f,
-
-  // 5.4.6bis Atomic Memory Instructions (5.4.4 in Threads spec)
-  k_instr_atomic_prefix       = 0xfe,
-
-  // 5.4.7 Numeric instructions
-  k_instr_i32_const           = 0x41,
-  k_instr_i64_const           = 0x42,
-  k_instr_f32_const           = 0x43,
-  k_instr_f64_const           = 0x44,
-  
-  k_instr_i32_eqz             = 0x45,
-  k_instr_i32_eq              = 0x46,
-  k_instr_i32_ne              = 0x47,
-  k_instr_i32_lt_s            = 0x48,
-  k_instr_i32_lt_u            = 0x49,
-  k_instr_i32_gt_s            = 0x4a,
-  k_instr_i32_gt_u            = 0x4b,
-  k_instr_i32_le_s            = 0x4c,
-  k_instr_i32_le_u            = 0x4d,
-  k_instr_i32_ge_s            = 0x4e,
-  k_instr_i32_ge_u            = 0x4f,
-
-  k_instr_i64_eqz             = 0x50,
-  k_instr_i64_eq              = 0x51,
-  k_instr_i64_ne              = 0x52,
-  k_instr_i64_lt_s            = 0x53,
-  k_instr_i64_lt_u            = 0x54,
-  k_instr_i64_gt_s            = 0x55,
-  k_instr_i64_gt_u            = 0x56,
-  k_instr_i64_le_s            = 0x57,
-  k_instr_i64_le_u            = 0x58,
-  k_instr_i64_ge_s            = 0x59,
-  k_instr_i64_ge_u            = 0x5a,
-  
-  k_instr_f64_eq              = 0x61,
-  k_instr_f64_ne              = 0x62,
-  k_instr_f64_lt              = 0x63,
-  k_instr_f64_gt              = 0x64,
-  k_instr_f64_le              = 0x65,
-  k_instr_f64_ge              = 0x66,
-  
-  k_instr_i32_clz             = 0x67,
-  k_instr_i32_ctz             = 0x68,
-  k_instr_i32_add             = 0x6a,
-  k_instr_i32_sub             = 0x6b,
-  k_instr_i32_mul             = 0x6c,
-  k_instr_i32_div_s           = 0x6d,
-  k_instr_i32_div_u           = 0x6e,
-  k_instr_i32_rem_s           = 0x6f,
-  k_instr_i32_rem_u           = 0x70,
-  k_instr_i32_and             = 0x71,
-  k_instr_i32_or              = 0x72,
-  k_instr_i32_xor             = 0x73,
-  k_instr_i32_shl             = 0x74,
-  k_instr_i32_shr_s           = 0x75,
-  k_instr_i32_shr_u           = 0x76,
-  k_instr_i32_rotl            = 0x77,
-
-  k_instr_i64_clz             = 0x79,
-  k_instr_i64_ctz             = 0x7a,
-  k_instr_i64_add             = 0x7c,
-  k_instr_i64_sub             = 0x7d,
-  k_instr_i64_mul             = 0x7e,
-  k_instr_i64_div_s           = 0x7f,
-  k_instr_i64_div_u           = 0x80,
-  k_instr_i64_rem_s           = 0x81,
-  k_instr_i64_rem_u           = 0x82,
-  k_instr_i64_and             = 0x83,
-  k_instr_i64_or              = 0x84,
-  k_instr_i64_xor             = 0x85,
-  k_instr_i64_shl             = 0x86,
-  k_instr_i64_shr_s           = 0x87,
-  k_instr_i64_shr_u           = 0x88,
-
-  k_instr_f32_mul             = 0x94,
-
-  k_instr_f64_abs             = 0x99,
-  k_instr_f64_neg             = 0x9a,
-  k_instr_f64_ceil            = 0x9b,
-  k_instr_f64_floor           = 0x9c,
-  k_instr_f64_sqrt            = 0x9f,
-  k_instr_f64_add             = 0xa0,
-  k_instr_f64_sub             = 0xa1,
-  k_instr_f64_mul             = 0xa2,
-  k_instr_f64_div             = 0xa3,
-
-  k_instr_i32_wrap_i64        = 0xa7,
-  k_instr_i32_trunc_f64_s     = 0xaa,
-  k_instr_i32_trunc_f64_u     = 0xab,
-  k_instr_i64_extend_i32_s    = 0xac,
-  k_instr_i64_extend_i32_u    = 0xad,
-  k_instr_i64_trunc_f64_s     = 0xb0,
-  k_instr_i64_trunc_f64_u     = 0xb1,
-  k_instr_f32_convert_i32_s   = 0xb2,
-  k_instr_f32_demote_f64      = 0xb6,
-  k_instr_f64_convert_i32_s   = 0xb7,
-  k_instr_f64_convert_i32_u   = 0xb8,
-  k_instr_f64_convert_i64_s   = 0xb9,
-  k_instr_f64_convert_i64_u   = 0xba,
-  k_instr_f64_promote_f32     = 0xbb,
-  k_instr_i32_reinterpret_f32 = 0xbc,
-  k_instr_i64_reinterpret_f64 = 0xbd,
-  k_instr_f32_reinterpret_i32 = 0xbe,
-  k_instr_f64_reinterpret_i64 = 0xbf,
-
-  k_instr_i32_extend8_s       = 0xc0,
-  k_instr_i32_extend16_s      = 0xc1,
-  k_instr_i64_extend8_s       = 0xc2,
-  k_instr_i64_extend16_s      = 0xc3
+// Malformed input
+// ===============
+//
+// By default, the parser throws a std::logic_error with a human-readable message at the first sign of
+// malformed input.  For callers that expect lots of bad input, there's also a no-throw mode
+// (Wasm_parser::throw_errors = false, or try_parse_wasm below) that records the first error as a compact
+// Parse_error and unwinds by returning normally.  The message is only formatted if someone asks for it.
+
+enum class Parse_error_code : uint8_t {
+  k_unexpected_eof,                 // args: -
+  k_unexpected_end_of_section,      // args: -
+  k_truncated_read,                 // args: count
+  k_truncated_skip,                 // args: count
+  k_vector_too_long,                // args: n, bytes available
+  k_unexpected_byte,                // args: expected, actual
+  k_invalid_leb128,                 // args: N, is_signed, middle byte (vs trailing byte)
+  k_unrecognized_numtype,           // args: byte
+  k_unrecognized_vectype,           // args: byte
+  k_unrecognized_reftype,           // args: byte
+  k_unrecognized_valtype,           // args: byte
+  k_unrecognized_limits,            // args: byte
+  k_unrecognized_mut,               // args: byte
+  k_unrecognized_opcode,            // args: byte
+  k_unrecognized_atomic_opcode,     // args: secondary opcode
+  k_unrecognized_ext_opcode,        // args: secondary opcode
+  k_unrecognized_simd_opcode,       // args: secondary opcode
+  k_too_deeply_nested,              // args: limit (see Parse_options::max_nesting)
+  k_invalid_blocktype,              // args: s33
+  k_unrecognized_importdesc,        // args: byte
+  k_unrecognized_exportdesc,        // args: byte
+  k_unrecognized_elem,              // args: discriminant
+  k_unrecognized_data,              // args: discriminant
+  k_section_too_long,               // args: section id, declared size, limit offset
+  k_section_size_mismatch,          // args: section id, declared size, actual size
+  k_name_subsection_too_long,       // args: subsection id, declared size, limit offset
+  k_name_subsection_size_mismatch,  // args: subsection id, declared size, actual size
+  k_code_size_mismatch,             // args: declared size, actual size
+  k_trailing_data,                  // args: next byte
+
+  // Invalid input (see Parse_options::validate).  Types are Ast_valtypes, or -1 for "any" (expected) or
+  // "nothing" (actual, when the operand stack runs dry).
+  k_type_mismatch,                  // args: expected type, actual type
+  k_unknown_index,                  // args: Ast_index_space, index
+  k_immutable_global,               // args: globalidx
+  k_invalid_alignment,              // args: alignment, natural alignment (both log2)
+  k_invalid_lane_index,             // args: laneidx, number of lanes
+  k_unused_values,                  // args: count
+  k_label_arity_mismatch,           // args: expected arity, actual arity
+  k_invalid_select_arity,           // args: number of types
+  k_untyped_select_of_reftype,      // args: type
+  k_invalid_rethrow,                // args: labelidx
+  k_missing_data_count,             // args: -
+  k_too_many_locals,                // args: -
+  k_func_count_mismatch             // args: functions in function section, code entries seen so far
 };
 
-// Extended instruction Secondary Opcodes (follow a k_instr_ext_prefix opcode = 0xfc)
-enum Ext_instr_ : uint32_t {
-  // 5.4.6 Memory Instructions
-  k_ext_instr_memory_init =  8,
-  k_ext_instr_data_drop   =  9,
-  k_ext_instr_memory_copy = 10,
-  k_ext_instr_memory_fill = 11
+struct Parse_error {
+  Parse_error_code code;
+  long offset;                        // where the problem was spotted
+  std::optional<Section_id> section;  // section being parsed, if any
+  int64_t args[3];                    // details, depending on code (see above)
+
+  auto message() const -> std::string;
 };
 
-// Thread Secondary Opcodes (follow a k_instr_atomic_prefix opcode = 0xfe)
-enum Thread_instr_secondary_opcode : uint8_t {
-  // 5.4.6bis Atomic Memory Instructions (5.4.4 in Threads spec)
-  k_atomic_instr_memory_atomic_notify      = 0x00,
-  k_atomic_instr_memory_atomic_wait32      = 0x01,
-
-  k_atomic_instr_i32_atomic_load           = 0x10,
-  k_atomic_instr_i64_atomic_load           = 0x11,
-  k_atomic_instr_i32_atomic_load8          = 0x12,
-  k_atomic_instr_i32_atomic_store          = 0x17,
-  k_atomic_instr_i64_atomic_store          = 0x18,
-  k_atomic_instr_i32_atomic_store8         = 0x19,
-  k_atomic_instr_i32_atomic_rmw_add        = 0x1e,
-
-  k_atomic_instr_i32_atomic_rmw_sub        = 0x25,
-  
-  k_atomic_instr_i32_atomic_rmw_or         = 0x33,
-  
-  k_atomic_instr_i32_atomic_rmw_xchg       = 0x41,
-  k_atomic_instr_i32_atomic_rmw8_xchg_u    = 0x43,
-  
-  k_atomic_instr_i32_atomic_rmw_cmpxchg    = 0x48,
-  k_atomic_instr_i32_atomic_rmw8_cmpxchg_u = 0x4a
+// Either a T or the Parse_error that prevented producing it (a poor man's C++23 std::expected)
+template<typename T>
+class Parse_result {
+ public:
+  Parse_result(T value) : value_{std::move(value)} {}
+  Parse_result(Parse_error error) : value_{error} {}
+
+  auto has_value() const -> bool { return value_.index() == 0; }
+  explicit operator bool() const { return has_value(); }
+
+  // Throws std::logic_error with the error message if there's no value
+  auto value() & -> T& { check(); return std::get<0>(value_); }
+  auto value() const& -> const T& { check(); return std::get<0>(value_); }
+  auto value() && -> T&& { check(); return std::get<0>(std::move(value_)); }
+  auto operator*() -> T& { return std::get<0>(value_); }
+  auto operator->() -> T* { return &std::get<0>(value_); }
+
+  auto error() const -> const Parse_error& { return std::get<1>(value_); }
+
+ private:
+  auto check() const -> void {
+    if (not has_value()) { throw std::logic_error(error().message()); }
+  }
+
+  std::variant<T, Parse_error> value_;
 };
 
-struct Wasm_parser {
-  std::istream* is_;
-  uint8_t cur_byte;  // only valid if is_->eof() is false
-  long cur_offset;
+struct Parse_options {
+  // Keep function bodies as undecoded bytes (Ast_code::body), to be decoded with parse_lazy_func() if needed
+  bool lazy_function_bodies = false;
+
+  // Bytes kept in the AST (data segments, lazy function bodies) point into the input if it's a buffer, so the
+  // buffer must outlive the module.  Set this to copy them into the module's arena instead.
+  bool copy_bytes = false;
+
+  // Decode function bodies on this many threads (buffer inputs only; ignored with lazy_function_bodies).
+  // Malformed input is reported with the same error as when decoding on one thread.
+  int num_threads = 1;
+
+  // Also validate function bodies (3.3 Instructions) as they're decoded, against the types of the module's
+  // functions, locals, globals, tables, ... .  Reports the first invalid instruction.  Not supported by
+  // Streaming_parser yet.
+  bool validate = false;
 
-  explicit Wasm_parser(std::istream& is) : is_{&is} { prime(); }
+  // Most blocks (block, loop, if, try) that can be open at once in a function body or constant expression.
+  // Blocks are decoded without recursion, so this only bounds the parser's control stack.
+  uint32_t max_nesting = 1 << 20;
+};
+
+// 5.4.1 Control Instructions: a block that the parser has seen the start of, but not the end
+struct Control_frame {
+  uint32_t block;  // index of its first instruction in Ast_func::body
+  uint8_t clause;  // opcode of the part we're in (e.g., k_instr_else after the else of an if)
+};
 
-  auto prime() -> void;
+// The parser is specialized at compile time on where its bytes come from (see byte_source.h):
+// over contiguous buffers, the hot decode paths compile down to pointer bumps.
+template<Byte_source Source>
+struct Wasm_parser {
+  Source src_;
+  std::optional<Section_id> cur_section{};  // section being parsed, if any
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource();  // for the AST (see Ast_arena)
+  std::pmr::vector<uint32_t> scratch_u32s{resource};  // reused for index vectors that we don't keep yet
+  std::string scratch_name{};                         // backs the names returned by parse_name() for streams
+  std::pmr::vector<Ast_valtype> scratch_valtypes{};   // backs the types returned by parse_functype()
+  Ast_func scratch_func{};  // function bodies are decoded here, then copied out
+  std::vector<Control_frame> control_stack{};  // blocks still open while decoding an expression
+  Func_validator validator{};                  // see Parse_options::validate
+  Parse_options options{};
+  bool throw_errors = true;  // false => record the first error in first_error and unwind without throwing
+  std::optional<Parse_error> first_error{};
+
+  explicit Wasm_parser(std::istream& is)
+      requires std::constructible_from<Source, std::istream&> : src_{is} {}
+  explicit Wasm_parser(std::span<const uint8_t> bytes)
+      requires std::constructible_from<Source, std::span<const uint8_t>> : src_{bytes} {}
+  Wasm_parser(std::span<const uint8_t> bytes, long base_offset)  // bytes start at base_offset in the input
+      requires std::constructible_from<Source, std::span<const uint8_t>, long> : src_{bytes, base_offset} {}
+  Wasm_parser(std::span<const uint8_t> bytes, long base_offset, std::pmr::memory_resource* resource)
+      requires std::constructible_from<Source, std::span<const uint8_t>, long>
+      : src_{bytes, base_offset}, resource{resource} {}
+
+  // Points the parser at new input and clears any error, keeping its scratch space (and options)
+  auto reset(std::span<const uint8_t> bytes, long base_offset) -> void
+      requires std::constructible_from<Source, std::span<const uint8_t>, long> {
+    src_ = Source{bytes, base_offset};
+    cur_section = std::nullopt;
+    first_error = std::nullopt;
+  }
+
+  auto at_eof() const -> bool { return src_.at_eof(); }
+  auto cur_byte() const -> uint8_t { return src_.peek(); }  // only meaningful if at_eof() is false
+  auto cur_offset() const -> long { return src_.offset(); }
   auto skip_bytes(std::streamsize count) -> void;
 
+  // Error reporting.  After fail() returns (no-throw mode only), parse_* functions return harmless dummy
+  // values, and loops bail out as soon as they see that ok() is false.
+  auto ok() const -> bool { return not first_error.has_value(); }
+  [[gnu::cold, gnu::noinline]] auto fail(Parse_error_code code, long offset,
+                                         int64_t arg0 = 0, int64_t arg1 = 0, int64_t arg2 = 0) -> void;
+  [[gnu::cold, gnu::noinline]] auto fail(const Parse_error& error) -> void;
+
 
   // 5.1 Conventions
   // ===============
 
   // 5.1.3 Vectors
   auto parse_vec(std::invocable<uint32_t /*i*/> auto element_parser)
-      -> std::vector<decltype(element_parser(0))>;
+      -> std::pmr::vector<decltype(element_parser(0))>;
+  auto parse_u32_vec(std::pmr::vector<uint32_t>& out) -> void;  // vec(u32) in bulk, e.g., vec(typeidx)
 
   
   // 5.2 Values
@@ -293,6 +295,9 @@ struct Wasm_parser {
   
   // 5.2.1 Bytes
   auto parse_byte() -> uint8_t;
+  auto parse_bytes(uint8_t* dst, long count) -> void;
+  auto parse_kept_bytes(Ast_module& module, long count) -> std::span<const uint8_t>;  // see copy_bytes
+  auto capture_kept_bytes(Ast_module& module, std::invocable<> auto parse) -> std::span<const uint8_t>;
   auto match_byte(uint8_t expected) -> void;
   auto maybe_match_byte(uint8_t probe) -> bool;
 
@@ -301,10 +306,12 @@ struct Wasm_parser {
   auto parse_u16() -> uint16_t;
   auto parse_u32() -> uint32_t;
   auto internal_parse_uN(int N) -> uint64_t;
+  template<int N> auto internal_fast_parse_uN() -> uint64_t;
   auto parse_s8() -> int8_t;
   auto parse_s16() -> int16_t;
   auto parse_s33() -> int64_t;
   auto internal_parse_sN(int N) -> int64_t;
+  template<int N> auto internal_fast_parse_sN() -> int64_t;
   auto parse_i32() -> int32_t;
   auto parse_i64() -> int64_t;
 
@@ -313,7 +320,8 @@ struct Wasm_parser {
   auto parse_f64() -> double;
 
   // 5.2.4 Names
-  auto parse_name() -> std::string;
+  auto parse_name() -> std::string_view;  // for streams, only valid until the next call
+  auto parse_kept_name(Ast_module& module) -> Ast_name;  // see Ast_name
 
   
   // 5.3 Types
@@ -333,23 +341,23 @@ struct Wasm_parser {
   auto parse_valtype() -> Ast_valtype;
 
   // 5.3.5 Result Types
-  auto parse_resulttype() -> Ast_resulttype;
+  auto parse_resulttype(std::pmr::vector<Ast_valtype>& out) -> void;  // appends to out
   
   // 5.3.6 Function Types
-  auto parse_functype() -> Ast_functype;
+  auto parse_functype() -> Ast_functype;  // only valid until the next call (see Ast_type_table::add)
 
   // 5.3.7 Limit Types
-  auto parse_limits() -> void;
+  auto parse_limits() -> Ast_limits;
   
   // 5.3.8 Memory Types
-  auto parse_memtype() -> void;
+  auto parse_memtype() -> Ast_memtype;
   
   // 5.3.9 Table Types
-  auto parse_tabletype() -> void;
+  auto parse_tabletype() -> Ast_tabletype;
   
   // 5.3.10 Global Types
-  auto parse_globaltype() -> void;
-  auto parse_mut() -> void;
+  auto parse_globaltype() -> Ast_globaltype;
+  auto parse_mut() -> Ast_mut;
 
   // [EXTRA] Tag Types (5.3.11 in Exception Handling Spec)
   auto parse_tagtype() -> void;
@@ -359,30 +367,38 @@ struct Wasm_parser {
   // ================
 
   // <instr> is defined over several subsections...
-  auto parse_instr() -> void;
+  auto parse_instr(Ast_func& out) -> bool;  // appends to out; true at the end of the expression
+  auto parse_immediates(Imm_kind kind, Ast_instr& instr) -> void;
+  auto parse_secondary_opcode(Ast_instr& instr) -> Imm_kind;
+  auto skip_instr() -> int;  // change in block depth
 
   // 5.4.1 Control Instructions
-  auto parse_blocktype() -> void;
+  auto parse_clause(Ast_func& out, uint32_t i, long opcode_offset) -> bool;
+  auto parse_blocktype() -> uint32_t;  // see k_blocktype_empty
 
   // 5.4.4 Memory Instructions
-  auto parse_memarg() -> void;
+  auto parse_memarg() -> Ast_memarg;
+
+  // 5.4.8 Vector Instructions
+  auto parse_v128() -> Ast_v128;
   
   // 5.4.9 Expressions
-  auto parse_expr() -> void;
+  auto parse_expr(Ast_func& out, bool validate = false) -> void;  // appends to out (see validator)
+  auto parse_expr() -> void;  // skipped (see skip_instr())
   
   // 5.5 Modules
   // ===========
 
   // 5.5.1 Indices
-  auto parse_typeidx() -> void;
-  auto parse_funcidx() -> void;
-  auto parse_tableidx() -> void;
-  auto parse_memidx() -> void;
-  auto parse_tagidx() -> void;
-  auto parse_globalidx() -> void;
-  auto parse_dataidx() -> void;
-  auto parse_localidx() -> void;
-  auto parse_labelidx() -> void;
+  auto parse_typeidx() -> Ast_typeidx;
+  auto parse_funcidx() -> Ast_funcidx;
+  auto parse_tableidx() -> Ast_tableidx;
+  auto parse_memidx() -> Ast_memidx;
+  auto parse_tagidx() -> Ast_tagidx;
+  auto parse_globalidx() -> Ast_globalidx;
+  auto parse_dataidx() -> Ast_dataidx;
+  auto parse_localidx() -> Ast_localidx;
+  auto parse_labelidx() -> Ast_labelidx;
   
   // 5.5.2 Sections
   auto parse_section(Section_id section_id, std::invocable<uint32_t /*size*/> auto section_parser)
@@ -393,41 +409,41 @@ struct Wasm_parser {
   // > 7.4.1 Name section
   auto parse_namesubsection(Name_subsection_id N, std::invocable<uint32_t /*size*/> auto subsection_parser)
       -> decltype(subsection_parser(0));
-  auto parse_modulenamesubsec() -> std::string;
-  auto parse_funcnamesubsec() -> void;
+  auto parse_modulenamesubsec(Ast_module& module) -> Ast_name;
+  auto parse_funcnamesubsec(Ast_module& module) -> Ast_namemap;
   auto parse_localnamesubsec() -> void;
-  auto parse_globalnamesubsec() -> void;
-  auto parse_datasegmentnamesubsec() -> void;
-  auto parse_namemap(bool dump = false) -> std::vector<Ast_TODO>;
-  auto parse_nameassoc(bool dump = false) -> void;
-  auto parse_indirectnamemap(bool dump) -> std::vector<Ast_TODO>;
+  auto parse_globalnamesubsec(Ast_module& module) -> Ast_namemap;
+  auto parse_datasegmentnamesubsec(Ast_module& module) -> Ast_namemap;
+  auto parse_namemap(Ast_module& module, bool dump = false) -> Ast_namemap;
+  auto parse_nameassoc(Ast_module& module, bool dump = false) -> Ast_nameassoc;
+  auto parse_indirectnamemap(bool dump) -> std::pmr::vector<Ast_TODO>;
   auto parse_indirectnameassoc(bool dump) -> void;
 
   // 5.5.4 Type Section
-  auto parse_typesec() -> std::vector<Ast_functype>;
+  auto parse_typesec() -> Ast_type_table;
 
   // 5.5.5 Import Section
-  auto parse_importdesc() -> void;
-  auto parse_importsec() -> std::vector<Ast_import>;
-  auto parse_import() -> Ast_import;
+  auto parse_importdesc() -> Ast_importdesc;
+  auto parse_importsec(Ast_module& module) -> std::pmr::vector<Ast_import>;
+  auto parse_import(Ast_module& module) -> Ast_import;
 
   // 5.5.6 Function Section
-  auto parse_funcsec() -> std::vector<Ast_TODO>;
+  auto parse_funcsec() -> std::pmr::vector<Ast_typeidx>;
 
   // 5.5.7 Table Section
-  auto parse_tablesec() -> std::vector<Ast_TODO>;
-  auto parse_table() -> void;
+  auto parse_tablesec() -> std::pmr::vector<Ast_tabletype>;
+  auto parse_table() -> Ast_tabletype;
 
   // 5.5.8 Memory Section
-  auto parse_memsec() -> std::vector<Ast_TODO>;
-  auto parse_mem() -> void;
+  auto parse_memsec() -> std::pmr::vector<Ast_memtype>;
+  auto parse_mem() -> Ast_memtype;
 
   // 5.5.9 Global Section
-  auto parse_globalsec() -> std::vector<Ast_TODO>;
-  auto parse_global() -> void;
+  auto parse_globalsec() -> std::pmr::vector<Ast_global>;
+  auto parse_global() -> Ast_global;
 
   // 5.5.10 Export Section
-  auto parse_exportsec() -> std::vector<Ast_TODO>;
+  auto parse_exportsec() -> std::pmr::vector<Ast_TODO>;
   auto parse_export() -> void;
   auto parse_exportdesc() -> void;
 
@@ -436,37 +452,138 @@ struct Wasm_parser {
   auto parse_start() -> void;
 
   // 5.5.12 Element Section
-  auto parse_elemsec() -> std::vector<Ast_TODO>;
-  auto parse_elem() -> void;
+  auto parse_elemsec() -> std::pmr::vector<Ast_elem>;
+  auto parse_elem() -> Ast_elem;
 
   // 5.5.13 Code Section
-  auto parse_codesec() -> std::vector<Ast_TODO>;
-  auto parse_code() -> void;
-  auto parse_func() -> void;
-  auto parse_locals() -> void;
+  auto parse_codesec(Ast_module& module) -> std::pmr::vector<Ast_code>;
+  // funcidx: of the function among those defined in the module, to validate it against (see Func_validator)
+  auto parse_code(Ast_module& module, std::optional<uint32_t> funcidx = std::nullopt) -> Ast_code;
+  auto parse_func(std::optional<uint32_t> funcidx = std::nullopt) -> Ast_func;
+  auto parse_locals() -> Ast_locals;
 
   // 5.5.14 Data Section
-  auto parse_datasec() -> std::vector<Ast_TODO>;
-  auto parse_data() -> void;
+  auto parse_datasec(Ast_module& module) -> std::pmr::vector<Ast_data>;
+  auto parse_data(Ast_module& module) -> Ast_data;
 
   // 5.5.15 Data Count Section
   auto parse_datacountsec() -> uint32_t;
 
   // [EXTRA] Tag Section  (5.5.16 in Exception Handling Spec)
-  auto parse_tagsec() -> std::vector<Ast_TODO>;
-  auto parse_tag() -> void;
+  auto parse_tagsec() -> std::pmr::vector<Ast_tag>;
+  auto parse_tag() -> Ast_tag;
 
   // 5.5.16 Modules
   auto parse_magic() -> void;
   auto parse_version() -> void;
   auto parse_module() -> Ast_module;
+  auto can_parse_module_section(int last_order) -> bool;  // can the next section come after last_order?
+  auto parse_module_section(Ast_module& module, int& last_order) -> void;
+
+  // [EXTRA] Section index
+  auto parse_section_index() -> Section_index;
 };
 
-inline auto parse_wasm(std::istream& is) -> Ast_module {
+Wasm_parser(std::istream&) -> Wasm_parser<Istream_byte_source>;
+Wasm_parser(std::span<const uint8_t>) -> Wasm_parser<Span_byte_source>;
+Wasm_parser(std::span<const uint8_t>, long) -> Wasm_parser<Span_byte_source>;
+Wasm_parser(std::span<const uint8_t>, long, std::pmr::memory_resource*) -> Wasm_parser<Span_byte_source>;
+
+// Defined in parser.cpp
+extern template struct Wasm_parser<Istream_byte_source>;
+extern template struct Wasm_parser<Span_byte_source>;
+
+inline auto parse_wasm(std::istream& is, Parse_options options = {}) -> Ast_module {
   auto parser = Wasm_parser{is};
+  parser.options = options;
+  return parser.parse_module();
+}
+
+inline auto parse_wasm(std::span<const uint8_t> bytes, Parse_options options = {}) -> Ast_module {
+  auto parser = Wasm_parser{bytes};
+  parser.options = options;
   return parser.parse_module();
 }
 
+// Decodes a function body kept undecoded by lazy_function_bodies, reusing `parser` (and its scratch space).
+// With a funcidx, also validates it (parser.validator must have seen the module's begin_module() already).
+inline auto try_parse_lazy_func(Wasm_parser<Span_byte_source>& parser, const Ast_code& code,
+                                std::optional<uint32_t> funcidx = std::nullopt) -> Parse_result<Ast_func> {
+  parser.reset(code.body, code.offset);
+  parser.throw_errors = false;
+  parser.cur_section = k_section_code;
+  auto func = parser.parse_func(funcidx);
+  if (parser.ok() && not parser.at_eof()) {
+    parser.fail(Parse_error_code::k_code_size_mismatch, code.offset, code.size, parser.cur_offset() - code.offset);
+  }
+  if (not parser.ok()) { return *parser.first_error; }
+  return func;
+}
+
+inline auto try_parse_lazy_func(const Ast_code& code,
+                                std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    -> Parse_result<Ast_func> {
+  auto parser = Wasm_parser{code.body, code.offset, resource};
+  return try_parse_lazy_func(parser, code);
+}
+
+inline auto parse_lazy_func(const Ast_code& code) -> Ast_func {
+  return try_parse_lazy_func(code).value();
+}
+
+inline auto index_wasm(std::istream& is) -> Section_index {
+  auto parser = Wasm_parser{is};
+  return parser.parse_section_index();
+}
+
+inline auto index_wasm(std::span<const uint8_t> bytes) -> Section_index {
+  auto parser = Wasm_parser{bytes};
+  return parser.parse_section_index();
+}
+
+// A parser positioned at the start of a section located by index_wasm(bytes) and bounded to it, e.g., to
+// call parse_typesec() or parse_module_section() on
+inline auto section_parser(std::span<const uint8_t> bytes, const Section_entry& entry)
+    -> Wasm_parser<Span_byte_source> {
+  return Wasm_parser{bytes.subspan(entry.offset, entry.end_offset() - entry.offset), entry.offset};
+}
+
+// The module's name (7.4.1 Name Section), decoding nothing but the name section.  That section usually comes
+// last, so this is how to find the name before going through the rest of the module in order.
+inline auto find_module_name(std::span<const uint8_t> bytes, const Section_index& index)
+    -> std::optional<std::string> {
+  auto name = std::optional<std::string>{};
+  for (const auto& entry : index.sections) {
+    if (entry.id == k_section_custom && entry.name == "name") {
+      auto module = Ast_module{};
+      section_parser(bytes, entry).parse_customsec(module);
+      if (module.name.has_value()) { name = std::string{*module.name}; }
+    }
+  }
+  return name;
+}
+
+// Like parse_wasm, but reports malformed input without throwing
+template<Byte_source Source>
+auto try_parse_module(Wasm_parser<Source>& parser) -> Parse_result<Ast_module> {
+  parser.throw_errors = false;
+  auto module = parser.parse_module();
+  if (not parser.ok()) { return *parser.first_error; }
+  return module;
+}
+
+inline auto try_parse_wasm(std::istream& is, Parse_options options = {}) -> Parse_result<Ast_module> {
+  auto parser = Wasm_parser{is};
+  parser.options = options;
+  return try_parse_module(parser);
+}
+
+inline auto try_parse_wasm(std::span<const uint8_t> bytes, Parse_options options = {}) -> Parse_result<Ast_module> {
+  auto parser = Wasm_parser{bytes};
+  parser.options = options;
+  return try_parse_module(parser);
+}
+
 }  // namespace wasmtoolbox
 
 #endif /* WASMTOOLBOX_PARSER_H */
@@ -0,0 +1,216 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "streaming_parser.h"
+
+#include <algorithm>
+#include <memory_resource>
+#include <stdexcept>
+
+namespace wasmtoolbox {
+
+namespace {
+
+// Length of the magic and version (5.5.16)
+constexpr auto k_header_size = long{8};
+
+// Number of bytes that a parser needs to see to decode a u32 at the start of `bytes`: up to and including
+// the terminating byte, or the longest valid encoding if it's not there (so that the parser diagnoses it).
+// -1 if the number hasn't fully arrived yet.
+auto u32_extent(std::span<const uint8_t> bytes) -> long {
+  constexpr auto k_max_u32_size = long{5};
+  auto n = std::min(static_cast<long>(bytes.size()), k_max_u32_size);
+  for (auto i = long{0}; i != n; ++i) {
+    if ((bytes[i] & 0x80) == 0) { return i + 1; }
+  }
+  return n == k_max_u32_size ? n : -1;
+}
+
+}  // namespace
+
+auto Streaming_parser::feed(std::span<const uint8_t> bytes) -> void {
+  if (not ok()) { return; }
+
+  if (buffer_.empty()) {
+    // Decode straight out of the caller's bytes, and only hold on to the incomplete tail
+    auto used = consume(bytes);
+    buffer_.assign(bytes.begin() + used, bytes.end());
+    buffer_offset_ += used;
+  } else {
+    buffer_.insert(buffer_.end(), bytes.begin(), bytes.end());
+    auto used = consume(buffer_);
+    buffer_.erase(buffer_.begin(), buffer_.begin() + used);
+    buffer_offset_ += used;
+  }
+}
+
+auto Streaming_parser::finish() -> Ast_module {
+  if (ok() && (state_ != State::k_sections || not buffer_.empty())) {
+    fail(Parse_error_code::k_unexpected_eof, buffer_offset_ + static_cast<long>(buffer_.size()));
+  }
+  return std::move(module_);
+}
+
+// Decodes as much of `bytes` (which start at buffer_offset_) as possible, and returns how many bytes that was
+auto Streaming_parser::consume(std::span<const uint8_t> bytes) -> long {
+  auto pos = long{0};
+  while (ok()) {
+    auto rest = bytes.subspan(pos);
+    auto offset = buffer_offset_ + pos;
+
+    switch (state_) {
+      case State::k_header: {
+        if (static_cast<long>(rest.size()) < k_header_size) { return pos; }
+        run_parser(rest.first(k_header_size), offset, std::nullopt, [&](auto& parser) {
+          parser.parse_magic();
+          parser.parse_version();
+        });
+        pos += k_header_size;
+        state_ = State::k_sections;
+        break;
+      }
+
+      case State::k_sections: {
+        if (rest.empty()) { return pos; }
+        auto id = rest[0];
+        auto order = section_order(id);
+        if (order < 0 || (order != 0 && order <= last_order_)) {
+          // Same as what parse_module() says when it runs into a section that can't come next
+          fail(Parse_error_code::k_trailing_data, offset, id);
+          return pos;
+        }
+
+        // 5.5.2 Sections: id, then u32 size
+        auto size_extent = u32_extent(rest.subspan(1));
+        if (size_extent < 0) { return pos; }
+        auto size = uint32_t{0};
+        run_parser(rest.subspan(1, size_extent), offset + 1, std::nullopt, [&](auto& parser) {
+          size = parser.parse_u32();
+        });
+        if (not ok()) { return pos; }
+        auto header_size = 1 + size_extent;
+
+        if (skip_section && skip_section(Section_id{id})) {
+          if (order != 0) { last_order_ = order; }
+          pos += header_size;
+          skip_left_ = size;
+          state_ = State::k_skipping;
+        } else if (id == k_section_code) {
+          // Decode the function bodies one by one as they arrive, starting with the size of vec(code)
+          auto count_extent = u32_extent(rest.subspan(header_size));
+          if (count_extent < 0) { return pos; }
+          if (count_extent > size) {
+            fail(Parse_error_code::k_unexpected_end_of_section, offset + header_size + size);
+            return pos;
+          }
+          run_parser(rest.subspan(header_size, count_extent), offset + header_size, k_section_code,
+                     [&](auto& parser) { code_entries_left_ = parser.parse_u32(); });
+          code_section_start_ = offset + header_size;
+          code_section_size_ = size;
+          next_code_entry_ = 0;
+          last_order_ = order;
+          pos += header_size + count_extent;
+          state_ = State::k_code_entries;
+        } else {
+          if (static_cast<long>(rest.size()) < header_size + size) { return pos; }
+          run_parser(rest.first(header_size + size), offset, std::nullopt, [&](auto& parser) {
+            parser.parse_module_section(module_, last_order_);
+          });
+          pos += header_size + size;
+        }
+        break;
+      }
+
+      case State::k_code_entries: {
+        auto section_end = code_section_start_ + code_section_size_;
+        if (code_entries_left_ == 0) {
+          if (offset != section_end) {
+            fail(Parse_error_code::k_section_size_mismatch, code_section_start_,
+                 k_section_code, code_section_size_, offset - code_section_start_);
+            return pos;
+          }
+          state_ = State::k_sections;
+          break;
+        }
+
+        // 5.5.13 Code Section: u32 size, then the function itself
+        auto size_extent = u32_extent(rest);
+        if (size_extent < 0) { return pos; }
+        auto size = uint32_t{0};
+        run_parser(rest.first(size_extent), offset, k_section_code, [&](auto& parser) {
+          size = parser.parse_u32();
+        });
+        if (not ok()) { return pos; }
+        if (offset + size_extent + size > section_end) {
+          fail(Parse_error_code::k_unexpected_end_of_section, section_end);
+          return pos;
+        }
+        if (static_cast<long>(rest.size()) < size_extent + size) { return pos; }
+        run_parser(rest.first(size_extent + size), offset, k_section_code, [&](auto& parser) {
+          if (on_code) { parser.resource = std::pmr::get_default_resource(); }  // see on_code
+          auto code = parser.parse_code(module_);
+          if (not on_code) {
+            module_.codes.push_back(std::move(code));
+          } else if (parser.ok()) {
+            on_code(next_code_entry_, std::move(code));
+          }
+        });
+        pos += size_extent + size;
+        ++next_code_entry_;
+        --code_entries_left_;
+        break;
+      }
+
+      case State::k_skipping: {
+        auto n = std::min(static_cast<long>(rest.size()), static_cast<long>(skip_left_));
+        pos += n;
+        skip_left_ -= n;
+        if (skip_left_ != 0) { return pos; }
+        state_ = State::k_sections;
+        break;
+      }
+    }
+  }
+  return pos;
+}
+
+auto Streaming_parser::fail(Parse_error_code code, long offset, int64_t arg0, int64_t arg1, int64_t arg2) -> void {
+  auto section = state_ == State::k_code_entries ? std::optional{k_section_code} : std::nullopt;
+  auto error = Parse_error{code, offset, section, {arg0, arg1, arg2}};
+  if (throw_errors) {
+    throw std::logic_error(error.message());
+  }
+  if (ok()) {
+    first_error = error;
+  }
+}
+
+// Runs f on the parser, pointed at a piece of the input that starts at `offset`, and picks up the error if it
+// fails.  The parser keeps its scratch space from one piece to the next.
+auto Streaming_parser::run_parser(std::span<const uint8_t> bytes, long offset, std::optional<Section_id> section,
+                                  std::invocable<Wasm_parser<Span_byte_source>&> auto f) -> void {
+  parser_.reset(bytes, offset);
+  parser_.resource = module_.arena.resource();
+  parser_.throw_errors = throw_errors;
+  parser_.options.copy_bytes = true;  // bytes only live until feed() returns
+  parser_.cur_section = section;
+  f(parser_);
+  if (not parser_.ok() && ok()) {
+    first_error = parser_.first_error;
+  }
+}
+
+}  // namespace wasmtoolbox
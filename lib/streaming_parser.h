@@ -0,0 +1,95 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WASMTOOLBOX_STREAMING_PARSER_H
+#define WASMTOOLBOX_STREAMING_PARSER_H
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "ast.h"
+#include "parser.h"
+
+namespace wasmtoolbox {
+
+// Push-mode parsing of a module that arrives in chunks (e.g., off a socket).
+//
+// Hand over the bytes with feed() as they arrive, then call finish() to get the module.  Each section is
+// decoded as soon as all of its bytes have arrived, except for the code section, which is decoded one
+// function body at a time.  Only the bytes of the section or function body still in flight are buffered.
+//
+// Errors are reported like in Wasm_parser: thrown as std::logic_error by default, or recorded in
+// first_error if throw_errors is false, in which case further input is ignored.
+//
+// To go through a module without holding on to all of it (see write_wasm_streaming()), set on_code to take
+// each function body as it's decoded, and skip_section to pass over the sections that aren't needed.
+class Streaming_parser {
+ public:
+  bool throw_errors = true;
+  std::optional<Parse_error> first_error{};
+
+  // If set, called with each function body (and its index among the functions defined in the module) as soon
+  // as it's decoded, instead of adding it to the codes of the module that finish() returns.  Unlike the rest
+  // of the module, these bodies aren't allocated in its arena, so their memory goes away with them.
+  std::function<void(uint32_t, Ast_code&&)> on_code{};
+
+  // If set, the sections for which this returns true are passed over as they arrive: only their place in the
+  // section order and their size are checked, and none of their bytes are buffered
+  std::function<bool(Section_id)> skip_section{};
+
+  auto ok() const -> bool { return not first_error.has_value(); }
+
+  auto feed(std::span<const uint8_t> bytes) -> void;
+  auto finish() -> Ast_module;
+
+  auto parsed_offset() const -> long { return buffer_offset_; }  // everything before this has been decoded
+
+  auto module() const -> const Ast_module& { return module_; }  // the sections decoded so far
+
+ private:
+  enum class State : uint8_t {
+    k_header,        // magic and version
+    k_sections,      // next section (header)
+    k_code_entries,  // next function body in the code section
+    k_skipping,      // the rest of a section that skip_section() picked
+  };
+
+  auto consume(std::span<const uint8_t> bytes) -> long;
+  auto fail(Parse_error_code code, long offset, int64_t arg0 = 0, int64_t arg1 = 0, int64_t arg2 = 0) -> void;
+  auto run_parser(std::span<const uint8_t> bytes, long offset, std::optional<Section_id> section,
+                  std::invocable<Wasm_parser<Span_byte_source>&> auto f) -> void;
+
+  State state_ = State::k_header;
+  std::vector<uint8_t> buffer_{};  // bytes received but not decoded yet
+  long buffer_offset_ = 0;         // offset in the module of buffer_[0]
+  Ast_module module_{};
+  Wasm_parser<Span_byte_source> parser_{std::span<const uint8_t>{}, 0};  // reused for every section and body
+  int last_order_ = 0;             // section_order() of the last non-custom section
+
+  uint32_t code_entries_left_ = 0;
+  uint32_t next_code_entry_ = 0;
+  long code_section_start_ = 0;    // offset of the code section contents (just past its size)
+  uint32_t code_section_size_ = 0;
+
+  uint32_t skip_left_ = 0;         // bytes of the skipped section that haven't arrived yet
+};
+
+}  // namespace wasmtoolbox
+
+#endif /* WASMTOOLBOX_STREAMING_PARSER_H */
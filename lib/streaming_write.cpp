@@ -0,0 +1,78 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "streaming_write.h"
+
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "streaming_parser.h"
+#include "text_format.h"
+
+namespace wasmtoolbox {
+
+namespace {
+
+// How much of the input to read at a time
+constexpr auto k_chunk_size = size_t{64} * 1024;
+
+auto is_written(Section_id id) -> bool {
+  return id != k_section_custom && id != k_section_element && id != k_section_data;
+}
+
+}  // namespace
+
+auto write_wasm_streaming(Output_sink& out, std::istream& is, std::optional<std::string_view> module_name,
+                          Text_format_options options) -> void {
+  auto parser = Streaming_parser{};
+  auto writer = Text_format_writer{out};
+  writer.options = options;
+
+  // The types and imports come before the code section, so they're all in by the time the first body is.
+  // Since the parser keeps no bodies, write_module_field() only has those to go through.
+  auto started = false;
+  auto write_start = [&](const Ast_module& module) {
+    if (std::exchange(started, true)) { return; }
+    writer.write_module_start(module_name);
+    for (auto i = size_t{0}; i != Text_format_writer::num_module_fields(module); ++i) {
+      writer.write_module_field(module, i);
+    }
+  };
+
+  parser.skip_section = [](Section_id id) { return not is_written(id); };
+  parser.on_code = [&](uint32_t i, Ast_code&& code) {
+    write_start(parser.module());
+    const auto& func_types = parser.module().func_types;
+    if (i < func_types.size()) {  // as many as write_module() writes
+      writer.write_func(func_types[i], code);
+    }
+  };
+
+  auto chunk = std::vector<char>(k_chunk_size);
+  while (is) {
+    is.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    auto bytes = std::span{reinterpret_cast<const uint8_t*>(chunk.data()), static_cast<size_t>(is.gcount())};
+    parser.feed(bytes);
+  }
+  auto module = parser.finish();
+
+  write_start(module);
+  writer.write_module_end();
+}
+
+}  // namespace wasmtoolbox
@@ -0,0 +1,48 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef WASMTOOLBOX_STREAMING_WRITE_H
+#define WASMTOOLBOX_STREAMING_WRITE_H
+
+#include <iostream>
+#include <optional>
+#include <string_view>
+
+#include "output_sink.h"
+#include "text_format.h"
+
+namespace wasmtoolbox {
+
+// Writes the module read from `is` to `out` in the text format, as it's decoded, without ever holding all of
+// it in memory.  The output is the same, byte for byte, as Text_format_writer::write_module() on the module
+// that parse_wasm(is) returns, provided that module_name is that module's name.
+//
+// The input is fed to a Streaming_parser in fixed-size chunks.  Each function body is written and dropped as
+// soon as it's decoded, and the sections that aren't written (custom, element and data) are passed over
+// without being buffered, so memory use is bounded by the largest function body and the type, import and
+// function sections, whatever the size of the rest.  Skipped sections are only checked for their size.
+//
+// The name section usually comes at the end of the module, too late to go at the start of the text, so the
+// module's name is taken from module_name instead (see find_module_name()).
+//
+// Malformed input throws std::logic_error, with the output written up to the field before the problem.
+auto write_wasm_streaming(Output_sink& out, std::istream& is, std::optional<std::string_view> module_name,
+                          Text_format_options options = {}) -> void;
+
+}  // namespace wasmtoolbox
+
+#endif /* WASMTOOLBOX_STREAMING_WRITE_H */
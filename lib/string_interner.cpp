@@ -0,0 +1,31 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "string_interner.h"
+
+#include <algorithm>
+
+namespace wasmtoolbox {
+
+auto String_interner::intern(std::string_view str) -> std::string_view {
+  if (auto it = strings_.find(str); it != strings_.end()) { return *it; }
+  auto resource = strings_.get_allocator().resource();
+  auto copy = static_cast<char*>(resource->allocate(str.size(), 1));
+  std::copy(str.begin(), str.end(), copy);
+  return *strings_.emplace(copy, str.size()).first;
+}
+
+}  // namespace wasmtoolbox
@@ -0,0 +1,43 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WASMTOOLBOX_STRING_INTERNER_H
+#define WASMTOOLBOX_STRING_INTERNER_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_set>
+
+namespace wasmtoolbox {
+
+// One copy of each distinct string, allocated from `resource` (e.g., a module's Ast_arena).  The views handed
+// out stay valid for as long as the resource does, even if the interner is moved.
+class String_interner {
+ public:
+  explicit String_interner(std::pmr::memory_resource* resource) : strings_{resource} {}
+
+  auto intern(std::string_view str) -> std::string_view;
+
+  auto size() const -> size_t { return strings_.size(); }  // number of distinct strings
+
+ private:
+  std::pmr::unordered_set<std::string_view> strings_;
+};
+
+}  // namespace wasmtoolbox
+
+#endif /* WASMTOOLBOX_STRING_INTERNER_H */
@@ -16,8 +16,21 @@
 
 #include "text_format.h"
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
 #include "absl/strings/str_format.h"
 
+#include "opcodes.h"
+
 namespace wasmtoolbox {
 
 // 6.2 Lexical Format
@@ -28,21 +41,21 @@ namespace wasmtoolbox {
 
 auto Text_format_writer::tok_keyword(std::string_view keyword) -> void {
   lex_maybe_ws();
-  *os_ << keyword;
+  out_->append(keyword);
   need_ws = true;
   just_closed_sexp = false;
 }
 
 auto Text_format_writer::tok_left_paren() -> void {
   lex_maybe_ws();
-  *os_ << "(";
+  out_->put('(');
   indent_level += 2;
   need_ws = false;
   just_closed_sexp = false;
 }
 
 auto Text_format_writer::tok_right_paren() -> void {
-  *os_ << ")";
+  out_->put(')');
   indent_level -= 2;
   need_ws = false;
   just_closed_sexp = true;
@@ -53,17 +66,15 @@ auto Text_format_writer::tok_right_paren() -> void {
 
 auto Text_format_writer::lex_maybe_ws() -> void {
   if (need_ws || just_closed_sexp) {
-    *os_ << " ";
+    out_->put(' ');
     need_ws = false;
     just_closed_sexp = false;
   }
 }
 
 auto Text_format_writer::lex_nl() -> void {
-  *os_ << "\n";
-  for (auto i = 0; i != indent_level; ++i) {
-    *os_ << ' ';
-  }
+  out_->put('\n');
+  out_->fill(' ', static_cast<size_t>(indent_level));
   need_ws = false;
   just_closed_sexp = false;
 }
@@ -73,11 +84,11 @@ auto Text_format_writer::lex_nl() -> void {
 
 auto Text_format_writer::lex_blockcomment(std::string_view comment) -> void {
   lex_maybe_ws();
-  *os_ << "(;";
+  out_->append("(;");
   // Assume doesn't contain an improperly nested closing ";)"
   // TODO: Check the above!
-  *os_ << comment;
-  *os_ << ";)";
+  out_->append(comment);
+  out_->append(";)");
   need_ws = true;
   just_closed_sexp = true;
 }
@@ -86,30 +97,137 @@ auto Text_format_writer::lex_blockcomment(std::string_view comment) -> void {
 // 6.3 Values
 // ==========
 
+// 6.3.1 Integers
+// --------------
+
+namespace {
+
+template<typename Int>
+auto append_int(Output_sink& out, Int n) -> void {
+  char digits[std::numeric_limits<Int>::digits10 + 2];  // sign included
+  auto [end, ec] = std::to_chars(std::begin(digits), std::end(digits), n);
+  out.append({digits, static_cast<size_t>(end - digits)});
+}
+
+}  // namespace
+
+auto Text_format_writer::tok_u32(uint32_t n) -> void {
+  lex_maybe_ws();
+  append_int(*out_, n);
+  need_ws = true;
+  just_closed_sexp = false;
+}
+
+auto Text_format_writer::tok_s64(int64_t n) -> void {
+  lex_maybe_ws();
+  append_int(*out_, n);
+  need_ws = true;
+  just_closed_sexp = false;
+}
+
+// 6.3.2 Floating-Point
+// --------------------
+
+namespace {
+
+// Hexadecimal floats are exact; NaNs keep their payload
+template<typename Float, typename Bits>
+auto format_float(Float z) -> std::string {
+  constexpr auto k_mantissa_bits = std::numeric_limits<Float>::digits - 1;
+  auto sign = std::signbit(z) ? "-" : "";
+  if (std::isnan(z)) {
+    auto payload = std::bit_cast<Bits>(z) & ((Bits{1} << k_mantissa_bits) - 1);
+    return absl::StrFormat("%snan:0x%x", sign, payload);
+  }
+  if (std::isinf(z)) {
+    return absl::StrFormat("%sinf", sign);
+  }
+  return absl::StrFormat("%a", z);
+}
+
+}  // namespace
+
+auto Text_format_writer::tok_f32(float z) -> void {
+  tok_keyword(format_float<float, uint32_t>(z));
+}
+
+auto Text_format_writer::tok_f64(double z) -> void {
+  tok_keyword(format_float<double, uint64_t>(z));
+}
+
 // 6.3.3 Strings
 // -------------
 
+namespace {
+
+constexpr auto k_hex_digits = std::string_view{"0123456789abcdef"};
+
+// How each byte appears in a string: as itself (size 0), or as an escape.  Not yet handling UTF-8 parsing:
+// instead, bytes outside 7-bit ASCII are written as \hh.
+struct String_escape {
+  char text[3];
+  uint8_t size;
+};
+
+constexpr auto k_string_escapes = [] {
+  auto table = std::array<String_escape, 256>{};
+  for (auto c = 0; c != 256; ++c) {
+    if (c < 0x20 || c >= 0x7f) {
+      table[c] = {{'\\', k_hex_digits[c >> 4], k_hex_digits[c & 0xf]}, 3};
+    }
+  }
+  table['\t'] = {{'\\', 't'}, 2};
+  table['\n'] = {{'\\', 'n'}, 2};
+  table['\r'] = {{'\\', 'r'}, 2};
+  table['\"'] = {{'\\', '"'}, 2};
+  table['\''] = {{'\\', '\''}, 2};
+  table['\\'] = {{'\\', '\\'}, 2};
+  return table;
+}();
+
+// The first byte in [p, end) that needs escaping, or end.  Strings are mostly printable ASCII, so with SSE2
+// (always there on x86-64), look at them 16 bytes at a time.
+auto find_string_escape(const char* p, const char* end) -> const char* {
+#if defined(__x86_64__)
+  auto space = _mm_set1_epi8(0x20);
+  auto del = _mm_set1_epi8(0x7f);
+  auto quote = _mm_set1_epi8('"');
+  auto apostrophe = _mm_set1_epi8('\'');
+  auto backslash = _mm_set1_epi8('\\');
+  while (end - p >= 16) {
+    auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    // Signed comparison: bytes >= 0x80 count as negative, so they're caught along with the control characters
+    auto escaped = _mm_or_si128(
+        _mm_or_si128(_mm_cmplt_epi8(chunk, space), _mm_cmpeq_epi8(chunk, del)),
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, apostrophe)),
+                     _mm_cmpeq_epi8(chunk, backslash)));
+    if (auto mask = static_cast<uint32_t>(_mm_movemask_epi8(escaped)); mask != 0) {
+      return p + std::countr_zero(mask);
+    }
+    p += 16;
+  }
+#endif
+  while (p != end && k_string_escapes[static_cast<uint8_t>(*p)].size == 0) { ++p; }
+  return p;
+}
+
+}  // namespace
+
+// Runs of bytes that can go as they are are copied in one go, with escapes in between
 auto Text_format_writer::tok_string(std::string_view str) -> void {
   lex_maybe_ws();
-  *os_ << '\"';
-  for (const auto& c : str) {
-    // Not yet handling UTF-8 parsing: instead, dump raw bytes outside 7-bit ASCII
-    switch (c) {
-      case '\t': *os_ << "\\t"; break;
-      case '\n': *os_ << "\\n"; break;
-      case '\r': *os_ << "\\r"; break;
-      case '\"': *os_ << "\\\""; break;
-      case '\'': *os_ << "\\'"; break;
-      case '\\': *os_ << "\\\\"; break;
-      default:
-        if (c >= 0x20 && c < 0x7F) {
-          *os_ << static_cast<char>(c);
-        } else {
-          *os_ << absl::StreamFormat("\\%02x", c);
-        }
-    }
+  out_->put('\"');
+  auto p = str.data();
+  auto end = p + str.size();
+  while (true) {
+    auto run_end = find_string_escape(p, end);
+    if (run_end != p) { out_->append({p, static_cast<size_t>(run_end - p)}); }
+    if (run_end == end) { break; }
+    const auto& escape = k_string_escapes[static_cast<uint8_t>(*run_end)];
+    out_->append({escape.text, escape.size});
+    p = run_end + 1;
   }
-  *os_ << '\"';
+  out_->put('\"');
   need_ws = true;
   just_closed_sexp = false;
 }
@@ -124,24 +242,81 @@ auto Text_format_writer::tok_name(std::string_view name) -> void {
 // 6.3.5 Identifiers
 // -----------------
 
-auto Text_format_writer::tok_id(std::string_view id) -> void {
-  if (id.empty()) {
-    throw std::logic_error("Invalid empty identifier");
+namespace {
+
+struct Char_set {
+  uint64_t bits[4]{};
+
+  constexpr auto add(uint8_t c) -> void { bits[c >> 6] |= uint64_t{1} << (c & 63); }
+  constexpr auto contains(uint8_t c) const -> bool { return (bits[c >> 6] >> (c & 63)) & 1; }
+};
+
+constexpr auto k_idchars = [] {
+  auto set = Char_set{};
+  for (auto c = '0'; c <= '9'; ++c) { set.add(c); }
+  for (auto c = 'A'; c <= 'Z'; ++c) { set.add(c); }
+  for (auto c = 'a'; c <= 'z'; ++c) { set.add(c); }
+  for (auto c : std::string_view{"!#$%&\'*+-./:<=>?@\\^_`|~"}) { set.add(c); }
+  return set;
+}();
+
+// The first byte in [p, end) that isn't an idchar (or is a \, with sanitize_ids), or end.  The idchars are
+// the printable ASCII characters but for nine punctuation characters, so with SSE2, that's checked 16 bytes at
+// a time with a comparison for the range and one for each exception.
+auto find_non_idchar(const char* p, const char* end, bool sanitize_ids) -> const char* {
+#if defined(__x86_64__)
+  auto exclamation = _mm_set1_epi8('!');
+  auto del = _mm_set1_epi8(0x7f);
+  auto backslash = _mm_set1_epi8(sanitize_ids ? '\\' : 0x7f);  // DEL is rejected anyway
+  while (end - p >= 16) {
+    auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    auto eq = [&](char c) { return _mm_cmpeq_epi8(chunk, _mm_set1_epi8(c)); };
+    // Signed comparison: bytes >= 0x80 count as negative, so they're caught along with space and below
+    auto outside = _mm_or_si128(_mm_cmplt_epi8(chunk, exclamation), _mm_cmpeq_epi8(chunk, del));
+    auto brackets = _mm_or_si128(_mm_or_si128(eq('('), eq(')')),
+                                 _mm_or_si128(_mm_or_si128(eq('['), eq(']')), _mm_or_si128(eq('{'), eq('}'))));
+    auto others = _mm_or_si128(_mm_or_si128(eq('"'), eq(',')),
+                               _mm_or_si128(eq(';'), _mm_cmpeq_epi8(chunk, backslash)));
+    auto invalid = _mm_or_si128(outside, _mm_or_si128(brackets, others));
+    if (auto mask = static_cast<uint32_t>(_mm_movemask_epi8(invalid)); mask != 0) {
+      return p + std::countr_zero(mask);
+    }
+    p += 16;
   }
-  
-  auto valid_puncts = std::string_view{"!#$%&\'*+-./:<=>?@\\^_`|~"};
-  for (auto c : id) {
-    auto is_digit = c >= '0' && c <= '9';
-    auto is_upper_alpha = c >= 'A' && c <= 'Z';
-    auto is_lower_alpha = c >= 'a' && c <= 'z';
-    auto is_valid_punct = valid_puncts.find(c) != std::string_view::npos;
-    if (not (is_digit || is_upper_alpha || is_lower_alpha || is_valid_punct)) {
-      throw std::logic_error(absl::StrFormat(
-          "Invalid idchar in id \"%s\": '%c'", id, c));
+#endif
+  while (p != end && k_idchars.contains(static_cast<uint8_t>(*p)) && not (sanitize_ids && *p == '\\')) { ++p; }
+  return p;
+}
+
+}  // namespace
+
+auto Text_format_writer::tok_id(std::string_view id) -> void {
+  auto end = id.data() + id.size();
+  auto bad = find_non_idchar(id.data(), end, options.sanitize_ids);
+  if (not options.sanitize_ids) {
+    if (id.empty()) {
+      throw std::logic_error("Invalid empty identifier");
+    }
+    if (bad != end) {
+      throw std::logic_error(absl::StrFormat("Invalid idchar in id \"%s\": '%c'", id, *bad));
     }
   }
+
   lex_maybe_ws();
-  *os_ << '$' << id;
+  out_->put('$');
+  if (id.empty()) {
+    out_->put('\\');
+  }
+  auto p = id.data();
+  while (true) {
+    if (bad != p) { out_->append({p, static_cast<size_t>(bad - p)}); }
+    if (bad == end) { break; }
+    auto c = static_cast<uint8_t>(*bad);
+    char escape[] = {'\\', k_hex_digits[c >> 4], k_hex_digits[c & 0xf]};
+    out_->append({escape, sizeof(escape)});
+    p = bad + 1;
+    bad = find_non_idchar(p, end, true);
+  }
   need_ws = true;
   just_closed_sexp = false;
 }
@@ -196,13 +371,13 @@ auto Text_format_writer::write_valtype(Ast_valtype valtype) -> void {
 // 6.4.5 Function Types
 // --------------------
 
-auto Text_format_writer::write_functype(const Ast_functype& functype) -> void {
+auto Text_format_writer::write_functype(Ast_functype functype) -> void {
   tok_left_paren();
   tok_keyword("func");
   if (not functype.params.empty()) {
     tok_left_paren();
     tok_keyword("param");
-    for (const auto& param : functype.params) {
+    for (auto param : functype.params) {
       write_valtype(param);
     }
     tok_right_paren();
@@ -210,7 +385,7 @@ auto Text_format_writer::write_functype(const Ast_functype& functype) -> void {
   if (not functype.results.empty()) {
     tok_left_paren();
     tok_keyword("result");
-    for (const auto& result : functype.results) {
+    for (auto result : functype.results) {
       write_valtype(result);
     }
     tok_right_paren();
@@ -219,13 +394,178 @@ auto Text_format_writer::write_functype(const Ast_functype& functype) -> void {
 }
 
 
+// 6.5 Instructions
+// ================
+
+auto Text_format_writer::write_instr(const Ast_func& func, const Ast_instr& instr) -> void {
+  auto kind = k_instr_imm_kinds[instr.opcode];
+  auto mnemonic = k_instr_mnemonics[instr.opcode];
+  auto natural_align = k_instr_natural_alignments[instr.opcode];
+  switch (instr.opcode) {
+    case k_instr_ext_prefix:
+      kind = k_ext_instr_imm_kinds[instr.subopcode];
+      mnemonic = k_ext_instr_mnemonics[instr.subopcode];
+      natural_align = k_ext_instr_natural_alignments[instr.subopcode];
+      break;
+    case k_instr_simd_prefix:
+      kind = k_simd_instr_imm_kinds[instr.subopcode];
+      mnemonic = k_simd_instr_mnemonics[instr.subopcode];
+      natural_align = k_simd_instr_natural_alignments[instr.subopcode];
+      break;
+    case k_instr_atomic_prefix:
+      kind = k_atomic_instr_imm_kinds[instr.subopcode];
+      mnemonic = k_atomic_instr_mnemonics[instr.subopcode];
+      natural_align = k_atomic_instr_natural_alignments[instr.subopcode];
+      break;
+    default:
+      break;
+  }
+  // Before writing anything, so that the output stops cleanly after the last instruction that could be written
+  if (kind == Imm_kind::k_invalid || kind == Imm_kind::k_prefix) {
+    throw std::logic_error(absl::StrFormat("Unrecognized instruction 0x%02x %d", instr.opcode, instr.subopcode));
+  }
+
+  // Blocks are indented; their else, catch and end line up with their opening instruction
+  if (instr.opcode == k_instr_else || instr.opcode == k_instr_catch || instr.opcode == k_instr_catch_all ||
+      instr.opcode == k_instr_end || instr.opcode == k_instr_delegate) {
+    indent_level -= 2;
+  }
+  lex_nl();
+  tok_keyword(mnemonic);
+
+  switch (kind) {
+    case Imm_kind::k_none:
+    case Imm_kind::k_zero_byte:
+    case Imm_kind::k_zero_bytes_2:
+      break;
+    case Imm_kind::k_block:
+      write_blocktype(instr.a);
+      indent_level += 2;
+      break;
+    case Imm_kind::k_structured:
+      if (instr.opcode == k_instr_catch || instr.opcode == k_instr_delegate) { tok_u32(instr.a); }
+      if (instr.opcode == k_instr_else || instr.opcode == k_instr_catch || instr.opcode == k_instr_catch_all) {
+        indent_level += 2;
+      }
+      break;
+    case Imm_kind::k_u32:
+    case Imm_kind::k_u32_zero_byte:
+      tok_u32(instr.a);
+      break;
+    case Imm_kind::k_u32_u32:
+      if (instr.opcode == k_instr_call_indirect) {
+        if (instr.b != 0) { tok_u32(instr.b); }
+        tok_left_paren();
+        tok_keyword("type");
+        tok_u32(instr.a);
+        tok_right_paren();
+      } else if (instr.opcode == k_instr_ext_prefix && instr.subopcode == k_ext_instr_table_init) {
+        tok_u32(instr.b);  // table.init tableidx elemidx, but the binary has elemidx first
+        tok_u32(instr.a);
+      } else {
+        tok_u32(instr.a);
+        tok_u32(instr.b);
+      }
+      break;
+    case Imm_kind::k_br_table:
+      for (auto j = instr.a; j != instr.a + instr.b; ++j) { tok_u32(func.br_table_labels[j]); }
+      break;
+    case Imm_kind::k_reftype:
+      tok_keyword(instr.a == k_reftype_funcref ? "func" : "extern");
+      break;
+    case Imm_kind::k_select_t:
+      if (instr.b != 0) {
+        tok_left_paren();
+        tok_keyword("result");
+        for (auto j = instr.a; j != instr.a + instr.b; ++j) {
+          write_valtype(static_cast<Ast_valtype>(func.br_table_labels[j]));
+        }
+        tok_right_paren();
+      }
+      break;
+    case Imm_kind::k_memarg:
+      write_memarg(natural_align, instr.a, instr.b);
+      break;
+    case Imm_kind::k_i32: tok_s64(static_cast<int32_t>(instr.a)); break;
+    case Imm_kind::k_i64: tok_s64(static_cast<int64_t>(instr.imm64())); break;
+    case Imm_kind::k_f32: tok_f32(std::bit_cast<float>(instr.a)); break;
+    case Imm_kind::k_f64: tok_f64(std::bit_cast<double>(instr.imm64())); break;
+    case Imm_kind::k_v128: write_v128_const(func.v128_imms[instr.a]); break;
+    case Imm_kind::k_shuffle:
+      for (auto laneidx : func.v128_imms[instr.a]) { tok_u32(laneidx); }
+      break;
+    case Imm_kind::k_lane: tok_u32(instr.lane); break;
+    case Imm_kind::k_memarg_lane:
+      write_memarg(natural_align, instr.a, instr.b);
+      tok_u32(instr.lane);
+      break;
+    case Imm_kind::k_invalid:
+    case Imm_kind::k_prefix:
+      break;  // rejected above
+  }
+}
+
+// 6.5.2 Control Instructions
+// --------------------------
+
+auto Text_format_writer::write_blocktype(uint32_t blocktype) -> void {
+  if (blocktype == k_blocktype_empty) { return; }
+  tok_left_paren();
+  if ((blocktype & k_blocktype_valtype) == k_blocktype_valtype) {
+    tok_keyword("result");
+    write_valtype(static_cast<Ast_valtype>(blocktype & 0xff));
+  } else {
+    tok_keyword("type");
+    tok_u32(blocktype);
+  }
+  tok_right_paren();
+}
+
+// 6.5.6 Memory Instructions
+// -------------------------
+
+auto Text_format_writer::write_memarg(uint32_t natural_align, uint32_t align, uint32_t offset) -> void {
+  // align is only spelled out if it isn't the natural one (see k_instr_natural_alignments)
+  if (offset != 0) { tok_keyword(absl::StrFormat("offset=%d", offset)); }
+  if (align != natural_align) {
+    if (align >= 64) {  // only a validated module is sure not to have one of these
+      throw std::logic_error(absl::StrFormat("Alignment 2^%d is too large to write", align));
+    }
+    tok_keyword(absl::StrFormat("align=%d", uint64_t{1} << align));
+  }
+}
+
+// [EXTRA] Vector Instructions (6.5.9 in the 2.0 spec)
+// ---------------------------------------------------
+
+auto Text_format_writer::write_v128_const(const Ast_v128& bytes) -> void {
+  // Any shape would do; like wabt, spell it out as four 32-bit words
+  tok_keyword("i32x4");
+  for (auto i = size_t{0}; i != bytes.size(); i += 4) {
+    auto word = uint32_t{bytes[i]} | uint32_t{bytes[i + 1]} << 8 | uint32_t{bytes[i + 2]} << 16 |
+        uint32_t{bytes[i + 3]} << 24;
+    tok_keyword(absl::StrFormat("0x%08x", word));
+  }
+}
+
+// 6.5.8 Expressions
+// -----------------
+
+auto Text_format_writer::write_expr(const Ast_func& func) -> void {
+  // The final end is implied by the closing parenthesis of the function
+  for (auto i = size_t{0}; i + 1 < func.body.size(); ++i) {
+    write_instr(func, func.body[i]);
+  }
+}
+
+
 // 6.6 Modules
 // ===========
 
 // 6.6.2 Types
 // -----------
 
-auto Text_format_writer::write_type(Ast_typeidx typeidx, const Ast_functype& functype) -> void {
+auto Text_format_writer::write_type(Ast_typeidx typeidx, Ast_functype functype) -> void {
   lex_nl();
   tok_left_paren();
   tok_keyword("type");
@@ -246,22 +586,81 @@ auto Text_format_writer::write_import(const Ast_import& import) -> void {
   tok_right_paren();
 }
 
+// 6.6.5 Functions
+// ---------------
+
+auto Text_format_writer::write_func(Ast_typeidx typeidx, const Ast_code& code) -> void {
+  lex_nl();
+  tok_left_paren();
+  tok_keyword("func");
+  tok_left_paren();
+  tok_keyword("type");
+  tok_u32(typeidx);
+  tok_right_paren();
+  if (not code.func.has_value()) {
+    lex_blockcomment(" not decoded ");  // lazy_function_bodies
+  } else {
+    if (not code.func->locals.empty()) {
+      lex_nl();
+      tok_left_paren();
+      tok_keyword("local");
+      for (const auto& locals : code.func->locals) {
+        for (auto i = uint32_t{0}; i != locals.n; ++i) {
+          write_valtype(locals.t);
+        }
+      }
+      tok_right_paren();
+    }
+    write_expr(*code.func);
+  }
+  tok_right_paren();
+}
+
 // 6.6.13 Modules
 // --------------
 
 auto Text_format_writer::write_module(const Ast_module& module) -> void {
+  write_module_start(module);
+  for (auto i = size_t{0}; i != num_module_fields(module); ++i) {
+    write_module_field(module, i);
+  }
+  write_module_end();
+}
+
+auto Text_format_writer::write_module_start(const Ast_module& module) -> void {
+  write_module_start(module.name);
+}
+
+auto Text_format_writer::write_module_start(std::optional<Ast_name> name) -> void {
   tok_left_paren();
   tok_keyword("module");
-  if (module.name.has_value()) {
-    tok_id(module.name.value());
+  if (name.has_value()) {
+    tok_id(name.value());
   }
-  for (auto typeidx = Ast_typeidx{0}; typeidx != std::ssize(module.types); ++typeidx) {
+}
+
+auto Text_format_writer::num_module_fields(const Ast_module& module) -> size_t {
+  return module.types.size() + module.imports.size() + std::min(module.codes.size(), module.func_types.size());
+}
+
+auto Text_format_writer::write_module_field(const Ast_module& module, size_t i) -> void {
+  if (i < module.types.size()) {
+    auto typeidx = static_cast<Ast_typeidx>(i);
     write_type(typeidx, module.types[typeidx]);
+    return;
   }
-  for (const auto& import : module.imports) {
-    write_import(import);
+  i -= module.types.size();
+  if (i < module.imports.size()) {
+    write_import(module.imports[i]);
+    return;
   }
+  i -= module.imports.size();
+  write_func(module.func_types[i], module.codes[i]);
+}
+
+auto Text_format_writer::write_module_end() -> void {
   tok_right_paren();
+  flush();
 }
 
 }  // namespace wasmtoolbox
@@ -17,9 +17,14 @@
 #ifndef WASMTOOLBOX_TEXT_FORMAT_H
 #define WASMTOOLBOX_TEXT_FORMAT_H
 
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <string_view>
 
 #include "ast.h"
+#include "output_sink.h"
 
 namespace wasmtoolbox {
 
@@ -34,10 +39,27 @@ namespace wasmtoolbox {
 // - Extended name section (1.0, Draft Jul 08, 2019):
 //     https://www.scheidecker.net/2019-07-08-extended-name-section-spec/appendix/custom.html
 
+//
+// Output is buffered (see Output_sink): it's only guaranteed to have reached its destination after flush(),
+// which write_module() does by itself.
+
+struct Text_format_options {
+  // [EXTRA] Write names that aren't valid identifiers (6.3.5) by escaping the offending bytes, instead of throwing
+  // std::logic_error: each one becomes \hh, as does every \ (so that different names stay different), and the
+  // empty name becomes a lone \.
+  bool sanitize_ids = false;
+};
+
 struct Text_format_writer {
-  std::ostream* os_;
-  
-  explicit Text_format_writer(std::ostream& os) : os_{&os} {}
+  std::unique_ptr<Output_sink> owned_out_{};  // when writing to a std::ostream
+  Output_sink* out_;
+  Text_format_options options{};
+
+  explicit Text_format_writer(Output_sink& out) : out_{&out} {}
+  explicit Text_format_writer(std::ostream& os)
+      : owned_out_{std::make_unique<Output_sink>(os)}, out_{owned_out_.get()} {}
+
+  auto flush() -> void { out_->flush(); }
 
   // 6.2 Lexical Format
   // ==================
@@ -60,6 +82,14 @@ struct Text_format_writer {
   // 6.3 Values
   // ==========
 
+  // 6.3.1 Integers
+  auto tok_u32(uint32_t n) -> void;
+  auto tok_s64(int64_t n) -> void;
+
+  // 6.3.2 Floating-Point
+  auto tok_f32(float z) -> void;
+  auto tok_f64(double z) -> void;
+
   // 6.3.3 Strings
   auto tok_string(std::string_view str) -> void;
   
@@ -85,19 +115,49 @@ struct Text_format_writer {
   auto write_valtype(Ast_valtype valtype) -> void;
   
   // 6.4.5 Function Types
-  auto write_functype(const Ast_functype& functype) -> void;
+  auto write_functype(Ast_functype functype) -> void;
   
+  // 6.5 Instructions
+  // ================
+
+  // Plain (not folded) instructions, one per line
+  auto write_instr(const Ast_func& func, const Ast_instr& instr) -> void;
+
+  // 6.5.2 Control Instructions
+  auto write_blocktype(uint32_t blocktype) -> void;
+
+  // 6.5.6 Memory Instructions
+  auto write_memarg(uint32_t natural_align, uint32_t align, uint32_t offset) -> void;
+
+  // [EXTRA] Vector Instructions
+  auto write_v128_const(const Ast_v128& bytes) -> void;
+
+  // 6.5.8 Expressions
+  auto write_expr(const Ast_func& func) -> void;
+
   // 6.6 Modules
   // ===========
 
   // 6.6.2 Types
-  auto write_type(Ast_typeidx typeidx, const Ast_functype& functype) -> void;
+  auto write_type(Ast_typeidx typeidx, Ast_functype functype) -> void;
 
   // 6.6.4 Imports
   auto write_import(const Ast_import& import) -> void;
+
+  // 6.6.5 Functions
+  auto write_func(Ast_typeidx typeidx, const Ast_code& code) -> void;
   
   // 6.6.13 Modules
   auto write_module(const Ast_module& module) -> void;
+
+  // write_module() in pieces, so that fields can be written separately (see write_module_in_parallel()).
+  // The fields are numbered in the order they're written: types, then imports, then functions.  Each one
+  // starts on a new line, so the writer state carried from one to the next is just indent_level.
+  auto write_module_start(const Ast_module& module) -> void;
+  auto write_module_start(std::optional<Ast_name> name) -> void;
+  static auto num_module_fields(const Ast_module& module) -> size_t;
+  auto write_module_field(const Ast_module& module, size_t i) -> void;
+  auto write_module_end() -> void;
 };
 
 }  // namespace wasmtoolbox
@@ -0,0 +1,636 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "validator.h"
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+
+#include "opcodes.h"
+#include "parser.h"
+
+namespace wasmtoolbox {
+
+namespace {
+
+// The stack effects in opcodes.h, parsed at compile time, plus what else needs checking for the instructions
+// that have one, so that they all take the same path through Func_validator::validate()
+struct Stack_effect {
+  bool fixed = false;  // false for "*": such instructions are validated case by case
+  bool uses_memory = false;
+  bool has_memarg = false;
+  uint8_t natural_alignment = 0;
+  uint8_t lane_count = 0;  // of instructions with lane immediates
+  uint8_t num_params = 0;
+  uint8_t num_results = 0;
+  std::array<Ast_valtype, 3> params{};
+  Ast_valtype result{};
+};
+
+constexpr auto valtype_of_letter(char c) -> Ast_valtype {
+  switch (c) {
+    case 'i': return k_numtype_i32;
+    case 'l': return k_numtype_i64;
+    case 'f': return k_numtype_f32;
+    case 'd': return k_numtype_f64;
+    case 'v': return k_vectype_v128;
+    default: throw "unknown type in stack effect";  // fails to compile
+  }
+}
+
+constexpr auto parse_stack_effect(std::string_view effect) -> Stack_effect {
+  auto result = Stack_effect{};
+  if (effect.empty() || effect == "*") { return result; }
+  auto colon = effect.find(':');
+  if (colon == effect.npos) { throw "stack effect without a colon"; }
+  auto params = effect.substr(0, colon);
+  auto results = effect.substr(colon + 1);
+  if (params.size() > result.params.size() || results.size() > 1) { throw "stack effect too long"; }
+
+  result.fixed = true;
+  result.num_params = static_cast<uint8_t>(params.size());
+  for (auto i = size_t{0}; i != params.size(); ++i) { result.params[i] = valtype_of_letter(params[i]); }
+  result.num_results = static_cast<uint8_t>(results.size());
+  if (not results.empty()) { result.result = valtype_of_letter(results[0]); }
+  return result;
+}
+
+constexpr auto parse_stack_effects(std::array<std::string_view, 256> effects) {
+  auto result = std::array<Stack_effect, 256>{};
+  for (auto i = size_t{0}; i != effects.size(); ++i) { result[i] = parse_stack_effect(effects[i]); }
+  return result;
+}
+
+constexpr auto parse_stack_effects(std::array<std::string_view, 256> effects, std::array<Imm_kind, 256> imm_kinds,
+                                   std::array<uint8_t, 256> natural_alignments) {
+  auto result = parse_stack_effects(effects);
+  for (auto i = size_t{0}; i != result.size(); ++i) {
+    if (imm_kinds[i] == Imm_kind::k_memarg || imm_kinds[i] == Imm_kind::k_memarg_lane) {
+      result[i].uses_memory = result[i].has_memarg = true;
+      result[i].natural_alignment = natural_alignments[i];
+    }
+  }
+  return result;
+}
+
+constexpr auto k_instr_effects = [] {
+  auto result = parse_stack_effects(k_instr_stack_effects, k_instr_imm_kinds, k_instr_natural_alignments);
+  result[k_instr_memory_size].uses_memory = true;
+  result[k_instr_memory_grow].uses_memory = true;
+  return result;
+}();
+constexpr auto k_ext_instr_effects = parse_stack_effects(k_ext_instr_stack_effects);
+constexpr auto k_simd_instr_effects = [] {
+  auto result = parse_stack_effects(k_simd_instr_stack_effects, k_simd_instr_imm_kinds,
+                                    k_simd_instr_natural_alignments);
+  for (auto i = size_t{0}; i != result.size(); ++i) { result[i].lane_count = k_simd_instr_lane_counts[i]; }
+  return result;
+}();
+constexpr auto k_atomic_instr_effects = parse_stack_effects(k_atomic_instr_stack_effects);
+
+// Backs the result types of blocks with a single valtype as their blocktype
+constexpr Ast_valtype k_single_valtypes[] = {
+  k_numtype_i32, k_numtype_i64, k_numtype_f32, k_numtype_f64, k_vectype_v128, k_reftype_funcref, k_reftype_externref
+};
+
+constexpr auto is_reftype(uint8_t t) -> bool { return t == k_reftype_funcref || t == k_reftype_externref; }
+
+}  // namespace
+
+// Module and function setup
+// -------------------------
+
+auto Func_validator::begin_module(const Ast_module& module) -> void {
+  types_ = &module.types;
+  func_types_ = module.func_types;
+  funcs_.clear();
+  tables_.clear();
+  num_mems_ = 0;
+  globals_.clear();
+  tags_.clear();
+
+  // Imports come first in every index space
+  for (const auto& import : module.imports) {
+    const auto& desc = import.desc;
+    switch (desc.kind) {
+      case Ast_externkind::k_func: funcs_.push_back(desc.typeidx); break;
+      case Ast_externkind::k_table: tables_.push_back(desc.table.et); break;
+      case Ast_externkind::k_mem: ++num_mems_; break;
+      case Ast_externkind::k_global: globals_.push_back(desc.global); break;
+      case Ast_externkind::k_tag: tags_.push_back(desc.typeidx); break;
+    }
+  }
+  funcs_.insert(funcs_.end(), module.func_types.begin(), module.func_types.end());
+  for (const auto& table : module.tables) { tables_.push_back(table.et); }
+  num_mems_ += static_cast<uint32_t>(module.mems.size());
+  for (const auto& global : module.globals) { globals_.push_back(global.type); }
+  for (const auto& tag : module.tags) { tags_.push_back(tag.type); }
+  elems_.clear();
+  for (const auto& elem : module.elems) { elems_.push_back(elem.type); }
+  data_count_ = module.data_count;
+}
+
+auto Func_validator::begin_func(uint32_t i, std::span<const Ast_locals> locals) -> bool {
+  ok_ = true;
+  if (i >= func_types_.size()) {
+    fail(Parse_error_code::k_func_count_mismatch, static_cast<int64_t>(func_types_.size()), int64_t{i} + 1);
+    return false;
+  }
+  auto type = functype(func_types_[i]);
+  if (not ok_) { return false; }
+
+  locals_.clear();
+  auto n = uint64_t{0};
+  for (auto t : type.params) { locals_.push_back(Local_run{.end = ++n, .t = t}); }
+  for (auto [count, t] : locals) {
+    n += count;
+    locals_.push_back(Local_run{.end = n, .t = t});
+  }
+  if (n > uint64_t{0xffffffff}) {
+    fail(Parse_error_code::k_too_many_locals);
+    return false;
+  }
+
+  // The body is a block whose label is the function's results
+  vals_.clear();
+  ctrls_.clear();
+  push_ctrl(k_instr_block, {}, type.results);
+  return true;
+}
+
+auto Func_validator::fail(Parse_error_code code, int64_t arg0, int64_t arg1) -> void {
+  if (not ok_) { return; }
+  ok_ = false;
+  error_code = code;
+  error_args[0] = arg0;
+  error_args[1] = arg1;
+  error_args[2] = 0;
+}
+
+// A.3 Validation Algorithm: operand and control stacks
+// ----------------------------------------------------
+
+auto Func_validator::pop_val() -> uint8_t {
+  const auto& frame = ctrls_.back();
+  if (vals_.size() == frame.height) {
+    if (not frame.unreachable) { fail(Parse_error_code::k_type_mismatch, -1, -1); }
+    return k_unknown;
+  }
+  auto actual = vals_.back();
+  vals_.pop_back();
+  return actual;
+}
+
+auto Func_validator::pop_val(uint8_t expected) -> uint8_t {
+  const auto& frame = ctrls_.back();
+  if (vals_.size() == frame.height) {
+    if (not frame.unreachable) {
+      fail(Parse_error_code::k_type_mismatch, expected == k_unknown ? -1 : int64_t{expected}, -1);
+    }
+    return k_unknown;
+  }
+  auto actual = vals_.back();
+  vals_.pop_back();
+  if (actual != expected && actual != k_unknown && expected != k_unknown) {
+    fail(Parse_error_code::k_type_mismatch, expected, actual);
+  }
+  return actual;
+}
+
+auto Func_validator::push_vals(std::span<const Ast_valtype> types) -> void {
+  vals_.insert(vals_.end(), types.begin(), types.end());
+}
+
+auto Func_validator::pop_vals(std::span<const Ast_valtype> types) -> void {
+  for (auto j = types.size(); j-- != 0;) { pop_val(types[j]); }
+}
+
+auto Func_validator::push_ctrl(uint8_t opcode, std::span<const Ast_valtype> in, std::span<const Ast_valtype> out)
+    -> void {
+  ctrls_.push_back(Ctrl_frame{
+    .start_types = in,
+    .end_types = out,
+    .height = static_cast<uint32_t>(vals_.size()),
+    .opcode = opcode,
+    .unreachable = false});
+  push_vals(in);
+}
+
+auto Func_validator::pop_ctrl() -> Ctrl_frame {
+  auto frame = ctrls_.back();
+  pop_vals(frame.end_types);
+  if (vals_.size() != frame.height) {
+    fail(Parse_error_code::k_unused_values, static_cast<int64_t>(vals_.size() - frame.height));
+  }
+  ctrls_.pop_back();
+  return frame;
+}
+
+auto Func_validator::label_types(const Ctrl_frame& frame) const -> std::span<const Ast_valtype> {
+  return frame.opcode == k_instr_loop ? frame.start_types : frame.end_types;
+}
+
+auto Func_validator::unreachable() -> void {
+  vals_.resize(ctrls_.back().height);
+  ctrls_.back().unreachable = true;
+}
+
+// Immediates
+// ----------
+
+auto Func_validator::blocktype(uint32_t blocktype) -> Ast_functype {
+  if (blocktype == k_blocktype_empty) { return {}; }
+  if ((blocktype & k_blocktype_valtype) == k_blocktype_valtype) {
+    return {{}, std::span{k_single_valtypes}.subspan(blocktype & 0xff, 1)};
+  }
+  return functype(blocktype);
+}
+
+auto Func_validator::functype(Ast_typeidx x) -> Ast_functype {
+  if (not check_index(Ast_index_space::k_type, x, types_->size())) { return {}; }
+  return (*types_)[x];
+}
+
+auto Func_validator::label(Ast_labelidx l) -> const Ctrl_frame* {
+  if (not check_index(Ast_index_space::k_label, l, ctrls_.size())) { return nullptr; }
+  return &ctrls_[ctrls_.size() - 1 - l];
+}
+
+auto Func_validator::local(Ast_localidx x) -> uint8_t {
+  auto it = std::upper_bound(locals_.begin(), locals_.end(), uint64_t{x},
+                             [](uint64_t x, const Local_run& run) { return x < run.end; });
+  if (it == locals_.end()) {
+    fail(Parse_error_code::k_unknown_index, static_cast<int64_t>(Ast_index_space::k_local), x);
+    return k_unknown;
+  }
+  return it->t;
+}
+
+auto Func_validator::check_index(Ast_index_space space, uint32_t idx, size_t size) -> bool {
+  if (idx < size) { return true; }
+  fail(Parse_error_code::k_unknown_index, static_cast<int64_t>(space), idx);
+  return false;
+}
+
+// 3.3.7 Memory Instructions: the alignment may not exceed the natural one (and must equal it for atomics)
+auto Func_validator::check_memarg(uint32_t align, uint8_t natural, bool exact) -> void {
+  check_index(Ast_index_space::k_mem, 0, num_mems_);
+  if (align > natural || (exact && align != natural)) {
+    fail(Parse_error_code::k_invalid_alignment, align, natural);
+  }
+}
+
+// 3.3.3 Vector Instructions: lane indices must be less than the number of lanes they pick from
+auto Func_validator::check_lanes(const Ast_func& func, const Ast_instr& instr, uint8_t count) -> void {
+  if (k_simd_instr_imm_kinds[instr.subopcode] == Imm_kind::k_shuffle) {
+    for (auto laneidx : func.v128_imms[instr.a]) {
+      if (laneidx >= count) {
+        fail(Parse_error_code::k_invalid_lane_index, laneidx, count);
+        return;
+      }
+    }
+  } else if (instr.lane >= count) {
+    fail(Parse_error_code::k_invalid_lane_index, instr.lane, count);
+  }
+}
+
+auto Func_validator::check_data_count(Ast_dataidx x) -> void {
+  if (not data_count_.has_value()) {
+    fail(Parse_error_code::k_missing_data_count);
+    return;
+  }
+  check_index(Ast_index_space::k_data, x, *data_count_);
+}
+
+// 3.3 Instructions
+// ----------------
+
+auto Func_validator::validate(const Ast_func& func, uint32_t i) -> bool {
+  const auto& instr = func.body[i];
+  const auto* effect = &k_instr_effects[instr.opcode];
+  if (effect->uses_memory) {
+    if (effect->has_memarg) {
+      check_memarg(instr.a, effect->natural_alignment, false);
+    } else {
+      check_index(Ast_index_space::k_mem, 0, num_mems_);
+    }
+  } else if (not effect->fixed) {
+    switch (instr.opcode) {
+      case k_instr_ext_prefix:
+        effect = &k_ext_instr_effects[instr.subopcode];
+        validate_ext(instr);
+        break;
+      case k_instr_simd_prefix:
+        effect = &k_simd_instr_effects[instr.subopcode];
+        if (effect->has_memarg) { check_memarg(instr.a, effect->natural_alignment, false); }
+        if (effect->lane_count != 0) { check_lanes(func, instr, effect->lane_count); }
+        break;
+      case k_instr_atomic_prefix:
+        effect = &k_atomic_instr_effects[instr.subopcode];
+        if (instr.subopcode != k_atomic_instr_atomic_fence) {
+          check_memarg(instr.a, k_atomic_instr_natural_alignments[instr.subopcode], true);
+        }
+        break;
+      default:
+        validate_control(func, instr);
+        return ok_;
+    }
+  }
+
+  // Most instructions (all the numeric ones, loads and stores, ...) only need this
+  if (effect->fixed) {
+    auto n = effect->num_params;
+    if (vals_.size() - ctrls_.back().height >= n) {
+      // Fast path: all the operands are in the current block
+      auto operands = vals_.data() + vals_.size() - n;
+      for (auto j = 0; j != n; ++j) {
+        if (operands[j] != effect->params[j] && operands[j] != k_unknown) {
+          fail(Parse_error_code::k_type_mismatch, effect->params[j], operands[j]);
+        }
+      }
+      vals_.resize(vals_.size() - n);
+    } else {
+      for (auto j = n; j-- != 0;) { pop_val(effect->params[j]); }
+    }
+    if (effect->num_results != 0) { push_val(effect->result); }
+  }
+  return ok_;
+}
+
+// Instructions whose stack effect depends on their immediates or their context
+auto Func_validator::validate_control(const Ast_func& func, const Ast_instr& instr) -> void {
+  switch (instr.opcode) {
+    // 3.3.8 Control Instructions (and the ones from the Exception Handling spec)
+    case k_instr_unreachable:
+      unreachable();
+      break;
+    case k_instr_block:
+    case k_instr_loop:
+    case k_instr_try: {
+      auto type = blocktype(instr.a);
+      pop_vals(type.params);
+      push_ctrl(instr.opcode, type.params, type.results);
+      break;
+    }
+    case k_instr_if: {
+      auto type = blocktype(instr.a);
+      pop_val(k_numtype_i32);
+      pop_vals(type.params);
+      push_ctrl(instr.opcode, type.params, type.results);
+      break;
+    }
+    case k_instr_else: {
+      auto frame = pop_ctrl();
+      push_ctrl(instr.opcode, frame.start_types, frame.end_types);
+      break;
+    }
+    case k_instr_catch: {
+      auto frame = pop_ctrl();
+      auto params = Ast_resulttype{};
+      if (check_index(Ast_index_space::k_tag, instr.a, tags_.size())) { params = functype(tags_[instr.a]).params; }
+      push_ctrl(instr.opcode, params, frame.end_types);
+      break;
+    }
+    case k_instr_catch_all: {
+      auto frame = pop_ctrl();
+      push_ctrl(instr.opcode, {}, frame.end_types);
+      break;
+    }
+    case k_instr_delegate: {
+      auto frame = pop_ctrl();
+      label(instr.a);  // counted from the block around the try
+      push_vals(frame.end_types);
+      break;
+    }
+    case k_instr_end: {
+      auto frame = pop_ctrl();
+      if (frame.opcode == k_instr_if) {
+        // No else: it's as if it were there and empty, so the if's results must be its params
+        push_ctrl(k_instr_else, frame.start_types, frame.end_types);
+        frame = pop_ctrl();
+      }
+      push_vals(frame.end_types);
+      break;
+    }
+    case k_instr_br:
+      if (const auto* frame = label(instr.a)) { pop_vals(label_types(*frame)); }
+      unreachable();
+      break;
+    case k_instr_br_if:
+      pop_val(k_numtype_i32);
+      if (const auto* frame = label(instr.a)) {
+        auto types = label_types(*frame);
+        pop_vals(types);
+        push_vals(types);
+      }
+      break;
+    case k_instr_br_table: {
+      pop_val(k_numtype_i32);
+      auto labels = std::span{func.br_table_labels}.subspan(instr.a, instr.b);
+      const auto* default_frame = label(labels.back());
+      if (default_frame == nullptr) { break; }
+      auto arity = label_types(*default_frame).size();
+      for (auto l : labels) {
+        const auto* frame = label(l);
+        if (frame == nullptr) { break; }
+        auto types = label_types(*frame);
+        if (types.size() != arity) {
+          fail(Parse_error_code::k_label_arity_mismatch, static_cast<int64_t>(arity),
+               static_cast<int64_t>(types.size()));
+          break;
+        }
+        // Check the operands against this label's types, without consuming them
+        scratch_vals_.clear();
+        for (auto j = types.size(); j-- != 0;) { scratch_vals_.push_back(pop_val(types[j])); }
+        for (auto j = scratch_vals_.size(); j-- != 0;) { push_val(scratch_vals_[j]); }
+      }
+      pop_vals(label_types(*default_frame));
+      unreachable();
+      break;
+    }
+    case k_instr_return:
+      pop_vals(ctrls_.front().end_types);
+      unreachable();
+      break;
+    case k_instr_call:
+      if (check_index(Ast_index_space::k_func, instr.a, funcs_.size())) {
+        auto type = functype(funcs_[instr.a]);
+        pop_vals(type.params);
+        push_vals(type.results);
+      }
+      break;
+    case k_instr_call_indirect: {
+      if (check_index(Ast_index_space::k_table, instr.b, tables_.size()) &&
+          tables_[instr.b] != k_reftype_funcref) {
+        fail(Parse_error_code::k_type_mismatch, k_reftype_funcref, tables_[instr.b]);
+      }
+      auto type = functype(instr.a);
+      pop_val(k_numtype_i32);
+      pop_vals(type.params);
+      push_vals(type.results);
+      break;
+    }
+    case k_instr_throw:
+      if (check_index(Ast_index_space::k_tag, instr.a, tags_.size())) { pop_vals(functype(tags_[instr.a]).params); }
+      unreachable();
+      break;
+    case k_instr_rethrow:
+      if (const auto* frame = label(instr.a)) {
+        if (frame->opcode != k_instr_catch && frame->opcode != k_instr_catch_all) {
+          fail(Parse_error_code::k_invalid_rethrow, instr.a);
+        }
+      }
+      unreachable();
+      break;
+
+    // 3.3.2 Reference Instructions
+    case k_instr_ref_null:
+      push_val(static_cast<uint8_t>(instr.a));
+      break;
+    case k_instr_ref_is_null: {
+      auto t = pop_val();
+      if (t != k_unknown && not is_reftype(t)) { fail(Parse_error_code::k_type_mismatch, k_reftype_funcref, t); }
+      push_val(k_numtype_i32);
+      break;
+    }
+    case k_instr_ref_func:
+      check_index(Ast_index_space::k_func, instr.a, funcs_.size());
+      push_val(k_reftype_funcref);
+      break;
+
+    // 3.3.4 Parametric Instructions
+    case k_instr_drop:
+      pop_val();
+      break;
+    case k_instr_select: {
+      pop_val(k_numtype_i32);
+      auto t1 = pop_val();
+      auto t2 = pop_val();
+      for (auto t : {t1, t2}) {
+        if (is_reftype(t)) { fail(Parse_error_code::k_untyped_select_of_reftype, t); }
+      }
+      if (t1 != t2 && t1 != k_unknown && t2 != k_unknown) { fail(Parse_error_code::k_type_mismatch, t1, t2); }
+      push_val(t1 == k_unknown ? t2 : t1);
+      break;
+    }
+    case k_instr_select_t: {
+      if (instr.b != 1) {
+        fail(Parse_error_code::k_invalid_select_arity, instr.b);
+        break;
+      }
+      auto t = static_cast<uint8_t>(func.br_table_labels[instr.a]);
+      pop_val(k_numtype_i32);
+      pop_val(t);
+      pop_val(t);
+      push_val(t);
+      break;
+    }
+
+    // 3.3.5 Variable Instructions
+    case k_instr_local_get:
+      push_val(local(instr.a));
+      break;
+    case k_instr_local_set:
+      pop_val(local(instr.a));
+      break;
+    case k_instr_local_tee: {
+      auto t = local(instr.a);
+      pop_val(t);
+      push_val(t);
+      break;
+    }
+    case k_instr_global_get:
+      push_val(check_index(Ast_index_space::k_global, instr.a, globals_.size()) ? uint8_t{globals_[instr.a].t} : k_unknown);
+      break;
+    case k_instr_global_set:
+      if (check_index(Ast_index_space::k_global, instr.a, globals_.size())) {
+        if (globals_[instr.a].mut != Ast_mut::k_var) { fail(Parse_error_code::k_immutable_global, instr.a); }
+        pop_val(globals_[instr.a].t);
+      }
+      break;
+
+    // 3.3.6 Table Instructions
+    case k_instr_table_get:
+      if (check_index(Ast_index_space::k_table, instr.a, tables_.size())) {
+        pop_val(k_numtype_i32);
+        push_val(tables_[instr.a]);
+      }
+      break;
+    case k_instr_table_set:
+      if (check_index(Ast_index_space::k_table, instr.a, tables_.size())) {
+        pop_val(tables_[instr.a]);
+        pop_val(k_numtype_i32);
+      }
+      break;
+
+    default:
+      break;  // every other instruction has a fixed stack effect
+  }
+}
+
+// Instructions after the 0xfc prefix: the stack effects are mostly fixed, but the indices need checking
+auto Func_validator::validate_ext(const Ast_instr& instr) -> void {
+  switch (instr.subopcode) {
+    case k_ext_instr_memory_init:
+      check_index(Ast_index_space::k_mem, 0, num_mems_);
+      check_data_count(instr.a);
+      break;
+    case k_ext_instr_data_drop:
+      check_data_count(instr.a);
+      break;
+    case k_ext_instr_memory_copy:
+    case k_ext_instr_memory_fill:
+      check_index(Ast_index_space::k_mem, 0, num_mems_);
+      break;
+    case k_ext_instr_table_init:  // a = elemidx, b = tableidx
+      if (check_index(Ast_index_space::k_elem, instr.a, elems_.size()) &&
+          check_index(Ast_index_space::k_table, instr.b, tables_.size()) && elems_[instr.a] != tables_[instr.b]) {
+        fail(Parse_error_code::k_type_mismatch, tables_[instr.b], elems_[instr.a]);
+      }
+      break;
+    case k_ext_instr_elem_drop:
+      check_index(Ast_index_space::k_elem, instr.a, elems_.size());
+      break;
+    case k_ext_instr_table_copy:  // a = destination, b = source
+      if (check_index(Ast_index_space::k_table, instr.a, tables_.size()) &&
+          check_index(Ast_index_space::k_table, instr.b, tables_.size()) && tables_[instr.a] != tables_[instr.b]) {
+        fail(Parse_error_code::k_type_mismatch, tables_[instr.a], tables_[instr.b]);
+      }
+      break;
+    case k_ext_instr_table_size:
+      check_index(Ast_index_space::k_table, instr.a, tables_.size());
+      break;
+    case k_ext_instr_table_grow:
+      if (check_index(Ast_index_space::k_table, instr.a, tables_.size())) {
+        pop_val(k_numtype_i32);
+        pop_val(tables_[instr.a]);
+        push_val(k_numtype_i32);
+      }
+      break;
+    case k_ext_instr_table_fill:
+      if (check_index(Ast_index_space::k_table, instr.a, tables_.size())) {
+        pop_val(k_numtype_i32);
+        pop_val(tables_[instr.a]);
+        pop_val(k_numtype_i32);
+      }
+      break;
+    default:
+      break;  // non-trapping float-to-int conversions
+  }
+}
+
+}  // namespace wasmtoolbox
@@ -0,0 +1,121 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WASMTOOLBOX_VALIDATOR_H
+#define WASMTOOLBOX_VALIDATOR_H
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "ast.h"
+
+namespace wasmtoolbox {
+
+enum class Parse_error_code : uint8_t;  // see parser.h
+
+// 3.3 Instructions
+// ================
+//
+// Validates function bodies one instruction at a time, as the parser decodes them (see
+// Parse_options::validate), with the algorithm in the spec's appendix (A.3 Validation Algorithm): an operand
+// stack of value types and a stack of control frames, one per open block.
+//
+// Both stacks are flat vectors of small records (types are single bytes), reused from one function to the next,
+// so validation allocates nothing per instruction.  Instructions without immediates that matter to their types
+// take their stack effect from the tables in opcodes.h.
+//
+// Not checked yet: that ref.func only names functions declared in elements or exports, and the shared flag of
+// the memory used by atomic instructions.
+class Func_validator {
+ public:
+  // The index spaces (functions, tables, globals, ...) of `module`, which must outlive the validator's use.
+  // Only the sections before the code section are looked at.
+  auto begin_module(const Ast_module& module) -> void;
+
+  // Starts on the i-th function defined (not imported) in the module, now that its locals are known
+  auto begin_func(uint32_t i, std::span<const Ast_locals> locals) -> bool;
+
+  // Checks func.body[i], the instruction just decoded.  Returns false if it's invalid (see error_code).
+  auto validate(const Ast_func& func, uint32_t i) -> bool;
+
+  // What went wrong in the last failed call, with args as in Parse_error
+  Parse_error_code error_code{};
+  int64_t error_args[3]{};
+
+ private:
+  static constexpr auto k_unknown = uint8_t{0xff};  // a value of any type, in unreachable code
+
+  struct Ctrl_frame {
+    std::span<const Ast_valtype> start_types;
+    std::span<const Ast_valtype> end_types;
+    uint32_t height;  // of the operand stack when the block started
+    uint8_t opcode;
+    bool unreachable;
+  };
+
+  struct Local_run {
+    uint64_t end;  // one past the last localidx of the run
+    Ast_valtype t;
+  };
+
+  auto fail(Parse_error_code code, int64_t arg0 = 0, int64_t arg1 = 0) -> void;
+
+  auto push_val(uint8_t t) -> void { vals_.push_back(t); }
+  auto pop_val() -> uint8_t;
+  auto pop_val(uint8_t expected) -> uint8_t;
+  auto push_vals(std::span<const Ast_valtype> types) -> void;
+  auto pop_vals(std::span<const Ast_valtype> types) -> void;
+  auto push_ctrl(uint8_t opcode, std::span<const Ast_valtype> in, std::span<const Ast_valtype> out) -> void;
+  auto pop_ctrl() -> Ctrl_frame;
+  auto label_types(const Ctrl_frame& frame) const -> std::span<const Ast_valtype>;
+  auto unreachable() -> void;
+
+  auto blocktype(uint32_t blocktype) -> Ast_functype;
+  auto functype(Ast_typeidx x) -> Ast_functype;
+  auto label(Ast_labelidx l) -> const Ctrl_frame*;  // nullptr after reporting an unknown label
+  auto local(Ast_localidx x) -> uint8_t;
+  auto check_index(Ast_index_space space, uint32_t idx, size_t size) -> bool;
+  auto check_memarg(uint32_t align, uint8_t natural, bool exact) -> void;
+  auto check_lanes(const Ast_func& func, const Ast_instr& instr, uint8_t count) -> void;
+  auto check_data_count(Ast_dataidx x) -> void;
+
+  auto validate_control(const Ast_func& func, const Ast_instr& instr) -> void;
+  auto validate_ext(const Ast_instr& instr) -> void;
+
+  // Module
+  const Ast_type_table* types_ = nullptr;
+  std::span<const Ast_typeidx> func_types_{};  // of the functions defined in the module
+  std::vector<Ast_typeidx> funcs_{};           // type of every function, imports first
+  std::vector<Ast_reftype> tables_{};
+  uint32_t num_mems_ = 0;
+  std::vector<Ast_globaltype> globals_{};
+  std::vector<Ast_typeidx> tags_{};
+  std::vector<Ast_reftype> elems_{};
+  std::optional<uint32_t> data_count_{};
+
+  // Function
+  std::vector<Local_run> locals_{};  // params first
+  std::vector<uint8_t> vals_{};
+  std::vector<Ctrl_frame> ctrls_{};
+  std::vector<uint8_t> scratch_vals_{};
+  bool ok_ = true;
+};
+
+}  // namespace wasmtoolbox
+
+#endif /* WASMTOOLBOX_VALIDATOR_H */
@@ -0,0 +1,112 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "ast.h"
+#include "parser.h"
+#include "module_builder.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+// Count heap allocations across the whole test binary
+static auto g_num_allocations = std::atomic<long>{0};
+static auto g_num_deallocations = std::atomic<long>{0};
+
+auto operator new(size_t size) -> void* {
+  g_num_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto p = std::malloc(size != 0 ? size : 1)) { return p; }
+  throw std::bad_alloc{};
+}
+
+static auto counted_free(void* p) -> void {
+  if (p) { g_num_deallocations.fetch_add(1, std::memory_order_relaxed); }
+  std::free(p);
+}
+
+auto operator delete(void* p) noexcept -> void { counted_free(p); }
+auto operator delete(void* p, size_t /*size*/) noexcept -> void { counted_free(p); }
+
+// std::pmr::new_delete_resource() uses these
+auto operator new(size_t size, std::align_val_t align) -> void* {
+  g_num_allocations.fetch_add(1, std::memory_order_relaxed);
+  auto alignment = static_cast<size_t>(align);
+  if (auto p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)) { return p; }
+  throw std::bad_alloc{};
+}
+
+auto operator delete(void* p, std::align_val_t /*align*/) noexcept -> void { counted_free(p); }
+auto operator delete(void* p, size_t /*size*/, std::align_val_t /*align*/) noexcept -> void { counted_free(p); }
+
+namespace wasmtoolbox {
+
+static auto num_allocations_since(long start) -> long { return g_num_allocations.load() - start; }
+static auto num_deallocations_since(long start) -> long { return g_num_deallocations.load() - start; }
+
+TEST(ast_arena, few_allocations) {
+  // Without an arena, this takes an allocation per function (locals), per type (params, results), ...
+  auto bytes = sample_module(2000);
+  auto start = g_num_allocations.load();
+  auto module = std::optional{parse_wasm(std::span{bytes})};
+  EXPECT_THAT(num_allocations_since(start), testing::Lt(50));
+  EXPECT_THAT(module->codes.size(), testing::Eq(2000));
+
+  start = g_num_deallocations.load();
+  module.reset();
+  EXPECT_THAT(num_deallocations_since(start), testing::Lt(50));
+
+  // Ditto for streams, where names and data segments are copied into the arena
+  auto is = std::istringstream{std::string(bytes.begin(), bytes.end())};
+  start = g_num_allocations.load();
+  module.emplace(parse_wasm(is));
+  EXPECT_THAT(num_allocations_since(start), testing::Lt(50));
+  EXPECT_THAT(module->func_names.back().name, testing::Eq("func2000"));
+
+  // Ditto when the function bodies are decoded on several threads
+  start = g_num_allocations.load();
+  module.emplace(parse_wasm(std::span{bytes}, {.num_threads = 4}));
+  EXPECT_THAT(num_allocations_since(start), testing::Lt(100));
+  EXPECT_THAT(module->codes.back().func->locals.size(), testing::Eq(1));
+}
+
+TEST(ast_arena, move) {
+  // Moving a module hands its memory over along with the containers that use it, so the moved-to module
+  // doesn't depend on the moved-from one
+  static_assert(not std::is_move_assignable_v<Ast_module>);
+  auto bytes = sample_module(10);
+  auto module = std::optional<Ast_module>{};
+  {
+    auto is = std::istringstream{std::string(bytes.begin(), bytes.end())};
+    auto source = parse_wasm(is);
+    module.emplace(std::move(source));
+
+    // What's left of the source can still allocate, from memory of its own
+    auto* p = source.arena.allocate_bytes(16);
+    EXPECT_THAT(p, testing::NotNull());
+    EXPECT_NE(source.arena.resource(), module->arena.resource());
+  }
+  ASSERT_THAT(module->types.size(), testing::Eq(3));
+  EXPECT_THAT(module->types[2].params, testing::ElementsAre(k_numtype_i64, k_numtype_f64));
+  EXPECT_THAT(module->imports[0].module, testing::Eq("env"));
+  EXPECT_THAT(module->func_names[9].name, testing::Eq("func10"));
+  EXPECT_THAT(module->codes[9].func->locals[0].n, testing::Eq(2));
+}
+
+}  // namespace wasmtoolbox
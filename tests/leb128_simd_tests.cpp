@@ -0,0 +1,102 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "leb128_simd.h"
+
+#include <random>
+#include <vector>
+
+namespace wasmtoolbox {
+
+using Bulk_decoder = Leb128_bulk_result (*)(const uint8_t*, const uint8_t*, uint32_t*, size_t);
+
+static auto encode_u32(uint32_t value, std::vector<uint8_t>& out) -> void {
+  do {
+    auto b = static_cast<uint8_t>(value & 0x7f);
+    value >>= 7;
+    out.push_back(value != 0 ? b | 0x80 : b);
+  } while (value != 0);
+}
+
+static auto decoders() -> std::vector<std::pair<std::string, Bulk_decoder>> {
+  auto result = std::vector<std::pair<std::string, Bulk_decoder>>{
+    {"scalar", leb128_simd_internal::bulk_decode_u32_scalar},
+    {"dispatched", bulk_decode_u32}
+  };
+#if defined(__x86_64__)
+  result.emplace_back("sse2", leb128_simd_internal::bulk_decode_u32_sse2);
+  if (leb128_simd_internal::cpu_has_avx2()) {
+    result.emplace_back("avx2", leb128_simd_internal::bulk_decode_u32_avx2);
+  }
+#endif
+  return result;
+}
+
+TEST(leb128_simd, decodes_prefix) {
+  auto rng = std::mt19937{42};
+  for (auto small_percent : {100, 95, 50, 0}) {
+    // A vector with mostly single-byte numbers, the odd longer one thrown in
+    auto values = std::vector<uint32_t>{};
+    auto bytes = std::vector<uint8_t>{};
+    for (auto i = 0; i != 5000; ++i) {
+      auto small = std::uniform_int_distribution<int>{0, 99}(rng) < small_percent;
+      auto value = small ? static_cast<uint32_t>(rng() & 0x7f) : static_cast<uint32_t>(rng() >> (rng() % 32));
+      values.push_back(value);
+      encode_u32(value, bytes);
+    }
+
+    for (const auto& [name, decoder] : decoders()) {
+      for (auto count : {size_t{0}, size_t{1}, size_t{7}, size_t{33}, values.size()}) {
+        auto out = std::vector<uint32_t>(count, 0xdeadbeef);
+        auto [n, size] = decoder(bytes.data(), bytes.data() + bytes.size(), out.data(), count);
+        SCOPED_TRACE(name);
+
+        // Decodes everything but a short tail, which needs bounds checks on every byte
+        EXPECT_THAT(n, testing::Le(count));
+        if (count < values.size()) {
+          EXPECT_THAT(n, testing::Eq(count));
+        } else {
+          EXPECT_THAT(n, testing::Ge(count - 8));
+        }
+        EXPECT_THAT(std::vector(out.begin(), out.begin() + n),
+                    testing::ElementsAreArray(values.begin(), values.begin() + n));
+
+        auto expected_size = std::vector<uint8_t>{};
+        for (auto i = size_t{0}; i != n; ++i) { encode_u32(values[i], expected_size); }
+        EXPECT_THAT(size, testing::Eq(expected_size.size()));
+      }
+    }
+  }
+}
+
+TEST(leb128_simd, stops_at_invalid_encoding) {
+  auto bytes = std::vector<uint8_t>(40, 0x01);
+  bytes[20] = 0xff; bytes[21] = 0xff; bytes[22] = 0xff; bytes[23] = 0xff; bytes[24] = 0x1f;  // > u32
+  bytes.resize(bytes.size() + 32, 0x02);
+
+  for (const auto& [name, decoder] : decoders()) {
+    auto out = std::vector<uint32_t>(bytes.size());
+    auto [n, size] = decoder(bytes.data(), bytes.data() + bytes.size(), out.data(), out.size());
+    SCOPED_TRACE(name);
+    EXPECT_THAT(n, testing::Eq(20));
+    EXPECT_THAT(size, testing::Eq(20));
+  }
+}
+
+}  // namespace wasmtoolbox
@@ -0,0 +1,72 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "mapped_file.h"
+#include "parser.h"
+
+#include <fstream>
+
+namespace wasmtoolbox {
+
+static auto write_temp_file(const std::string& name, const std::vector<uint8_t>& bytes) -> std::string {
+  auto filename = testing::TempDir() + name;
+  auto os = std::ofstream{filename, std::ios::binary};
+  os.write(reinterpret_cast<const char*>(bytes.data()), std::ssize(bytes));
+  return filename;
+}
+
+TEST(mapped_file, maps_whole_file) {
+  auto bytes = std::vector<uint8_t>{
+    0x00, 0x61, 0x73, 0x6D,  // magic
+    0x01, 0x00, 0x00, 0x00   // version
+  };
+  auto filename = write_temp_file("mapped_file_whole.wasm", bytes);
+
+  auto mapped = Mapped_file::map(filename);
+  ASSERT_TRUE(mapped.has_value());
+  EXPECT_THAT(std::vector(mapped->bytes().begin(), mapped->bytes().end()), testing::ElementsAreArray(bytes));
+
+  auto module = parse_wasm(mapped->bytes());  // Should work!
+  EXPECT_THAT(module.name, testing::Eq(std::nullopt));
+}
+
+TEST(mapped_file, empty_file) {
+  auto filename = write_temp_file("mapped_file_empty.wasm", {});
+
+  auto mapped = Mapped_file::map(filename);
+  ASSERT_TRUE(mapped.has_value());
+  EXPECT_TRUE(mapped->bytes().empty());
+  EXPECT_THROW(parse_wasm(mapped->bytes()), std::logic_error);
+}
+
+TEST(mapped_file, missing_file) {
+  EXPECT_FALSE(Mapped_file::map(testing::TempDir() + "no_such_file.wasm").has_value());
+}
+
+TEST(mapped_file, move) {
+  auto filename = write_temp_file("mapped_file_move.wasm", {0x01, 0x02, 0x03});
+
+  auto mapped = Mapped_file::map(filename);
+  ASSERT_TRUE(mapped.has_value());
+  auto moved = std::move(*mapped);
+  EXPECT_TRUE(mapped->bytes().empty());
+  EXPECT_THAT(std::vector(moved.bytes().begin(), moved.bytes().end()), testing::ElementsAre(0x01, 0x02, 0x03));
+}
+
+}  // namespace wasmtoolbox
@@ -0,0 +1,168 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WASMTOOLBOX_TESTS_MODULE_BUILDER_H
+#define WASMTOOLBOX_TESTS_MODULE_BUILDER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parser.h"
+
+namespace wasmtoolbox {
+
+// Helpers to assemble binary modules in tests
+
+using Bytes = std::vector<uint8_t>;
+
+inline auto append_u32(Bytes& out, uint64_t value) -> void {
+  do {
+    auto b = static_cast<uint8_t>(value & 0x7f);
+    value >>= 7;
+    out.push_back(value != 0 ? b | 0x80 : b);
+  } while (value != 0);
+}
+
+inline auto append_s64(Bytes& out, int64_t value) -> void {
+  while (true) {
+    auto b = static_cast<uint8_t>(value & 0x7f);
+    value >>= 7;
+    auto done = (value == 0 && (b & 0x40) == 0) || (value == -1 && (b & 0x40) != 0);
+    out.push_back(done ? b : b | 0x80);
+    if (done) { break; }
+  }
+}
+
+inline auto append_name(Bytes& out, std::string_view name) -> void {
+  append_u32(out, name.size());
+  out.insert(out.end(), name.begin(), name.end());
+}
+
+inline auto append_bytes(Bytes& out, const Bytes& bytes) -> void {
+  out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+// Magic and version, followed by whatever sections get added
+class Module_builder {
+ public:
+  auto section(Section_id id, const Bytes& contents) -> Module_builder& {
+    bytes_.push_back(id);
+    append_u32(bytes_, contents.size());
+    append_bytes(bytes_, contents);
+    return *this;
+  }
+
+  // A vector-shaped section (most of them): the number of entries, then the entries themselves
+  auto vec_section(Section_id id, const std::vector<Bytes>& entries) -> Module_builder& {
+    auto contents = Bytes{};
+    append_u32(contents, entries.size());
+    for (const auto& entry : entries) { append_bytes(contents, entry); }
+    return section(id, contents);
+  }
+
+  auto bytes() const -> const Bytes& { return bytes_; }
+
+ private:
+  Bytes bytes_{0x00, 0x61, 0x73, 0x6D, 0x01, 0x00, 0x00, 0x00};
+};
+
+// A function body for the code section (size included)
+inline auto code_entry(const Bytes& locals_and_expr) -> Bytes {
+  auto result = Bytes{};
+  append_u32(result, locals_and_expr.size());
+  append_bytes(result, locals_and_expr);
+  return result;
+}
+
+// A module with a bit of everything, and num_funcs varied function bodies (about 35 bytes each)
+inline auto sample_module(uint32_t num_funcs) -> Bytes {
+  auto builder = Module_builder{};
+
+  auto name_contents = Bytes{};
+  append_name(name_contents, "name");
+  name_contents.push_back(k_name_subsection_module);
+  auto module_name = Bytes{};
+  append_name(module_name, "sample");
+  append_u32(name_contents, module_name.size());
+  append_bytes(name_contents, module_name);
+  name_contents.push_back(k_name_subsection_functions);
+  auto func_names = Bytes{};
+  append_u32(func_names, num_funcs);
+  for (auto i = uint32_t{1}; i <= num_funcs; ++i) {  // function 0 is the import
+    append_u32(func_names, i);
+    append_name(func_names, "func" + std::to_string(i));
+  }
+  append_u32(name_contents, func_names.size());
+  append_bytes(name_contents, func_names);
+  builder.section(k_section_custom, name_contents);
+
+  builder.vec_section(k_section_type, {
+      {0x60, 0x00, 0x00},                    // [] -> []
+      {0x60, 0x01, 0x7f, 0x01, 0x7f},        // [i32] -> [i32]
+      {0x60, 0x02, 0x7e, 0x7c, 0x01, 0x7d},  // [i64 f64] -> [f32]
+    });
+
+  auto import = Bytes{};
+  append_name(import, "env");
+  append_name(import, "log");
+  append_bytes(import, {0x00, 0x01});  // func, typeidx 1
+  builder.vec_section(k_section_import, {import});
+
+  auto funcsec = Bytes{};
+  append_u32(funcsec, num_funcs);
+  for (auto i = uint32_t{0}; i != num_funcs; ++i) { append_u32(funcsec, i % 3 == 1 ? 1 : 0); }
+  builder.section(k_section_function, funcsec);
+
+  builder.vec_section(k_section_memory, {{0x01, 0x01, 0x10}});                  // min 1, max 16
+  builder.vec_section(k_section_global, {{0x7f, 0x01, 0x41, 0x2a, 0x0b}});      // (mut i32) = 42
+  auto exp = Bytes{};
+  append_name(exp, "main");
+  append_bytes(exp, {0x00, 0x01});  // func 1
+  builder.vec_section(k_section_export, {exp});
+
+  auto entries = std::vector<Bytes>{};
+  for (auto i = uint32_t{0}; i != num_funcs; ++i) {
+    auto body = Bytes{0x01, 0x02, 0x7f};  // 2 locals of type i32
+    if (i % 3 == 1) {
+      // [i32] -> [i32]: a loop with a br_table, a call and some arithmetic
+      append_bytes(body, {0x02, 0x40, 0x03, 0x40, 0x20, 0x00, 0x0e, 0x02, 0x00, 0x01, 0x01, 0x0b, 0x0b});
+      append_bytes(body, {0x20, 0x00, 0x10, 0x00, 0x41});
+      append_s64(body, -static_cast<int64_t>(i) * 1000);
+      append_bytes(body, {0x6a, 0x23, 0x00, 0x6a});
+    } else {
+      // [] -> []: memory accesses and constants
+      append_bytes(body, {0x41, 0x00, 0x42});
+      append_s64(body, static_cast<int64_t>(i) << 20);
+      append_bytes(body, {0x37, 0x03, 0x08, 0x41, 0x04, 0x43, 0x00, 0x00, 0x80, 0x3f, 0x38, 0x02, 0x00});
+      append_bytes(body, {0x41, 0x01, 0x04, 0x40, 0x01, 0x05, 0x00, 0x0b});  // if (i32.const 1) nop else unreachable
+    }
+    body.push_back(0x0b);
+    entries.push_back(code_entry(body));
+  }
+  builder.vec_section(k_section_code, entries);
+
+  auto data = Bytes{0x00, 0x41, 0x10, 0x0b};  // active, offset 16
+  append_name(data, "hello, world");
+  builder.vec_section(k_section_data, {data});
+
+  return builder.bytes();
+}
+
+}  // namespace wasmtoolbox
+
+#endif /* WASMTOOLBOX_TESTS_MODULE_BUILDER_H */
@@ -0,0 +1,92 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "output_sink.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace wasmtoolbox {
+
+TEST(output_sink, buffers_until_full_or_flushed) {
+  auto os = std::ostringstream{};
+  {
+    auto out = Output_sink{os, 8};
+    out.append("abc");
+    out.put('d');
+    EXPECT_THAT(os.str(), testing::Eq(""));
+    out.append("efghij");  // doesn't fit, so "abcd" goes out first
+    EXPECT_THAT(os.str(), testing::Eq("abcd"));
+    out.flush();
+    EXPECT_THAT(os.str(), testing::Eq("abcdefghij"));
+
+    out.fill(' ', 20);  // more than the whole buffer, in pieces
+    out.append("0123456789abcdef");  // bigger than the buffer: goes straight out
+    out.append("xyz");
+    out.append(std::string_view{});  // null data
+    EXPECT_THAT(os.str(), testing::Eq("abcdefghij" + std::string(20, ' ') + "0123456789abcdef"));
+    EXPECT_TRUE(out.ok());
+  }
+  EXPECT_THAT(os.str(), testing::EndsWith("0123456789abcdefxyz"));  // flushed on destruction
+}
+
+TEST(output_sink, string) {
+  auto str = std::string{"> "};
+  {
+    auto out = Output_sink{str, 4};
+    out.append("hello");
+    out.put(',');
+    EXPECT_THAT(str, testing::Eq("> hello"));
+  }
+  EXPECT_THAT(str, testing::Eq("> hello,"));
+}
+
+TEST(output_sink, file_descriptor) {
+  auto filename = testing::TempDir() + "output_sink_test.txt";
+  auto fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  ASSERT_GE(fd, 0);
+  auto expected = std::string{};
+  {
+    auto out = Output_sink{fd, 64};
+    for (auto i = 0; i != 1000; ++i) {
+      auto line = std::to_string(i) + (i % 7 == 0 ? std::string(100, '.') : "") + "\n";
+      out.append(line);
+      expected += line;
+    }
+    out.flush();
+    EXPECT_TRUE(out.ok());
+  }
+  ::close(fd);
+
+  auto is = std::ifstream{filename, std::ios::binary};
+  auto contents = std::string{std::istreambuf_iterator<char>{is}, {}};
+  EXPECT_THAT(contents, testing::Eq(expected));
+
+  // Errors stick
+  auto bad = Output_sink{-2};
+  bad.append("lost");
+  bad.flush();
+  EXPECT_FALSE(bad.ok());
+}
+
+}  // namespace wasmtoolbox
@@ -18,8 +18,13 @@
 #include "gmock/gmock.h"
 
 #include "parser.h"
+#include "module_builder.h"
 
+#include <algorithm>
+#include <bit>
 #include <fstream>
+#include <random>
+#include <sstream>
 #include <stdexcept>
 #include <span>
 
@@ -85,6 +90,26 @@ TEST(parser, min_module_with_name) {
   EXPECT_THAT(module.name, testing::Eq(std::nullopt));
 }
 
+TEST(parser, buffer_input) {
+  auto bytes = std::vector<uint8_t>{
+    0x00, 0x61, 0x73, 0x6D,  // magic
+    0x01, 0x00, 0x00, 0x00,  // version
+    0x00,                    // Custom section (id = 0)
+    0x0d,                    // Size (u32)
+    0x04,                    // Custom section name length (4 bytes)
+    'n', 'a', 'm', 'e',      // Custom section name "name"
+    0x00,                    // Name subsection id (0 = "module name")
+    0x06,                    // Name subsection 0 size (u32)
+    0x05,                    // Module name length
+    'h', 'e', 'l', 'l', 'o'  // Module name
+  };
+  auto module = parse_wasm(std::span{bytes});  // Should work!
+  EXPECT_THAT(module.name.value(), testing::StrEq("hello"));
+
+  bytes.pop_back();
+  EXPECT_THROW(parse_wasm(std::span{bytes}), std::logic_error);  // EOF
+}
+
 TEST(parser, u8) {
   auto do_it = [](const std::vector<uint8_t>& bytes) -> uint8_t {
     auto is = Memstream{bytes};
@@ -181,6 +206,91 @@ TEST(parser, s16) {
   EXPECT_THROW(do_it({0xff, 0xff, 0xff, 0x7b}), std::logic_error);  // Exceeds s16 range in middle byte (negative)
 }
 
+TEST(parser, leb128_buffer_fast_path) {
+  // With enough bytes left in a buffer, LEB128 decoding skips per-byte bounds checks.  Pad the inputs
+  // so that path is taken, and check it agrees with the stream path, including on invalid encodings.
+  auto cases = std::vector<std::vector<uint8_t>>{
+    {0x00}, {0x42}, {0x7f}, {0x83, 0x00}, {0x83, 0x10}, {0x80, 0x88, 0x00}, {0xfe, 0x7f}, {0xff, 0x3f},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0x0F}, {0xFF, 0xFF, 0xFF, 0xFF, 0x1F}, {0xFF, 0xFF, 0xFF, 0xFF, 0x7F},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00}, {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F},
+    {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x7F}
+  };
+  auto check = [&](auto parse) {
+    for (const auto& bytes : cases) {
+      auto is = Memstream{bytes};
+      auto stream_parser = Wasm_parser{is};
+      auto padded = bytes;
+      padded.resize(bytes.size() + 16, 0xAA);
+      auto buffer_parser = Wasm_parser{std::span{padded}};
+      try {
+        auto expected = parse(stream_parser);
+        EXPECT_THAT(parse(buffer_parser), testing::Eq(expected));
+        EXPECT_THAT(buffer_parser.cur_offset(), testing::Eq(stream_parser.cur_offset()));
+      } catch (const std::logic_error&) {
+        EXPECT_THROW(parse(buffer_parser), std::logic_error);
+      }
+    }
+  };
+  check([](auto& parser) { return uint64_t{parser.parse_u8()}; });
+  check([](auto& parser) { return uint64_t{parser.parse_u32()}; });
+  check([](auto& parser) { return int64_t{parser.parse_s8()}; });
+  check([](auto& parser) { return int64_t{parser.parse_i32()}; });
+  check([](auto& parser) { return parser.parse_s33(); });
+  check([](auto& parser) { return parser.parse_i64(); });
+}
+
+TEST(parser, leb128_fast_path_random) {
+  // Random encodings, biased towards the interesting lengths and last-byte values
+  auto rng = std::mt19937{42};
+  auto cases = std::vector<std::vector<uint8_t>>{};
+  for (auto i = 0; i != 20000; ++i) {
+    auto len = std::uniform_int_distribution<int>{1, 11}(rng);
+    auto bytes = std::vector<uint8_t>{};
+    for (auto j = 0; j != len; ++j) {
+      auto b = static_cast<uint8_t>(std::uniform_int_distribution<int>{0, 0x7f}(rng));
+      bytes.push_back(j + 1 == len ? b : b | 0x80);
+    }
+    cases.push_back(std::move(bytes));
+  }
+
+  auto check = [&](auto parse) {
+    for (const auto& bytes : cases) {
+      auto is = Memstream{bytes};
+      auto stream_parser = Wasm_parser{is};
+      auto padded = bytes;
+      padded.resize(bytes.size() + 16, 0x80);
+      auto buffer_parser = Wasm_parser{std::span{padded}};
+      try {
+        auto expected = parse(stream_parser);
+        EXPECT_THAT(parse(buffer_parser), testing::Eq(expected));
+        EXPECT_THAT(buffer_parser.cur_offset(), testing::Eq(stream_parser.cur_offset()));
+      } catch (const std::logic_error&) {
+        EXPECT_THROW(parse(buffer_parser), std::logic_error);
+      }
+    }
+  };
+  check([](auto& parser) { return uint64_t{parser.parse_u32()}; });
+  check([](auto& parser) { return int64_t{parser.parse_i32()}; });
+  check([](auto& parser) { return parser.parse_s33(); });
+  check([](auto& parser) { return parser.parse_i64(); });
+}
+
+TEST(parser, i64) {
+  auto do_it = [](const std::vector<uint8_t>& bytes) -> int64_t {
+    auto is = Memstream{bytes};
+    auto parser = Wasm_parser{is};
+    return parser.parse_i64();
+  };
+
+  EXPECT_THAT(do_it({0x7f}), testing::Eq(-1));
+  EXPECT_THAT(do_it({0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00}),
+              testing::Eq(std::numeric_limits<int64_t>::max()));
+  EXPECT_THAT(do_it({0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x7F}),
+              testing::Eq(std::numeric_limits<int64_t>::min()));
+  EXPECT_THROW(do_it({0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01}), std::logic_error);
+}
+
 TEST(parser, f32) {
   auto do_it = [](const std::vector<uint8_t>& bytes) -> float {
     auto is = Memstream{bytes};
@@ -236,6 +346,20 @@ TEST(parser, skip_bytes) {
   EXPECT_THROW(skip_N_and_parse_byte(7, false), std::logic_error);  // EOF when skipping bytes
 }
 
+TEST(parser, skip_bytes_buffer) {
+  auto bytes = std::vector<uint8_t>{0x01, 0x02, 0x03, 0x04};
+  auto skip_N_and_parse_byte = [&](int N, bool read = true) -> uint8_t {
+    auto parser = Wasm_parser{std::span{bytes}};
+    parser.skip_bytes(N);
+    return read ? parser.parse_byte() : 0;
+  };
+  EXPECT_THAT(skip_N_and_parse_byte(0), testing::Eq(0x01));
+  EXPECT_THAT(skip_N_and_parse_byte(3), testing::Eq(0x04));
+  EXPECT_THROW(skip_N_and_parse_byte(4), std::logic_error);  // EOF when reading "next byte"
+  EXPECT_THAT(skip_N_and_parse_byte(4, false), testing::Eq(0x00));
+  EXPECT_THROW(skip_N_and_parse_byte(7, false), std::logic_error);  // EOF when skipping bytes
+}
+
 TEST(parser, parse_customsec) {
   auto bytes = std::vector<uint8_t>{
     0x00,                    // Custom section id = 0
@@ -250,7 +374,863 @@ TEST(parser, parse_customsec) {
   EXPECT_THAT(parser.parse_byte(), testing::Eq(0xBA));
 }
 
-// TODO: typesec
+TEST(parser, sections_are_bounded) {
+  // An empty name section followed by another custom section: without bounds, the second section's id and
+  // size would be misread as a module name subsection
+  auto bytes = std::vector<uint8_t>{
+    0x00, 0x61, 0x73, 0x6D,  // magic
+    0x01, 0x00, 0x00, 0x00,  // version
+    0x00,                    // Custom section (id = 0)
+    0x05,                    // Size (u32)
+    0x04, 'n', 'a', 'm', 'e',// Custom section name "name", no subsections
+    0x00,                    // Custom section (id = 0)
+    0x03,                    // Size (u32)
+    0x02, 'h', 'i'           // Custom section name "hi"
+  };
+  {
+    auto is = Memstream{bytes};
+    auto module = parse_wasm(is);  // Should work!
+    EXPECT_THAT(module.name, testing::Eq(std::nullopt));
+  }
+  {
+    auto module = parse_wasm(std::span{bytes});  // Should work!
+    EXPECT_THAT(module.name, testing::Eq(std::nullopt));
+  }
+}
+
+TEST(parser, section_overrun) {
+  // Type section whose contents run past its declared size
+  auto bytes = std::vector<uint8_t>{
+    0x00, 0x61, 0x73, 0x6D,  // magic
+    0x01, 0x00, 0x00, 0x00,  // version
+    0x01,                    // Type section (id = 1)
+    0x03,                    // Size (u32), but the contents take 4 bytes
+    0x01, 0x60, 0x00, 0x00,  // One type: [] -> []
+  };
+  {
+    auto is = Memstream{bytes};
+    EXPECT_THROW(parse_wasm(is), std::logic_error);
+  }
+  EXPECT_THROW(parse_wasm(std::span{bytes}), std::logic_error);
+
+  // Section declared to extend past the end of the input
+  bytes[9] = 0x05;
+  EXPECT_THROW(parse_wasm(std::span{bytes}), std::logic_error);
+}
+
+TEST(parser, skip_bytes_seekable_stream) {
+  auto skip_N_and_parse_byte = [&](int N, bool read = true) -> uint8_t {
+    auto is = std::istringstream{std::string{"\x01\x02\x03\x04"}};
+    auto parser = Wasm_parser{is};
+    parser.skip_bytes(N);
+    return read ? parser.parse_byte() : 0;
+  };
+  EXPECT_THAT(skip_N_and_parse_byte(0), testing::Eq(0x01));
+  EXPECT_THAT(skip_N_and_parse_byte(1), testing::Eq(0x02));
+  EXPECT_THAT(skip_N_and_parse_byte(3), testing::Eq(0x04));
+  EXPECT_THROW(skip_N_and_parse_byte(4), std::logic_error);  // EOF when reading "next byte"
+  EXPECT_THAT(skip_N_and_parse_byte(4, false), testing::Eq(0x00));
+  EXPECT_THROW(skip_N_and_parse_byte(5, false), std::logic_error);  // EOF when skipping bytes
+  EXPECT_THROW(skip_N_and_parse_byte(7, false), std::logic_error);  // EOF when skipping bytes
+}
+
+TEST(parser, funcsec) {
+  // Long enough for the bulk decoder, with some multi-byte typeidxs and a short tail
+  auto typeidxs = std::vector<uint32_t>{};
+  for (auto i = uint32_t{0}; i != 1000; ++i) {
+    typeidxs.push_back(i % 10 == 0 ? 1000 + i : i % 7);
+  }
+  auto contents = std::vector<uint8_t>{0xe8, 0x07};  // 1000 entries
+  for (auto typeidx : typeidxs) {
+    do {
+      auto b = static_cast<uint8_t>(typeidx & 0x7f);
+      typeidx >>= 7;
+      contents.push_back(typeidx != 0 ? b | 0x80 : b);
+    } while (typeidx != 0);
+  }
+  auto bytes = std::vector<uint8_t>{0x03};  // Function section id = 3
+  for (auto size = contents.size(); ; ) {
+    auto b = static_cast<uint8_t>(size & 0x7f);
+    size >>= 7;
+    bytes.push_back(size != 0 ? b | 0x80 : b);
+    if (size == 0) { break; }
+  }
+  bytes.insert(bytes.end(), contents.begin(), contents.end());
+
+  {
+    auto parser = Wasm_parser{std::span{bytes}};
+    EXPECT_THAT(parser.parse_funcsec(), testing::ElementsAreArray(typeidxs));
+  }
+  {
+    auto is = Memstream{bytes};
+    auto parser = Wasm_parser{is};
+    EXPECT_THAT(parser.parse_funcsec(), testing::ElementsAreArray(typeidxs));
+  }
+
+  // Overlong typeidx in the middle of the vector
+  bytes[500] = 0xff; bytes[501] = 0xff; bytes[502] = 0xff; bytes[503] = 0xff; bytes[504] = 0x7f;
+  {
+    auto parser = Wasm_parser{std::span{bytes}};
+    EXPECT_THROW(parser.parse_funcsec(), std::logic_error);
+  }
+}
+
+TEST(parser, no_throw_mode) {
+  auto good = std::vector<uint8_t>{
+    0x00, 0x61, 0x73, 0x6D,  // magic
+    0x01, 0x00, 0x00, 0x00,  // version
+    0x01,                    // Type section (id = 1)
+    0x04,                    // Size (u32)
+    0x01, 0x60, 0x00, 0x00,  // One type: [] -> []
+  };
+  {
+    auto result = try_parse_wasm(std::span{good});
+    ASSERT_TRUE(result.has_value());
+    EXPECT_THAT(result->types.size(), testing::Eq(1));
+  }
+
+  // Reports the same errors as the throwing mode, without throwing
+  auto expect_error = [&](std::vector<uint8_t> bytes, Parse_error_code code, long offset,
+                          std::optional<Section_id> section) {
+    auto result = try_parse_wasm(std::span{bytes});
+    ASSERT_FALSE(result.has_value());
+    EXPECT_THAT(result.error().code, testing::Eq(code));
+    EXPECT_THAT(result.error().offset, testing::Eq(offset));
+    EXPECT_THAT(result.error().section, testing::Eq(section));
+
+    auto is = Memstream{bytes};
+    auto stream_result = try_parse_wasm(is);
+    ASSERT_FALSE(stream_result.has_value());
+    EXPECT_THAT(stream_result.error().code, testing::Eq(code));
+
+    try {
+      parse_wasm(std::span{bytes});
+      ADD_FAILURE() << "parse_wasm didn't throw";
+    } catch (const std::logic_error& e) {
+      EXPECT_THAT(e.what(), testing::StrEq(result.error().message()));
+    }
+    EXPECT_THROW(result.value(), std::logic_error);
+  };
+
+  expect_error({0x00, 0x61, 0x73}, Parse_error_code::k_unexpected_eof, 3, std::nullopt);
+  expect_error({0x00, 0x61, 0x73, 0x6E}, Parse_error_code::k_unexpected_byte, 3, std::nullopt);
+
+  auto bytes = good;
+  bytes[11] = 0x5f;  // Not a functype
+  expect_error(bytes, Parse_error_code::k_unexpected_byte, 11, k_section_type);
+
+  bytes = good;
+  bytes[12] = 0x01;  // One param, which runs into the result type...
+  bytes[13] = 0x7f;  // ...and there's no result type left
+  expect_error(bytes, Parse_error_code::k_unexpected_end_of_section, 14, k_section_type);
+
+  bytes = good;
+  bytes.insert(bytes.begin() + 13, 0x2a);  // Unrecognized valtype
+  bytes[12] = 0x01;
+  bytes[9] = 0x05;
+  expect_error(bytes, Parse_error_code::k_unrecognized_valtype, 13, k_section_type);
+
+  bytes = good;
+  bytes.push_back(0xff);
+  expect_error(bytes, Parse_error_code::k_trailing_data, 14, std::nullopt);
+
+  bytes = good;
+  bytes[10] = 0xff; bytes[11] = 0xff; bytes[12] = 0xff; bytes[13] = 0xff; bytes.push_back(0x7f);  // > u32
+  bytes[9] = 0x05;
+  expect_error(bytes, Parse_error_code::k_invalid_leb128, 10, k_section_type);
+
+  // A huge count in a tiny section is rejected before anything is allocated, on streams too
+  bytes = good;
+  bytes.insert(bytes.end(), {0x03, 0x05, 0xff, 0xff, 0xff, 0xff, 0x0f});  // Function section, 2^32-1 typeidxs
+  expect_error(bytes, Parse_error_code::k_vector_too_long, 21, k_section_function);
+
+  // Likewise for the params and results of a functype
+  bytes = good;
+  bytes[9] = 0x08;
+  bytes.insert(bytes.begin() + 12, {0xff, 0xff, 0xff, 0xff, 0x0f});  // 2^32-1 params
+  bytes.pop_back();
+  expect_error(bytes, Parse_error_code::k_vector_too_long, 17, k_section_type);
+
+  bytes = good;
+  bytes[9] = 0x08;
+  bytes.pop_back();
+  bytes.insert(bytes.end(), {0xff, 0xff, 0xff, 0xff, 0x0f});  // 2^32-1 results
+  expect_error(bytes, Parse_error_code::k_vector_too_long, 18, k_section_type);
+}
+
+TEST(parser, section_index) {
+  auto bytes = sample_module(50);
+  auto index = index_wasm(std::span{bytes});
+
+  auto ids = std::vector<Section_id>{};
+  for (const auto& entry : index.sections) { ids.push_back(entry.id); }
+  EXPECT_THAT(ids, testing::ElementsAre(k_section_custom, k_section_type, k_section_import, k_section_function,
+                                        k_section_memory, k_section_global, k_section_export, k_section_code,
+                                        k_section_data));
+  EXPECT_THAT(index.sections[0].name, testing::Eq("name"));
+  EXPECT_THAT(index.sections[0].offset, testing::Eq(8));
+  for (auto i = size_t{1}; i != index.sections.size(); ++i) {
+    EXPECT_THAT(index.sections[i].offset, testing::Eq(index.sections[i - 1].end_offset()));
+  }
+  EXPECT_THAT(index.sections.back().end_offset(), testing::Eq(bytes.size()));
+
+  // Same thing through a stream
+  {
+    auto is = Memstream{bytes};
+    auto stream_index = index_wasm(is);
+    ASSERT_THAT(stream_index.sections.size(), testing::Eq(index.sections.size()));
+    for (auto i = size_t{0}; i != index.sections.size(); ++i) {
+      EXPECT_THAT(stream_index.sections[i].contents_offset, testing::Eq(index.sections[i].contents_offset));
+      EXPECT_THAT(stream_index.sections[i].size, testing::Eq(index.sections[i].size));
+    }
+  }
+
+  // Parse straight from an index entry
+  auto funcsec = index.find(k_section_function);
+  ASSERT_NE(funcsec, nullptr);
+  auto parser = section_parser(bytes, *funcsec);
+  EXPECT_THAT(parser.parse_funcsec(), testing::ElementsAreArray(parse_wasm(std::span{bytes}).func_types));
+  EXPECT_TRUE(parser.at_eof());
+  EXPECT_THAT(index.find(k_section_start), testing::IsNull());
+
+  // Out-of-order and truncated sections
+  auto builder = Module_builder{};
+  builder.vec_section(k_section_memory, {{0x00, 0x01}});
+  builder.vec_section(k_section_type, {});
+  EXPECT_THROW(index_wasm(std::span{builder.bytes()}), std::logic_error);
+  bytes.pop_back();
+  EXPECT_THROW(index_wasm(std::span{bytes}), std::logic_error);
+}
+
+TEST(parser, lazy_function_bodies) {
+  auto bytes = sample_module(30);
+  auto eager = parse_wasm(std::span{bytes});
+  ASSERT_THAT(eager.codes.size(), testing::Eq(30));
+
+  auto check = [&](const Ast_module& lazy) {
+    ASSERT_THAT(lazy.codes.size(), testing::Eq(eager.codes.size()));
+    for (auto i = size_t{0}; i != lazy.codes.size(); ++i) {
+      const auto& code = lazy.codes[i];
+      EXPECT_THAT(code.func, testing::Eq(std::nullopt));
+      EXPECT_THAT(code.offset, testing::Eq(eager.codes[i].offset));
+      EXPECT_THAT(code.body.size(), testing::Eq(eager.codes[i].size));
+      EXPECT_TRUE(std::equal(code.body.begin(), code.body.end(), bytes.begin() + code.offset));
+
+      auto func = parse_lazy_func(code);
+      ASSERT_THAT(func.locals.size(), testing::Eq(eager.codes[i].func->locals.size()));
+      EXPECT_THAT(func.locals[0].n, testing::Eq(eager.codes[i].func->locals[0].n));
+    }
+  };
+
+  auto lazy = parse_wasm(std::span{bytes}, {.lazy_function_bodies = true});
+  check(lazy);
+  EXPECT_THAT(lazy.codes[0].body.data(), testing::Eq(bytes.data() + lazy.codes[0].offset));  // no copies
+  {
+    auto is = Memstream{bytes};
+    check(parse_wasm(is, {.lazy_function_bodies = true}));
+  }
+
+  // A broken body only gets noticed when it's decoded
+  auto if_block = std::vector<uint8_t>{0x41, 0x01, 0x04, 0x40};
+  auto pos = std::search(bytes.begin(), bytes.end(), if_block.begin(), if_block.end());
+  ASSERT_NE(pos, bytes.end());
+  pos[2] = 0xd5;  // not an opcode
+  EXPECT_THROW(parse_wasm(std::span{bytes}), std::logic_error);
+  auto broken = parse_wasm(std::span{bytes}, {.lazy_function_bodies = true});
+  EXPECT_THROW(parse_lazy_func(broken.codes[0]), std::logic_error);
+  EXPECT_NO_THROW(parse_lazy_func(broken.codes[1]));
+
+  // Function whose size doesn't match its contents
+  auto builder = Module_builder{};
+  builder.vec_section(k_section_function, {{0x00}});
+  builder.vec_section(k_section_code, {{0x04, 0x00, 0x0b, 0x0b, 0x0b}});
+  EXPECT_THROW(parse_wasm(std::span{builder.bytes()}), std::logic_error);
+  auto mismatched = parse_wasm(std::span{builder.bytes()}, {.lazy_function_bodies = true});
+  EXPECT_THROW(parse_lazy_func(mismatched.codes[0]), std::logic_error);
+}
+
+TEST(parser, parallel_function_bodies) {
+  auto bytes = sample_module(3000);
+  auto serial = parse_wasm(std::span{bytes});
+
+  for (auto num_threads : {2, 3, 8}) {
+    auto parallel = parse_wasm(std::span{bytes}, {.num_threads = num_threads});
+    ASSERT_THAT(parallel.codes.size(), testing::Eq(serial.codes.size()));
+    for (auto i = size_t{0}; i != parallel.codes.size(); ++i) {
+      const auto& code = parallel.codes[i];
+      EXPECT_THAT(code.offset, testing::Eq(serial.codes[i].offset));
+      EXPECT_TRUE(code.body.empty());
+      ASSERT_TRUE(code.func.has_value());
+      EXPECT_THAT(code.func->locals.size(), testing::Eq(serial.codes[i].func->locals.size()));
+      EXPECT_THAT(code.func->body.size(), testing::Eq(serial.codes[i].func->body.size()));
+    }
+  }
+
+  // Reports the same error as a serial parse (the one with the lowest offset), however the work gets split
+  auto if_block = std::vector<uint8_t>{0x41, 0x01, 0x04, 0x40};
+  auto first = std::search(bytes.begin() + bytes.size() / 2, bytes.end(), if_block.begin(), if_block.end());
+  auto second = std::search(first + 1, bytes.end(), if_block.begin(), if_block.end());
+  auto last = std::find_end(bytes.begin(), bytes.end(), if_block.begin(), if_block.end());
+  ASSERT_NE(second, bytes.end());
+  first[2] = 0xd5; second[2] = 0xd6; last[2] = 0xd7;  // not opcodes
+
+  auto serial_result = try_parse_wasm(std::span{bytes});
+  ASSERT_FALSE(serial_result.has_value());
+  EXPECT_THAT(serial_result.error().offset, testing::Eq(first - bytes.begin() + 2));
+  for (auto num_threads : {2, 3, 8}) {
+    for (auto rep = 0; rep != 5; ++rep) {
+      auto result = try_parse_wasm(std::span{bytes}, {.num_threads = num_threads});
+      ASSERT_FALSE(result.has_value());
+      EXPECT_THAT(result.error().code, testing::Eq(serial_result.error().code));
+      EXPECT_THAT(result.error().offset, testing::Eq(serial_result.error().offset));
+      EXPECT_THAT(result.error().section, testing::Eq(k_section_code));
+    }
+    EXPECT_THROW(parse_wasm(std::span{bytes}, {.num_threads = num_threads}), std::logic_error);
+  }
+
+  // Ditto when grabbing the bodies fails too, further on: here, on a truncated size after the last body
+  for (auto bad_body : {true, false}) {
+    SCOPED_TRACE(bad_body);
+    auto entries = std::vector<Bytes>{};
+    for (auto i = 0; i != 200; ++i) {
+      entries.push_back(code_entry({0x00, static_cast<uint8_t>(bad_body && i == 10 ? 0xd5 : 0x01), 0x0b}));
+    }
+    entries.push_back({0x80});  // u32 that never ends
+    auto funcsec = Bytes{};
+    append_u32(funcsec, entries.size());
+    funcsec.insert(funcsec.end(), entries.size(), 0x00);
+    auto builder = Module_builder{};
+    builder.vec_section(k_section_type, {{0x60, 0x00, 0x00}});
+    builder.section(k_section_function, funcsec);
+    builder.vec_section(k_section_code, entries);
+
+    auto expected = try_parse_wasm(std::span{builder.bytes()});
+    ASSERT_FALSE(expected.has_value());
+    EXPECT_THAT(expected.error().code, testing::Eq(bad_body ? Parse_error_code::k_unrecognized_opcode
+                                                            : Parse_error_code::k_unexpected_end_of_section));
+    for (auto num_threads : {2, 8}) {
+      auto result = try_parse_wasm(std::span{builder.bytes()}, {.num_threads = num_threads});
+      ASSERT_FALSE(result.has_value());
+      EXPECT_THAT(result.error().code, testing::Eq(expected.error().code));
+      EXPECT_THAT(result.error().offset, testing::Eq(expected.error().offset));
+      EXPECT_THROW(parse_wasm(std::span{builder.bytes()}, {.num_threads = num_threads}), std::logic_error);
+    }
+  }
+}
+
+TEST(parser, function_bodies) {
+  auto body = Bytes{0x01, 0x01, 0x7f};  // 1 local of type i32
+  append_bytes(body, {0x02, 0x40, 0x03, 0x7f, 0x20, 0x00});  // block, loop (result i32), local.get 0
+  append_bytes(body, {0x0e, 0x02, 0x00, 0x01, 0x01, 0x0b, 0x0b});  // br_table 0 1 1, end, end
+  body.push_back(0x42);
+  append_s64(body, -5);  // i64.const -5
+  append_bytes(body, {0x44, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf8, 0x3f});  // f64.const 1.5
+  append_bytes(body, {0x1a, 0x1a, 0x41, 0x00, 0x28, 0x02, 0x08});  // drop, drop, i32.const 0, i32.load align=2 offset=8
+  append_bytes(body, {0x04, 0x40, 0x01, 0x05, 0x00, 0x0b, 0x0b});  // if nop else unreachable end, end
+  auto builder = Module_builder{};
+  builder.vec_section(k_section_type, {{0x60, 0x00, 0x00}});
+  builder.vec_section(k_section_function, {{0x00}});
+  builder.vec_section(k_section_code, {code_entry(body)});
+
+  auto module = parse_wasm(std::span{builder.bytes()});
+  ASSERT_THAT(module.codes.size(), testing::Eq(1));
+  const auto& func = *module.codes[0].func;
+  auto opcodes = std::vector<uint8_t>{};
+  for (const auto& instr : func.body) { opcodes.push_back(instr.opcode); }
+  EXPECT_THAT(opcodes, testing::ElementsAre(
+      k_instr_block, k_instr_loop, k_instr_local_get, k_instr_br_table, k_instr_end, k_instr_end,
+      k_instr_i64_const, k_instr_f64_const, k_instr_drop, k_instr_drop, k_instr_i32_const, k_instr_i32_load,
+      k_instr_if, k_instr_nop, k_instr_else, k_instr_unreachable, k_instr_end, k_instr_end));
+
+  // Blocks and their ends point at each other
+  EXPECT_THAT(func.body[0].a, testing::Eq(k_blocktype_empty));
+  EXPECT_THAT(func.body[0].b, testing::Eq(5));
+  EXPECT_THAT(func.body[1].a, testing::Eq(k_blocktype_valtype | k_numtype_i32));
+  EXPECT_THAT(func.body[1].b, testing::Eq(4));
+  EXPECT_THAT(func.body[4].a, testing::Eq(1));
+  EXPECT_THAT(func.body[5].a, testing::Eq(0));
+  EXPECT_THAT(func.body[12].subopcode, testing::Eq(14));
+  EXPECT_THAT(func.body[12].b, testing::Eq(16));
+  EXPECT_THAT(func.body[14].a, testing::Eq(12));
+  EXPECT_THAT(func.body[14].b, testing::Eq(16));
+  EXPECT_THAT(func.body[17].a, testing::Eq(k_no_instr));
+
+  // Immediates
+  EXPECT_THAT(func.body[2].a, testing::Eq(0));
+  auto labels = std::span{func.br_table_labels}.subspan(func.body[3].a, func.body[3].b);
+  EXPECT_THAT(labels, testing::ElementsAre(0, 1, 1));
+  EXPECT_THAT(static_cast<int64_t>(func.body[6].imm64()), testing::Eq(-5));
+  EXPECT_THAT(std::bit_cast<double>(func.body[7].imm64()), testing::Eq(1.5));
+  EXPECT_THAT(func.body[11].a, testing::Eq(2));
+  EXPECT_THAT(func.body[11].b, testing::Eq(8));
+
+  // Same from a stream, lazily, or in parallel
+  auto is = Memstream{builder.bytes()};
+  EXPECT_THAT(parse_wasm(is).codes[0].func->body.size(), testing::Eq(func.body.size()));
+  auto lazy = parse_wasm(std::span{builder.bytes()}, {.lazy_function_bodies = true});
+  EXPECT_THAT(parse_lazy_func(lazy.codes[0]).br_table_labels, testing::ElementsAre(0, 1, 1));
+}
+
+TEST(parser, deeply_nested_blocks) {
+  constexpr auto k_depth = uint32_t{100'000};
+  auto body = Bytes{0x00};  // no locals
+  for (auto i = uint32_t{0}; i != k_depth; ++i) { append_bytes(body, {0x02, 0x40}); }  // block
+  body.insert(body.end(), k_depth + 1, 0x0b);  // end (the last one, of the function)
+  auto builder = Module_builder{};
+  builder.vec_section(k_section_type, {{0x60, 0x00, 0x00}});
+  builder.vec_section(k_section_function, {{0x00}});
+  builder.vec_section(k_section_code, {code_entry(body)});
+  const auto& bytes = builder.bytes();
+
+  auto check = [&](const Ast_module& module) {
+    const auto& instrs = module.codes[0].func->body;
+    ASSERT_THAT(instrs.size(), testing::Eq(2 * k_depth + 1));
+    EXPECT_THAT(instrs[0].b, testing::Eq(2 * k_depth - 1));
+    EXPECT_THAT(instrs[k_depth - 1].b, testing::Eq(k_depth));
+    EXPECT_THAT(instrs[k_depth].a, testing::Eq(k_depth - 1));
+    EXPECT_THAT(instrs[2 * k_depth - 1].a, testing::Eq(0));
+    EXPECT_THAT(instrs.back().a, testing::Eq(k_no_instr));
+  };
+  check(parse_wasm(std::span{bytes}));
+  {
+    auto is = Memstream{bytes};
+    check(parse_wasm(is));
+  }
+
+  // Nesting limit
+  auto result = try_parse_wasm(std::span{bytes}, {.max_nesting = 1000});
+  ASSERT_FALSE(result.has_value());
+  EXPECT_THAT(result.error().code, testing::Eq(Parse_error_code::k_too_deeply_nested));
+  auto first_block = static_cast<long>(bytes.size() - body.size() + 1);
+  EXPECT_THAT(result.error().offset, testing::Eq(first_block + 2 * 1000));
+  EXPECT_TRUE(try_parse_wasm(std::span{bytes}, {.max_nesting = k_depth}).has_value());
+
+  // Clauses that don't belong to the innermost block
+  for (const auto& bad_body : {Bytes{0x00, 0x02, 0x40, 0x05, 0x0b, 0x0b},          // else in a block
+                               Bytes{0x00, 0x04, 0x40, 0x05, 0x05, 0x0b, 0x0b},    // two elses
+                               Bytes{0x00, 0x06, 0x40, 0x19, 0x07, 0x00, 0x0b, 0x0b},  // catch after catch_all
+                               Bytes{0x00, 0x05, 0x0b}}) {                         // else outside any block
+    auto bad = Module_builder{};
+    bad.vec_section(k_section_function, {{0x00}});
+    bad.vec_section(k_section_code, {code_entry(bad_body)});
+    auto bad_result = try_parse_wasm(std::span{bad.bytes()});
+    ASSERT_FALSE(bad_result.has_value());
+    EXPECT_THAT(bad_result.error().code, testing::Eq(Parse_error_code::k_unrecognized_opcode));
+  }
+}
+
+TEST(parser, invalid_blocktype) {
+  // Negative s33s aren't typeidxs: 0x60 is -32, and the 5-byte one is about -2^32
+  for (const auto& bad_body : {Bytes{0x00, 0x02, 0x60, 0x0b, 0x0b},
+                               Bytes{0x00, 0x03, 0xff, 0xff, 0xff, 0xff, 0x70, 0x0b, 0x0b}}) {
+    auto bad = Module_builder{};
+    bad.vec_section(k_section_type, {{0x60, 0x00, 0x00}});
+    bad.vec_section(k_section_function, {{0x00}});
+    bad.vec_section(k_section_code, {code_entry(bad_body)});
+    for (auto validate : {false, true}) {
+      auto result = try_parse_wasm(std::span{bad.bytes()}, {.validate = validate});
+      ASSERT_FALSE(result.has_value());
+      EXPECT_THAT(result.error().code, testing::Eq(Parse_error_code::k_invalid_blocktype));
+      EXPECT_THAT(result.error().offset, testing::Eq(static_cast<long>(bad.bytes().size() - bad_body.size() + 2)));
+    }
+  }
+
+  // A typeidx is fine
+  auto good = Module_builder{};
+  good.vec_section(k_section_type, {{0x60, 0x00, 0x00}});
+  good.vec_section(k_section_function, {{0x00}});
+  good.vec_section(k_section_code, {code_entry({0x00, 0x02, 0x00, 0x0b, 0x0b})});
+  auto module = parse_wasm(std::span{good.bytes()}, {.validate = true});
+  EXPECT_THAT(module.codes[0].func->body[0].a, testing::Eq(0));
+}
+
+TEST(parser, typed_select) {
+  // select (result f64), then select with two types, which decodes but doesn't validate
+  auto body = Bytes{0x00, 0x44, 0, 0, 0, 0, 0, 0, 0, 0, 0x44, 0, 0, 0, 0, 0, 0, 0, 0, 0x41, 0x01,
+                    0x1c, 0x01, 0x7c, 0x1a, 0x0b};
+  auto builder = Module_builder{};
+  builder.vec_section(k_section_type, {{0x60, 0x00, 0x00}});
+  builder.vec_section(k_section_function, {{0x00}});
+  builder.vec_section(k_section_code, {code_entry(body)});
+  auto module = parse_wasm(std::span{builder.bytes()}, {.validate = true});
+  const auto& func = *module.codes[0].func;
+  ASSERT_THAT(func.body[3].opcode, testing::Eq(k_instr_select_t));
+  ASSERT_THAT(func.body[3].b, testing::Eq(1));
+  EXPECT_THAT(func.br_table_labels[func.body[3].a], testing::Eq(k_numtype_f64));
+
+  body[22] = 0x02;
+  body.insert(body.begin() + 24, 0x7f);
+  auto two = Module_builder{};
+  two.vec_section(k_section_type, {{0x60, 0x00, 0x00}});
+  two.vec_section(k_section_function, {{0x00}});
+  two.vec_section(k_section_code, {code_entry(body)});
+  auto two_module = parse_wasm(std::span{two.bytes()});
+  const auto& two_func = *two_module.codes[0].func;
+  ASSERT_THAT(two_func.body[3].b, testing::Eq(2));
+  EXPECT_THAT(std::span{two_func.br_table_labels}.subspan(two_func.body[3].a, 2),
+              testing::ElementsAre(k_numtype_f64, k_numtype_i32));
+  auto result = try_parse_wasm(std::span{two.bytes()}, {.validate = true});
+  ASSERT_FALSE(result.has_value());
+  EXPECT_THAT(result.error().code, testing::Eq(Parse_error_code::k_invalid_select_arity));
+
+  // Skipped over in an initializer expression (not a constant instruction, but it still has to be decoded)
+  auto global = Module_builder{};
+  global.vec_section(k_section_global, {{0x7f, 0x00, 0x41, 0x01, 0x41, 0x02, 0x41, 0x00, 0x1c, 0x01, 0x7f, 0x0b}});
+  EXPECT_TRUE(try_parse_wasm(std::span{global.bytes()}).has_value());
+  auto bad_global = Module_builder{};
+  bad_global.vec_section(k_section_global, {{0x7f, 0x00, 0x41, 0x00, 0x1c, 0x01, 0x2a, 0x0b}});
+  auto bad_result = try_parse_wasm(std::span{bad_global.bytes()});
+  ASSERT_FALSE(bad_result.has_value());
+  EXPECT_THAT(bad_result.error().code, testing::Eq(Parse_error_code::k_unrecognized_valtype));
+}
+
+TEST(parser, opcode_table) {
+  EXPECT_THAT(k_instr_mnemonics[k_instr_i32_add], testing::Eq("i32.add"));
+  EXPECT_THAT(k_instr_stack_effects[k_instr_i32_add], testing::Eq("ii:i"));
+  EXPECT_THAT(k_instr_imm_kinds[k_instr_call_indirect], testing::Eq(Imm_kind::k_u32_u32));
+  EXPECT_THAT(k_instr_imm_kinds[0xd5], testing::Eq(Imm_kind::k_invalid));
+  EXPECT_THAT(k_ext_instr_mnemonics[k_ext_instr_memory_copy], testing::Eq("memory.copy"));
+  EXPECT_THAT(k_atomic_instr_mnemonics[k_atomic_instr_i64_atomic_rmw32_cmpxchg_u],
+              testing::Eq("i64.atomic.rmw32.cmpxchg_u"));
+
+  // Every instruction without immediates decodes to itself
+  for (auto opcode = 0; opcode != 256; ++opcode) {
+    if (k_instr_imm_kinds[opcode] != Imm_kind::k_none) { continue; }
+    SCOPED_TRACE(k_instr_mnemonics[opcode]);
+    auto builder = Module_builder{};
+    builder.vec_section(k_section_function, {{0x00}});
+    builder.vec_section(k_section_code, {code_entry({0x00, static_cast<uint8_t>(opcode), 0x0b})});
+    auto module = parse_wasm(std::span{builder.bytes()});
+    ASSERT_THAT(module.codes[0].func->body.size(), testing::Eq(2));
+    EXPECT_THAT(module.codes[0].func->body[0].opcode, testing::Eq(opcode));
+  }
+
+  // Secondary opcodes, and ones that don't exist
+  auto builder = Module_builder{};
+  builder.vec_section(k_section_function, {{0x00}});
+  builder.vec_section(k_section_code, {code_entry({0x00, 0xfc, 0x07, 0xfe, 0x03, 0x00, 0x0b})});
+  auto module = parse_wasm(std::span{builder.bytes()});
+  EXPECT_THAT(module.codes[0].func->body[0].subopcode, testing::Eq(k_ext_instr_i64_trunc_sat_f64_u));
+  EXPECT_THAT(module.codes[0].func->body[1].subopcode, testing::Eq(k_atomic_instr_atomic_fence));
+  for (auto [prefix, code] : {std::pair{0xfc, Parse_error_code::k_unrecognized_ext_opcode},
+                              std::pair{0xfd, Parse_error_code::k_unrecognized_simd_opcode},
+                              std::pair{0xfe, Parse_error_code::k_unrecognized_atomic_opcode}}) {
+    auto bad = Module_builder{};
+    bad.vec_section(k_section_function, {{0x00}});
+    bad.vec_section(k_section_code, {code_entry({0x00, static_cast<uint8_t>(prefix), 0x80, 0x02, 0x0b})});
+    auto result = try_parse_wasm(std::span{bad.bytes()});
+    ASSERT_FALSE(result.has_value());
+    EXPECT_THAT(result.error().code, testing::Eq(code));
+  }
+}
+
+TEST(parser, vector_instructions) {
+  EXPECT_THAT(k_simd_instr_mnemonics[k_simd_instr_i16x8_extmul_high_i8x16_u],
+              testing::Eq("i16x8.extmul_high_i8x16_u"));
+  EXPECT_THAT(k_simd_instr_imm_kinds[0x9a], testing::Eq(Imm_kind::k_invalid));  // retired
+  EXPECT_THAT(k_simd_instr_natural_alignments[k_simd_instr_v128_load], testing::Eq(4));
+  EXPECT_THAT(k_simd_instr_natural_alignments[k_simd_instr_v128_load8x8_s], testing::Eq(3));
+  EXPECT_THAT(k_simd_instr_natural_alignments[k_simd_instr_v128_load16_splat], testing::Eq(1));
+  EXPECT_THAT(k_simd_instr_natural_alignments[k_simd_instr_v128_load32_zero], testing::Eq(2));
+  EXPECT_THAT(k_simd_instr_natural_alignments[k_simd_instr_v128_store8_lane], testing::Eq(0));
+  EXPECT_THAT(k_simd_instr_lane_counts[k_simd_instr_i8x16_replace_lane], testing::Eq(16));
+  EXPECT_THAT(k_simd_instr_lane_counts[k_simd_instr_f64x2_extract_lane], testing::Eq(2));
+  EXPECT_THAT(k_simd_instr_lane_counts[k_simd_instr_v128_load16_lane], testing::Eq(8));
+  EXPECT_THAT(k_simd_instr_lane_counts[k_simd_instr_i8x16_shuffle], testing::Eq(32));
+
+  auto shuffle_lanes = Ast_v128{};
+  for (auto j = 0; j != 16; ++j) { shuffle_lanes[j] = static_cast<uint8_t>(2 * j); }
+  auto body = Bytes{0x00};  // no locals
+  append_bytes(body, {0x41, 0x00, 0xfd, 0x01, 0x03, 0x00});  // i32.const 0, v128.load8x8_s align=3
+  auto align_pos = body.size() - 2;
+  append_bytes(body, {0xfd, 0x0c});  // v128.const
+  for (auto j = 0; j != 16; ++j) { body.push_back(static_cast<uint8_t>(j)); }
+  append_bytes(body, {0xfd, 0x0d});  // i8x16.shuffle
+  body.insert(body.end(), shuffle_lanes.begin(), shuffle_lanes.end());
+  auto shuffle_lane_pos = body.size() - 1;
+  append_bytes(body, {0xfd, 0x18, 0x07, 0x1a});  // i16x8.extract_lane_s 7, drop
+  auto extract_lane_pos = body.size() - 2;
+  append_bytes(body, {0x41, 0x00, 0xfd, 0x0c});  // i32.const 0, v128.const
+  body.insert(body.end(), 16, 0xff);
+  append_bytes(body, {0xfd, 0x55, 0x01, 0x04, 0x07});  // v128.load16_lane offset=4 align=1 7
+  auto load_lane_pos = body.size() - 1;
+  append_bytes(body, {0xfd, 0xff, 0x01, 0xfd, 0x53, 0x0b});  // f64x2.convert_low_i32x4_u, v128.any_true, end
+  auto module_with_body = [](const Bytes& body) {
+    auto builder = Module_builder{};
+    builder.vec_section(k_section_type, {{0x60, 0x00, 0x01, 0x7f}});
+    builder.vec_section(k_section_function, {{0x00}});
+    builder.vec_section(k_section_memory, {{0x00, 0x01}});
+    builder.vec_section(k_section_code, {code_entry(body)});
+    return builder.bytes();
+  };
+  auto bytes = module_with_body(body);
+
+  auto module = parse_wasm(std::span{bytes}, {.validate = true});
+  const auto& func = *module.codes[0].func;
+  ASSERT_THAT(func.body.size(), testing::Eq(12));
+  EXPECT_THAT(func.body[1].opcode, testing::Eq(k_instr_simd_prefix));
+  EXPECT_THAT(func.body[1].subopcode, testing::Eq(k_simd_instr_v128_load8x8_s));
+  EXPECT_THAT(func.body[1].a, testing::Eq(3));
+  ASSERT_THAT(func.v128_imms.size(), testing::Eq(3));
+  EXPECT_THAT(func.v128_imms[func.body[2].a],
+              testing::ElementsAre(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+  EXPECT_THAT(func.v128_imms[func.body[3].a], testing::ElementsAreArray(shuffle_lanes));
+  EXPECT_THAT(func.body[4].lane, testing::Eq(7));
+  EXPECT_THAT(func.body[8].a, testing::Eq(1));
+  EXPECT_THAT(func.body[8].b, testing::Eq(4));
+  EXPECT_THAT(func.body[8].lane, testing::Eq(7));
+  EXPECT_THAT(func.body[9].subopcode, testing::Eq(k_simd_instr_f64x2_convert_low_i32x4_u));
+  EXPECT_THAT(func.body[10].subopcode, testing::Eq(k_simd_instr_v128_any_true));
+
+  // Same from a stream, or lazily
+  auto is = Memstream{bytes};
+  EXPECT_THAT(parse_wasm(is).codes[0].func->v128_imms.size(), testing::Eq(3));
+  auto lazy = parse_wasm(std::span{bytes}, {.lazy_function_bodies = true});
+  EXPECT_THAT(parse_lazy_func(lazy.codes[0]).v128_imms[1], testing::ElementsAreArray(shuffle_lanes));
+
+  // Alignments and lane indices out of range only fail validation
+  auto check_invalid = [&](size_t pos, uint8_t value, Parse_error_code code, int64_t arg0, int64_t arg1) {
+    auto bad_body = body;
+    bad_body[pos] = value;
+    auto bad = module_with_body(bad_body);
+    EXPECT_TRUE(try_parse_wasm(std::span{bad}).has_value());
+    auto result = try_parse_wasm(std::span{bad}, {.validate = true});
+    ASSERT_FALSE(result.has_value());
+    EXPECT_THAT(result.error().code, testing::Eq(code));
+    EXPECT_THAT(result.error().args[0], testing::Eq(arg0));
+    EXPECT_THAT(result.error().args[1], testing::Eq(arg1));
+  };
+  check_invalid(align_pos, 0x04, Parse_error_code::k_invalid_alignment, 4, 3);
+  check_invalid(shuffle_lane_pos, 0x20, Parse_error_code::k_invalid_lane_index, 32, 32);
+  check_invalid(extract_lane_pos, 0x08, Parse_error_code::k_invalid_lane_index, 8, 8);
+  check_invalid(load_lane_pos, 0x08, Parse_error_code::k_invalid_lane_index, 8, 8);
+}
+
+TEST(parser, validation) {
+  // Valid modules stay valid, whichever way the bodies get decoded
+  auto bytes = sample_module(300);
+  EXPECT_TRUE(try_parse_wasm(std::span{bytes}, {.validate = true}).has_value());
+  EXPECT_TRUE(try_parse_wasm(std::span{bytes}, {.num_threads = 4, .validate = true}).has_value());
+  auto is = Memstream{bytes};
+  EXPECT_TRUE(try_parse_wasm(is, {.validate = true}).has_value());
+
+  // A function of type [i32] -> [i32] with one i64 local, in a module with a memory and an immutable global
+  auto with_body = [](const Bytes& expr, bool with_data_count = false) {
+    auto body = Bytes{0x01, 0x01, 0x7e};
+    append_bytes(body, expr);
+    auto builder = Module_builder{};
+    builder.vec_section(k_section_type, {{0x60, 0x01, 0x7f, 0x01, 0x7f}});
+    builder.vec_section(k_section_function, {{0x00}});
+    builder.vec_section(k_section_memory, {{0x00, 0x01}});
+    builder.vec_section(k_section_global, {{0x7f, 0x00, 0x41, 0x00, 0x0b}});
+    if (with_data_count) { builder.section(k_section_data_count, {0x01}); }
+    builder.vec_section(k_section_code, {code_entry(body)});
+    return builder.bytes();
+  };
+  struct Case {
+    Bytes expr;
+    Parse_error_code code;
+    int64_t arg0, arg1;
+  };
+  auto cases = std::vector<Case>{
+    {{0x20, 0x01, 0x0b}, Parse_error_code::k_type_mismatch, k_numtype_i32, k_numtype_i64},
+    {{0x6a, 0x0b}, Parse_error_code::k_type_mismatch, k_numtype_i32, -1},
+    {{0x20, 0x00, 0x20, 0x00, 0x0b}, Parse_error_code::k_unused_values, 1, 0},
+    {{0x20, 0x02, 0x0b}, Parse_error_code::k_unknown_index, int64_t(Ast_index_space::k_local), 2},
+    {{0x41, 0x00, 0x24, 0x00, 0x20, 0x00, 0x0b}, Parse_error_code::k_immutable_global, 0, 0},
+    {{0x20, 0x00, 0x28, 0x03, 0x00, 0x0b}, Parse_error_code::k_invalid_alignment, 3, 2},
+    {{0x20, 0x00, 0x0c, 0x01, 0x0b}, Parse_error_code::k_unknown_index, int64_t(Ast_index_space::k_label), 1},
+    {{0x10, 0x07, 0x0b}, Parse_error_code::k_unknown_index, int64_t(Ast_index_space::k_func), 7},
+    {{0x02, 0x7f, 0x0b, 0x0b}, Parse_error_code::k_type_mismatch, k_numtype_i32, -1},
+    {{0x20, 0x00, 0x04, 0x7f, 0x41, 0x01, 0x0b, 0x0b}, Parse_error_code::k_type_mismatch, k_numtype_i32, -1},
+    {{0xd0, 0x70, 0xd0, 0x70, 0x20, 0x00, 0x1b, 0x0b},
+     Parse_error_code::k_untyped_select_of_reftype, k_reftype_funcref, 0},
+    {{0x20, 0x00, 0x20, 0x00, 0x20, 0x00, 0xfc, 0x08, 0x00, 0x00, 0x0b}, Parse_error_code::k_missing_data_count, 0, 0},
+  };
+  for (const auto& [expr, code, arg0, arg1] : cases) {
+    SCOPED_TRACE(testing::PrintToString(expr));
+    auto module_bytes = with_body(expr);
+    EXPECT_TRUE(try_parse_wasm(std::span{module_bytes}).has_value());  // only checked on request
+    auto result = try_parse_wasm(std::span{module_bytes}, {.validate = true});
+    ASSERT_FALSE(result.has_value());
+    EXPECT_THAT(result.error().code, testing::Eq(code));
+    EXPECT_THAT(result.error().args[0], testing::Eq(arg0));
+    EXPECT_THAT(result.error().args[1], testing::Eq(arg1));
+    EXPECT_THAT(result.error().section, testing::Optional(k_section_code));
+  }
+
+  auto identity = with_body({0x20, 0x00, 0x0b});
+  EXPECT_TRUE(try_parse_wasm(std::span{identity}, {.validate = true}).has_value());
+
+  // Unreachable code is polymorphic, and errors point at the offending instruction
+  auto unreachable = with_body({0x00, 0x6a, 0x1a, 0x0b});  // unreachable, i32.add, drop
+  EXPECT_TRUE(try_parse_wasm(std::span{unreachable}, {.validate = true}).has_value());
+  auto bad = with_body({0x20, 0x00, 0x42, 0x00, 0x6a, 0x0b});  // local.get 0, i64.const 0, i32.add
+  auto result = try_parse_wasm(std::span{bad}, {.validate = true});
+  ASSERT_FALSE(result.has_value());
+  EXPECT_THAT(result.error().offset, testing::Eq(static_cast<long>(bad.size()) - 2));
+  EXPECT_THAT(result.error().message(), testing::HasSubstr("expected i32, found i64"));
+  auto data_drop = with_body({0x20, 0x00, 0xfc, 0x09, 0x00, 0x0b}, true);
+  EXPECT_TRUE(try_parse_wasm(std::span{data_drop}, {.validate = true}).has_value());
+}
+
+TEST(parser, data_segments) {
+  auto builder = Module_builder{};
+  auto active = Bytes{0x00, 0x41, 0x10, 0x0b};  // offset 16
+  append_name(active, "hello");
+  auto passive = Bytes{0x01};
+  append_name(passive, "");
+  auto explicit_memory = Bytes{0x02, 0x01, 0x23, 0x00, 0x0b};  // memory 1, offset global 0
+  append_name(explicit_memory, "world!");
+  builder.vec_section(k_section_data, {active, passive, explicit_memory});
+  const auto& bytes = builder.bytes();
+
+  auto as_string = [](std::span<const uint8_t> s) { return std::string(s.begin(), s.end()); };
+  auto in_input = [&](std::span<const uint8_t> s) {
+    return s.data() >= bytes.data() && s.data() < bytes.data() + bytes.size();
+  };
+  auto check = [&](const Ast_module& module) {
+    ASSERT_THAT(module.datas.size(), testing::Eq(3));
+    EXPECT_THAT(module.datas[0].mode, testing::Eq(Ast_datamode::k_active));
+    EXPECT_THAT(module.datas[0].memory, testing::Eq(0));
+    EXPECT_THAT(module.datas[0].offset, testing::ElementsAre(0x41, 0x10, 0x0b));
+    EXPECT_THAT(as_string(module.datas[0].init), testing::Eq("hello"));
+    EXPECT_THAT(module.datas[1].mode, testing::Eq(Ast_datamode::k_passive));
+    EXPECT_TRUE(module.datas[1].offset.empty());
+    EXPECT_TRUE(module.datas[1].init.empty());
+    EXPECT_THAT(module.datas[2].mode, testing::Eq(Ast_datamode::k_active));
+    EXPECT_THAT(module.datas[2].memory, testing::Eq(1));
+    EXPECT_THAT(module.datas[2].offset, testing::ElementsAre(0x23, 0x00, 0x0b));
+    EXPECT_THAT(as_string(module.datas[2].init), testing::Eq("world!"));
+  };
+
+  // Buffer inputs: no copies unless asked for
+  auto module = parse_wasm(std::span{bytes});
+  check(module);
+  EXPECT_TRUE(in_input(module.datas[0].init));
+  EXPECT_TRUE(in_input(module.datas[2].offset));
+  auto copied = parse_wasm(std::span{bytes}, {.copy_bytes = true});
+  check(copied);
+  EXPECT_FALSE(in_input(copied.datas[0].init));
+  EXPECT_FALSE(in_input(copied.datas[2].offset));
+
+  // Streams: copied, offset expressions included
+  {
+    auto is = Memstream{bytes};
+    check(parse_wasm(is));
+  }
+
+  // Segment that claims more bytes than there are
+  auto truncated = Module_builder{};
+  truncated.vec_section(k_section_data, {{0x01, 0x10, 'a', 'b'}});
+  EXPECT_THROW(parse_wasm(std::span{truncated.bytes()}), std::logic_error);
+  {
+    auto is = Memstream{truncated.bytes()};
+    EXPECT_THROW(parse_wasm(is), std::logic_error);
+  }
+}
+
+TEST(parser, names) {
+  auto builder = Module_builder{};
+  auto imports = std::vector<Bytes>{};
+  for (auto i = 0; i != 1000; ++i) {
+    auto import = Bytes{};
+    append_name(import, "wasi_snapshot_preview1");
+    append_name(import, i % 2 == 0 ? "fd_write" : "proc_exit");
+    append_bytes(import, {0x00, 0x00});  // func, typeidx 0
+    imports.push_back(import);
+  }
+  builder.vec_section(k_section_import, imports);
+  const auto& bytes = builder.bytes();
+  auto in_input = [&](std::string_view s) {
+    return reinterpret_cast<const uint8_t*>(s.data()) >= bytes.data()
+        && reinterpret_cast<const uint8_t*>(s.data()) < bytes.data() + bytes.size();
+  };
+
+  // Buffer inputs: names point into the input
+  auto module = parse_wasm(std::span{bytes});
+  ASSERT_THAT(module.imports.size(), testing::Eq(1000));
+  EXPECT_THAT(module.imports[999].module, testing::Eq("wasi_snapshot_preview1"));
+  EXPECT_THAT(module.imports[999].name, testing::Eq("proc_exit"));
+  EXPECT_TRUE(in_input(module.imports[999].name));
+  EXPECT_THAT(module.interned_names.size(), testing::Eq(0));
+
+  // Streams (and copy_bytes): each distinct name is stored once
+  auto check_interned = [&](const Ast_module& module) {
+    ASSERT_THAT(module.imports.size(), testing::Eq(1000));
+    EXPECT_THAT(module.interned_names.size(), testing::Eq(3));
+    for (const auto& import : module.imports) {
+      EXPECT_THAT(import.module.data(), testing::Eq(module.imports[0].module.data()));
+      EXPECT_FALSE(in_input(import.module));
+    }
+    EXPECT_THAT(module.imports[0].name, testing::Eq("fd_write"));
+    EXPECT_THAT(module.imports[1].name, testing::Eq("proc_exit"));
+    EXPECT_THAT(module.imports[2].name.data(), testing::Eq(module.imports[0].name.data()));
+  };
+  {
+    auto is = Memstream{bytes};
+    check_interned(parse_wasm(is));
+  }
+  check_interned(parse_wasm(std::span{bytes}, {.copy_bytes = true}));
+
+  // Interned names outlive moves of the module
+  auto moved = std::optional<Ast_module>{};
+  {
+    auto is = Memstream{bytes};
+    auto original = parse_wasm(is);
+    moved.emplace(std::move(original));
+  }
+  EXPECT_THAT(moved->imports[1].name, testing::Eq("proc_exit"));
+
+  // Name section
+  auto sample = sample_module(10);
+  auto sample_module = parse_wasm(std::span{sample});
+  EXPECT_THAT(sample_module.name, testing::Optional(testing::Eq("sample")));
+  ASSERT_THAT(sample_module.func_names.size(), testing::Eq(10));
+  EXPECT_THAT(sample_module.func_names[9].idx, testing::Eq(10));
+  EXPECT_THAT(sample_module.func_names[9].name, testing::Eq("func10"));
+}
+
+TEST(parser, typesec) {
+  auto builder = Module_builder{};
+  builder.vec_section(k_section_type, {
+      {0x60, 0x02, 0x7f, 0x7e, 0x01, 0x7d},  // [i32 i64] -> [f32]
+      {0x60, 0x00, 0x00},                    // [] -> []
+      {0x60, 0x01, 0x7f, 0x02, 0x7e, 0x7d},  // [i32] -> [i64 f32]: same valtypes as type 0, split differently
+      {0x60, 0x02, 0x7f, 0x7e, 0x01, 0x7d},  // same as type 0
+      {0x60, 0x02, 0x70, 0x6f, 0x01, 0x7b},  // [funcref externref] -> [v128]
+    });
+
+  auto check = [](const Ast_type_table& types) {
+    ASSERT_THAT(types.size(), testing::Eq(5));
+    EXPECT_THAT(types[0].params, testing::ElementsAre(k_numtype_i32, k_numtype_i64));
+    EXPECT_THAT(types[0].results, testing::ElementsAre(k_numtype_f32));
+    EXPECT_TRUE(types[1].params.empty());
+    EXPECT_TRUE(types[1].results.empty());
+    EXPECT_THAT(types[4].params, testing::ElementsAre(k_reftype_funcref, k_reftype_externref));
+    EXPECT_THAT(types[4].results, testing::ElementsAre(k_vectype_v128));
+
+    EXPECT_TRUE(types.same_type(0, 3));
+    EXPECT_TRUE(types[0] == types[3]);
+    EXPECT_FALSE(types.same_type(0, 2));
+    EXPECT_FALSE(types[0] == types[2]);
+    EXPECT_FALSE(types.same_type(0, 1));
+    EXPECT_TRUE(types.same_type(1, 1));
+
+    // Canonical signature ids: dense, in order of first appearance
+    EXPECT_THAT(types.num_signatures(), testing::Eq(4));
+    EXPECT_THAT(types.signature_id(0), testing::Eq(0));
+    EXPECT_THAT(types.signature_id(2), testing::Eq(2));
+    EXPECT_THAT(types.signature_id(3), testing::Eq(0));
+    EXPECT_THAT(types.signature_id(4), testing::Eq(3));
+  };
+  check(parse_wasm(std::span{builder.bytes()}).types);
+  {
+    auto is = Memstream{builder.bytes()};
+    check(parse_wasm(is).types);
+  }
+}
+
 // TODO: importsec
 
 }  // namespace wasmtoolbox
@@ -0,0 +1,166 @@
+// Copyright (C) 2023 Patrick Varilly
+// patvarilly@gmail.com
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "streaming_parser.h"
+#include "module_builder.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace wasmtoolbox {
+
+static auto feed_in_chunks(Streaming_parser& parser, std::span<const uint8_t> bytes, size_t chunk_size) -> void {
+  for (auto pos = size_t{0}; pos < bytes.size(); pos += chunk_size) {
+    parser.feed(bytes.subspan(pos, std::min(chunk_size, bytes.size() - pos)));
+  }
+}
+
+TEST(streaming_parser, chunked) {
+  auto bytes = sample_module(8000);
+  ASSERT_THAT(bytes.size(), testing::Gt(3 * 65536));
+  auto expected = parse_wasm(std::span{bytes});
+
+  for (auto chunk_size : {size_t{1}, size_t{7}, size_t{65536}, bytes.size()}) {
+    SCOPED_TRACE(chunk_size);
+    auto parser = Streaming_parser{};
+    feed_in_chunks(parser, bytes, chunk_size);
+    EXPECT_THAT(parser.parsed_offset(), testing::Eq(bytes.size()));
+    auto module = parser.finish();
+    EXPECT_THAT(module.name, testing::Eq(expected.name));
+    EXPECT_THAT(module.types.size(), testing::Eq(expected.types.size()));
+    EXPECT_THAT(module.imports.size(), testing::Eq(expected.imports.size()));
+    EXPECT_THAT(module.func_types, testing::ElementsAreArray(expected.func_types));
+    ASSERT_THAT(module.func_names.size(), testing::Eq(expected.func_names.size()));
+    EXPECT_THAT(module.func_names.back().name, testing::Eq("func8000"));
+    ASSERT_THAT(module.datas.size(), testing::Eq(1));
+    EXPECT_THAT(module.datas[0].offset, testing::ElementsAreArray(expected.datas[0].offset));
+    EXPECT_THAT(module.datas[0].init, testing::ElementsAreArray(expected.datas[0].init));
+
+    // Everything lives in the module's arena, function bodies included
+    const auto& func = *module.codes.back().func;
+    EXPECT_THAT(func.body.get_allocator().resource(), testing::Eq(module.arena.resource()));
+    EXPECT_THAT(func.locals.get_allocator().resource(), testing::Eq(module.arena.resource()));
+  }
+}
+
+TEST(streaming_parser, decodes_function_bodies_as_they_arrive) {
+  auto bytes = sample_module(100);
+  auto parser = Streaming_parser{};
+
+  // Everything but the data section and the last byte of the last function body
+  auto data_section_size = size_t{1 + 1 + 1 + 4 + 13};
+  auto last_body_end = bytes.size() - data_section_size;
+  parser.feed(std::span{bytes}.first(last_body_end - 1));
+  EXPECT_THAT(parser.parsed_offset(), testing::Gt(bytes.size() / 2));
+  EXPECT_THAT(parser.parsed_offset(), testing::Lt(last_body_end - 1));
+
+  parser.feed(std::span{bytes}.subspan(last_body_end - 1, 1));
+  EXPECT_THAT(parser.parsed_offset(), testing::Eq(last_body_end));
+
+  parser.feed(std::span{bytes}.subspan(last_body_end));
+  EXPECT_THAT(parser.finish().func_types.size(), testing::Eq(100));
+}
+
+TEST(streaming_parser, hands_over_bodies_and_skips_sections) {
+  auto bytes = sample_module(300);
+  auto expected = parse_wasm(std::span{bytes});
+
+  auto parser = Streaming_parser{};
+  auto funcidxs = std::vector<uint32_t>{};
+  auto num_instrs = size_t{0};
+  parser.on_code = [&](uint32_t i, Ast_code&& code) {
+    funcidxs.push_back(i);
+    num_instrs += code.func->body.size();
+    EXPECT_THAT(code.func->body.size(), testing::Eq(expected.codes[i].func->body.size()));
+  };
+  parser.skip_section = [](Section_id id) { return id == k_section_custom || id == k_section_data; };
+  feed_in_chunks(parser, bytes, 7);
+  auto module = parser.finish();
+
+  ASSERT_THAT(funcidxs.size(), testing::Eq(300));
+  EXPECT_THAT(funcidxs.back(), testing::Eq(299));
+  EXPECT_TRUE(std::is_sorted(funcidxs.begin(), funcidxs.end()));
+  EXPECT_THAT(num_instrs, testing::Gt(300));
+  EXPECT_THAT(module.codes, testing::IsEmpty());
+  EXPECT_THAT(module.func_types, testing::ElementsAreArray(expected.func_types));
+  EXPECT_THAT(module.name, testing::Eq(std::nullopt));
+  EXPECT_THAT(module.func_names, testing::IsEmpty());
+  EXPECT_THAT(module.datas, testing::IsEmpty());
+
+  // A skipped section still has to fit in the module
+  auto truncated = Streaming_parser{};
+  truncated.throw_errors = false;
+  truncated.skip_section = [](Section_id id) { return id == k_section_data; };
+  truncated.feed(std::span{bytes}.first(bytes.size() - 3));
+  EXPECT_TRUE(truncated.ok());
+  truncated.finish();
+  ASSERT_FALSE(truncated.ok());
+  EXPECT_THAT(truncated.first_error->code, testing::Eq(Parse_error_code::k_unexpected_eof));
+}
+
+TEST(streaming_parser, errors) {
+  auto bytes = sample_module(10);
+
+  // Truncated module
+  {
+    auto parser = Streaming_parser{};
+    parser.feed(std::span{bytes}.first(bytes.size() - 3));
+    EXPECT_THROW(parser.finish(), std::logic_error);
+  }
+  {
+    auto parser = Streaming_parser{};
+    parser.throw_errors = false;
+    feed_in_chunks(parser, std::span{bytes}.first(bytes.size() - 3), 1);
+    EXPECT_TRUE(parser.ok());
+    parser.finish();
+    ASSERT_FALSE(parser.ok());
+    EXPECT_THAT(parser.first_error->code, testing::Eq(Parse_error_code::k_unexpected_eof));
+    EXPECT_THAT(parser.first_error->offset, testing::Eq(bytes.size() - 3));
+  }
+
+  // Bad opcode in a function body is spotted as soon as that body arrives, with the right offset
+  auto bad = bytes;
+  auto if_block = Bytes{0x41, 0x01, 0x04, 0x40};
+  auto pos = std::search(bad.begin(), bad.end(), if_block.begin(), if_block.end());
+  ASSERT_NE(pos, bad.end());
+  pos[2] = 0xd5;  // not an opcode
+  auto bad_offset = static_cast<long>(pos - bad.begin()) + 2;
+  EXPECT_THROW(parse_wasm(std::span{bad}), std::logic_error);
+  {
+    auto parser = Streaming_parser{};
+    parser.throw_errors = false;
+    feed_in_chunks(parser, bad, 1);
+    ASSERT_FALSE(parser.ok());
+    EXPECT_THAT(parser.first_error->section, testing::Eq(k_section_code));
+    EXPECT_THAT(parser.first_error->code, testing::Eq(Parse_error_code::k_unrecognized_opcode));
+    EXPECT_THAT(parser.first_error->offset, testing::Eq(bad_offset));
+  }
+
+  // Out-of-order section
+  auto builder = Module_builder{};
+  builder.vec_section(k_section_memory, {{0x00, 0x01}});
+  builder.vec_section(k_section_type, {});
+  {
+    auto parser = Streaming_parser{};
+    EXPECT_THROW(parser.feed(builder.bytes()), std::logic_error);
+  }
+  EXPECT_THROW(parse_wasm(std::span{builder.bytes()}), std::logic_error);
+}
+
+}  // namespace wasmtoolbox
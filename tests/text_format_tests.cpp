@@ -18,6 +18,11 @@
 #include "gmock/gmock.h"
 
 #include "text_format.h"
+#include "module_builder.h"
+#include "opcodes.h"
+#include "parallel_write.h"
+#include "parser.h"
+#include "streaming_write.h"
 
 #include <sstream>
 
@@ -43,11 +48,36 @@ TEST(text_format_writer, module_with_name) {
   EXPECT_THAT(os.str(), testing::StrEq("(module $hello)"));
 }
 
+TEST(text_format_writer, string) {
+  auto do_it = [&](std::string_view str) -> std::string {
+    auto os = std::stringstream{};
+    auto w = Text_format_writer{os};
+    w.tok_string(str);
+    w.flush();
+    return os.str();
+  };
+
+  EXPECT_THAT(do_it(""), testing::Eq("\"\""));
+  EXPECT_THAT(do_it("hello, world"), testing::Eq("\"hello, world\""));
+  EXPECT_THAT(do_it("\t\n\r\"'\\"), testing::Eq("\"\\t\\n\\r\\\"\\'\\\\\""));
+  EXPECT_THAT(do_it(std::string_view{"\x00\x1f\x7f\x80\xff", 5}), testing::Eq("\"\\00\\1f\\7f\\80\\ff\""));
+
+  // Escapes at every position of the 16-byte blocks that get scanned at once, and in the leftover bytes
+  auto plain = std::string(40, 'a');
+  for (auto i = size_t{0}; i != plain.size(); ++i) {
+    SCOPED_TRACE(i);
+    auto str = plain;
+    str[i] = '\xe9';
+    EXPECT_THAT(do_it(str), testing::Eq("\"" + plain.substr(0, i) + "\\e9" + plain.substr(i + 1) + "\""));
+  }
+}
+
 TEST(text_format_writer, id) {
   auto do_it = [&](auto id) -> std::string {
     auto os = std::stringstream{};
     auto w = Text_format_writer{os};
     w.tok_id(id);
+    w.flush();
     return os.str();
   };
 
@@ -65,21 +95,56 @@ TEST(text_format_writer, id) {
   EXPECT_THROW(do_it("bad{bad"), std::logic_error);
   EXPECT_THROW(do_it("bad}bad"), std::logic_error);
   EXPECT_THAT(do_it("$"), testing::Eq("$$"));
-}
 
-TEST(text_format_writer, module_with_two_types) {
-  auto module = Ast_module{
-    .types = {
-      Ast_functype{
-        .params = {k_numtype_i32, k_numtype_i64, k_vectype_v128},
-        .results = {k_numtype_f32, k_numtype_f64}
-      },
-      Ast_functype{
-        .params = {},
-        .results = {k_reftype_funcref, k_reftype_externref}
+  // Every byte, in the 16-byte blocks that get checked at once and in the leftover bytes
+  auto valid_puncts = std::string_view{"!#$%&\'*+-./:<=>?@\\^_`|~"};
+  for (auto c = 0; c != 256; ++c) {
+    SCOPED_TRACE(c);
+    auto is_idchar = (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+                     (c != 0 && valid_puncts.find(static_cast<char>(c)) != std::string_view::npos);
+    for (auto id : {std::string(20, 'a') + static_cast<char>(c) + "aa", "a" + std::string(1, static_cast<char>(c))}) {
+      if (is_idchar) {
+        EXPECT_THAT(do_it(id), testing::Eq("$" + id));
+      } else {
+        EXPECT_THROW(do_it(id), std::logic_error);
       }
     }
+  }
+}
+
+TEST(text_format_writer, sanitized_id) {
+  auto do_it = [&](std::string_view id) -> std::string {
+    auto os = std::stringstream{};
+    auto w = Text_format_writer{os};
+    w.options.sanitize_ids = true;
+    w.tok_id(id);
+    w.flush();
+    return os.str();
   };
+
+  EXPECT_THAT(do_it("hello"), testing::Eq("$hello"));
+  EXPECT_THAT(do_it(""), testing::Eq("$\\"));
+  EXPECT_THAT(do_it("bad bad"), testing::Eq("$bad\\20bad"));
+  EXPECT_THAT(do_it("a\\b"), testing::Eq("$a\\5cb"));
+  EXPECT_THAT(do_it("(\"x\")"), testing::Eq("$\\28\\22x\\22\\29"));
+  EXPECT_THAT(do_it("caf\xc3\xa9"), testing::Eq("$caf\\c3\\a9"));
+  EXPECT_THAT(do_it("a long name with spaces, commas; and brackets [0]"),
+              testing::Eq("$a\\20long\\20name\\20with\\20spaces\\2c\\20commas\\3b\\20and\\20brackets\\20\\5b0\\5d"));
+
+  // A module whose name isn't an identifier still gets written out
+  auto module = Ast_module{.name = "my module"};
+  auto text = std::string{};
+  {
+    auto out = Output_sink{text};
+    write_module_in_parallel(out, module, 2, {.sanitize_ids = true});
+  }
+  EXPECT_THAT(text, testing::Eq("(module $my\\20module)"));
+}
+
+TEST(text_format_writer, module_with_two_types) {
+  auto module = Ast_module{};
+  module.types.add({k_numtype_i32, k_numtype_i64, k_vectype_v128}, {k_numtype_f32, k_numtype_f64});
+  module.types.add({}, {k_reftype_funcref, k_reftype_externref});
   auto os = std::stringstream{};
   auto w = Text_format_writer{os};
 
@@ -115,4 +180,219 @@ TEST(text_format_writer, module_with_imports) {
       "  (import \"mod3\" \"name4\"))"));
 }
 
+TEST(text_format_writer, module_with_func) {
+  auto module = Ast_module{};
+  module.types.add({}, {k_numtype_i32});
+  module.func_types.push_back(0);
+  auto func = Ast_func{};
+  func.locals.push_back(Ast_locals{.n = 2, .t = k_numtype_f64});
+  func.br_table_labels = {0, 1};
+  func.body = {
+    Ast_instr{.opcode = k_instr_block, .a = k_blocktype_valtype | k_numtype_i32, .b = 6},
+    Ast_instr{.opcode = k_instr_i32_const, .a = static_cast<uint32_t>(-7)},
+    Ast_instr{.opcode = k_instr_local_get, .a = 1},
+    Ast_instr{.opcode = k_instr_br_table, .a = 0, .b = 2},
+    Ast_instr{.opcode = k_instr_f64_const, .a = 0, .b = 0xfff80000},  // -nan
+    Ast_instr{.opcode = k_instr_i64_load8_u, .a = 1, .b = 16},
+    Ast_instr{.opcode = k_instr_end, .a = 0},
+    Ast_instr{.opcode = k_instr_ext_prefix, .subopcode = k_ext_instr_memory_fill},
+    Ast_instr{.opcode = k_instr_end, .a = k_no_instr},
+  };
+  module.codes.push_back(Ast_code{.offset = 0, .size = 0, .func = std::move(func)});
+  auto os = std::stringstream{};
+  auto w = Text_format_writer{os};
+
+  w.write_module(module);
+
+  EXPECT_THAT(os.str(), testing::StrEq(
+      "(module\n"
+      "  (type (;0;) (func (result i32)))\n"
+      "  (func (type 0)\n"
+      "    (local f64 f64)\n"
+      "    block (result i32)\n"
+      "      i32.const -7\n"
+      "      local.get 1\n"
+      "      br_table 0 1\n"
+      "      f64.const -nan:0x8000000000000\n"
+      "      i64.load8_u offset=16 align=2\n"
+      "    end\n"
+      "    memory.fill))"));
+}
+
+TEST(text_format_writer, unusual_immediates) {
+  auto do_it = [&](const Ast_func& func) -> std::string {
+    auto os = std::stringstream{};
+    auto w = Text_format_writer{os};
+    for (const auto& instr : func.body) { w.write_instr(func, instr); }
+    w.flush();
+    return os.str();
+  };
+
+  // select t*, with no types or several of them (neither is valid, but both can be decoded)
+  auto func = Ast_func{};
+  func.br_table_labels = {k_numtype_i32, k_numtype_f64, k_reftype_externref};
+  func.body = {
+    Ast_instr{.opcode = k_instr_select_t, .a = 0, .b = 1},
+    Ast_instr{.opcode = k_instr_select_t, .a = 0, .b = 0},
+    Ast_instr{.opcode = k_instr_select_t, .a = 1, .b = 2},
+    Ast_instr{.opcode = k_instr_i32_load, .a = 40, .b = 0},
+  };
+  EXPECT_THAT(do_it(func), testing::StrEq(
+      "\nselect (result i32)"
+      "\nselect"
+      "\nselect (result f64 externref)"
+      "\ni32.load align=1099511627776"));
+
+  // table.init puts its operands in the opposite order to the binary format; table.copy doesn't
+  func.body = {
+    Ast_instr{.opcode = k_instr_ext_prefix, .subopcode = k_ext_instr_table_init, .a = 1, .b = 0},
+    Ast_instr{.opcode = k_instr_ext_prefix, .subopcode = k_ext_instr_table_copy, .a = 1, .b = 0},
+  };
+  EXPECT_THAT(do_it(func), testing::StrEq(
+      "\ntable.init 0 1"
+      "\ntable.copy 1 0"));
+
+  // Alignments that don't fit in 64 bits
+  for (auto align : {64u, 80u, 0xffffffffu}) {
+    SCOPED_TRACE(align);
+    func.body = {Ast_instr{.opcode = k_instr_i32_load, .a = align, .b = 0}};
+    EXPECT_THROW(do_it(func), std::logic_error);
+  }
+}
+
+TEST(text_format_writer, vector_instructions) {
+  auto module = Ast_module{};
+  module.types.add({}, {});
+  module.func_types.push_back(0);
+  auto func = Ast_func{};
+  func.v128_imms.push_back({0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                            0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0xff});
+  func.v128_imms.push_back({0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 31});
+  func.body = {
+    Ast_instr{.opcode = k_instr_simd_prefix, .subopcode = k_simd_instr_v128_const, .a = 0},
+    Ast_instr{.opcode = k_instr_simd_prefix, .subopcode = k_simd_instr_i8x16_shuffle, .a = 1},
+    Ast_instr{.opcode = k_instr_simd_prefix, .lane = 3, .subopcode = k_simd_instr_f32x4_extract_lane},
+    Ast_instr{.opcode = k_instr_simd_prefix, .subopcode = k_simd_instr_v128_load8x8_s, .a = 3, .b = 0},
+    Ast_instr{.opcode = k_instr_simd_prefix, .lane = 1, .subopcode = k_simd_instr_v128_load32_lane, .a = 0, .b = 8},
+    Ast_instr{.opcode = k_instr_simd_prefix, .subopcode = k_simd_instr_v128_store, .a = 4, .b = 0},
+    Ast_instr{.opcode = k_instr_simd_prefix, .subopcode = k_simd_instr_f64x2_convert_low_i32x4_u},
+    Ast_instr{.opcode = k_instr_end, .a = k_no_instr},
+  };
+  module.codes.push_back(Ast_code{.offset = 0, .size = 0, .func = std::move(func)});
+  auto os = std::stringstream{};
+  auto w = Text_format_writer{os};
+
+  w.write_module(module);
+
+  EXPECT_THAT(os.str(), testing::StrEq(
+      "(module\n"
+      "  (type (;0;) (func))\n"
+      "  (func (type 0)\n"
+      "    v128.const i32x4 0x03020100 0x07060504 0x0b0a0908 0xff0e0d0c\n"
+      "    i8x16.shuffle 0 2 4 6 8 10 12 14 16 18 20 22 24 26 28 31\n"
+      "    f32x4.extract_lane 3\n"
+      "    v128.load8x8_s\n"
+      "    v128.load32_lane offset=8 align=1 1\n"
+      "    v128.store\n"
+      "    f64x2.convert_low_i32x4_u))"));
+}
+
+TEST(text_format_writer, parallel) {
+  auto bytes = sample_module(2000);
+  auto module = parse_wasm(std::span{bytes});
+  auto serial = std::stringstream{};
+  Text_format_writer{serial}.write_module(module);
+
+  for (auto num_threads : {1, 2, 3, 8}) {
+    SCOPED_TRACE(num_threads);
+    auto text = std::string{};
+    {
+      auto out = Output_sink{text, 4096};
+      write_module_in_parallel(out, module, num_threads);
+    }
+    EXPECT_TRUE(text == serial.str());
+  }
+
+  // Modules with few or no fields
+  for (const auto& small : {Ast_module{}, Ast_module{.name = "m"}}) {
+    auto expected = std::stringstream{};
+    Text_format_writer{expected}.write_module(small);
+    auto text = std::string{};
+    {
+      auto out = Output_sink{text};
+      write_module_in_parallel(out, small, 4);
+    }
+    EXPECT_THAT(text, testing::Eq(expected.str()));
+  }
+
+  // An instruction that can't be written stops the output at the same place
+  auto bad = parse_wasm(std::span{bytes});
+  bad.codes[1500].func->body[0].opcode = 0xd5;  // not an opcode
+  auto serial_text = std::string{};
+  {
+    auto out = Output_sink{serial_text};
+    EXPECT_THROW(Text_format_writer{out}.write_module(bad), std::logic_error);
+  }
+  auto parallel_text = std::string{};
+  {
+    auto out = Output_sink{parallel_text};
+    EXPECT_THROW(write_module_in_parallel(out, bad, 4), std::logic_error);
+  }
+  EXPECT_TRUE(parallel_text == serial_text);
+  EXPECT_THAT(parallel_text.size(), testing::Lt(serial.str().size()));
+  EXPECT_TRUE(serial.str().starts_with(serial_text));
+  EXPECT_THAT(serial_text, testing::EndsWith("(local i32 i32)"));  // nothing of the bad instruction
+}
+
+TEST(text_format_writer, streaming) {
+  // Big enough to take several chunks, with bodies straddling them
+  auto bytes = sample_module(8000);
+  auto module = parse_wasm(std::span{bytes});
+  auto expected = std::stringstream{};
+  Text_format_writer{expected}.write_module(module);
+
+  auto module_name = find_module_name(bytes, index_wasm(bytes));
+  EXPECT_THAT(module_name, testing::Optional(std::string{"sample"}));
+  auto text = std::string{};
+  {
+    auto out = Output_sink{text, 4096};
+    auto is = std::istringstream{std::string{bytes.begin(), bytes.end()}};
+    write_wasm_streaming(out, is, module_name);
+  }
+  EXPECT_TRUE(text == expected.str());
+
+  // No code section, and no name
+  auto builder = Module_builder{};
+  builder.vec_section(k_section_type, {{0x60, 0x00, 0x00}});
+  auto small = parse_wasm(std::span{builder.bytes()});
+  auto small_expected = std::stringstream{};
+  Text_format_writer{small_expected}.write_module(small);
+  auto small_text = std::string{};
+  {
+    auto out = Output_sink{small_text};
+    auto is = std::istringstream{std::string{builder.bytes().begin(), builder.bytes().end()}};
+    write_wasm_streaming(out, is, find_module_name(builder.bytes(), index_wasm(builder.bytes())));
+  }
+  EXPECT_THAT(small_text, testing::Eq(small_expected.str()));
+
+  // Malformed input stops the output after the last function written
+  auto bad = bytes;
+  auto if_block = Bytes{0x41, 0x01, 0x04, 0x40};
+  auto pos = std::search(bad.begin() + static_cast<long>(bad.size() / 2), bad.end(), if_block.begin(), if_block.end());
+  ASSERT_NE(pos, bad.end());
+  pos[2] = 0xd5;  // not an opcode
+  auto bad_text = std::string{};
+  {
+    auto out = Output_sink{bad_text};
+    auto is = std::istringstream{std::string{bad.begin(), bad.end()}};
+    EXPECT_THROW(write_wasm_streaming(out, is, module_name), std::logic_error);
+  }
+  auto num_funcs_written = 0;
+  for (auto p = bad_text.find("(func"); p != std::string::npos; p = bad_text.find("(func", p + 1)) {
+    ++num_funcs_written;
+  }
+  EXPECT_THAT(num_funcs_written, testing::AllOf(testing::Gt(1000), testing::Lt(8000)));
+  EXPECT_TRUE(text.starts_with(bad_text));
+}
+
 }  // namespace wasmtoolbox
@@ -14,13 +14,26 @@
 // You should have received a copy of the GNU General Public License along with
 // this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include "absl/log/initialize.h"
 #include "absl/strings/str_format.h"
 
+#include "mapped_file.h"
+#include "opcodes.h"
+#include "output_sink.h"
+#include "parallel_write.h"
 #include "parser.h"
+#include "streaming_write.h"
 #include "text_format.h"
 
 namespace wasmtoolbox {
@@ -29,11 +42,116 @@ auto usage() -> void {
   std::cerr <<
       "Usage: wasmtoolbox <tool> [<args>]\n"
       "Tools:\n"
-      "- wasm2wat <file.wasm>\n"
-      "    Converts binary representation in <file.wasm> to text representation\n";
+      "- wasm2wat [--parallel] <file.wasm>\n"
+      "    Converts binary representation in <file.wasm> to text representation, one function at a time,\n"
+      "    or with --parallel, decoding the whole module first (as for pipes) and writing it on several threads\n"
+      "- sections <file.wasm>\n"
+      "    Lists the sections in <file.wasm> and where they are, without decoding them\n"
+      "- types [--dedup] <file.wasm>\n"
+      "    Lists the function types in <file.wasm>, or with --dedup, how many of them are duplicates\n"
+      "- validate <file.wasm>\n"
+      "    Checks that the function bodies in <file.wasm> are well-typed, and reports the first problem if not\n"
+      "- simd-report <file.wasm>\n"
+      "    Shows what share of each function's instructions are vector (SIMD) instructions\n";
   std::exit(EXIT_FAILURE);
 }
 
+auto section_name(Section_id id) -> std::string_view {
+  switch (id) {
+    case k_section_custom:     return "custom";
+    case k_section_type:       return "type";
+    case k_section_import:     return "import";
+    case k_section_function:   return "function";
+    case k_section_table:      return "table";
+    case k_section_memory:     return "memory";
+    case k_section_global:     return "global";
+    case k_section_export:     return "export";
+    case k_section_start:      return "start";
+    case k_section_element:    return "element";
+    case k_section_code:       return "code";
+    case k_section_data:       return "data";
+    case k_section_data_count: return "datacount";
+    case k_section_tag:        return "tag";
+  }
+  return "?";
+}
+
+auto list_sections(const Section_index& index) -> void {
+  for (const auto& entry : index.sections) {
+    std::cout << absl::StreamFormat("%-10s start=0x%08x end=0x%08x (size=0x%08x)",
+                                    section_name(entry.id), entry.contents_offset, entry.end_offset(), entry.size);
+    if (entry.id == k_section_custom) {
+      std::cout << absl::StreamFormat(" \"%s\"", entry.name);
+    }
+    std::cout << "\n";
+  }
+}
+
+auto format_functype(Ast_functype functype) -> std::string {
+  auto os = std::ostringstream{};
+  auto w = Text_format_writer{os};
+  w.write_functype(functype);
+  w.flush();
+  return os.str();
+}
+
+auto list_types(const Ast_type_table& types) -> void {
+  for (auto typeidx = Ast_typeidx{0}; typeidx != types.size(); ++typeidx) {
+    std::cout << absl::StreamFormat("%6d: %s\n", typeidx, format_functype(types[typeidx]));
+  }
+}
+
+auto report_duplicate_types(const Ast_type_table& types) -> void {
+  auto typeidxs_by_signature = std::vector<std::vector<Ast_typeidx>>(types.num_signatures());
+  for (auto typeidx = Ast_typeidx{0}; typeidx != types.size(); ++typeidx) {
+    typeidxs_by_signature[types.signature_id(typeidx)].push_back(typeidx);
+  }
+  std::cout << absl::StreamFormat("%d types, %d distinct signatures, %d duplicates\n",
+                                  types.size(), types.num_signatures(), types.size() - types.num_signatures());
+
+  // Most duplicated first
+  std::ranges::stable_sort(typeidxs_by_signature, std::greater{}, &std::vector<Ast_typeidx>::size);
+  constexpr auto k_max_typeidxs_shown = size_t{8};
+  for (const auto& typeidxs : typeidxs_by_signature) {
+    if (typeidxs.size() < 2) { break; }
+    std::cout << absl::StreamFormat("%6d x %s: types", typeidxs.size(), format_functype(types[typeidxs[0]]));
+    for (auto i = size_t{0}; i != std::min(typeidxs.size(), k_max_typeidxs_shown); ++i) {
+      std::cout << " " << typeidxs[i];
+    }
+    std::cout << (typeidxs.size() > k_max_typeidxs_shown ? " ...\n" : "\n");
+  }
+}
+
+// One line per function defined in the module, then totals.  Vector instructions are the ones after the 0xfd
+// prefix, so a release build whose hot functions show none here wasn't vectorized.
+auto report_simd_usage(const Ast_module& module) -> void {
+  auto num_imported_funcs = static_cast<uint32_t>(std::ranges::count(
+      module.imports, Ast_externkind::k_func, [](const Ast_import& import) { return import.desc.kind; }));
+  auto names = std::span{module.func_names};  // sorted by funcidx
+  auto total_instrs = size_t{0};
+  auto total_simd_instrs = size_t{0};
+  auto num_funcs_with_simd = size_t{0};
+
+  std::cout << absl::StreamFormat("%8s %10s %10s %7s  %s\n", "funcidx", "instrs", "simd", "share", "name");
+  for (auto i = uint32_t{0}; i != module.codes.size(); ++i) {
+    const auto& body = module.codes[i].func->body;
+    auto num_simd_instrs = static_cast<size_t>(std::ranges::count(body, k_instr_simd_prefix, &Ast_instr::opcode));
+    total_instrs += body.size();
+    total_simd_instrs += num_simd_instrs;
+    num_funcs_with_simd += num_simd_instrs != 0;
+
+    auto funcidx = num_imported_funcs + i;
+    while (not names.empty() && names.front().idx < funcidx) { names = names.subspan(1); }
+    auto name = not names.empty() && names.front().idx == funcidx ? names.front().name : Ast_name{};
+    std::cout << absl::StreamFormat("%8d %10d %10d %6.1f%%  %s\n",
+                                    funcidx, body.size(), num_simd_instrs, 100.0 * num_simd_instrs / body.size(), name);
+  }
+
+  std::cout << absl::StreamFormat("%d of %d functions use SIMD; %d of %d instructions (%.1f%%)\n",
+                                  num_funcs_with_simd, module.codes.size(), total_simd_instrs, total_instrs,
+                                  total_instrs == 0 ? 0.0 : 100.0 * total_simd_instrs / total_instrs);
+}
+
 }  // namespace wasmtoolbox
 
 auto main(int argc, char** argv) -> int {
@@ -45,16 +163,109 @@ auto main(int argc, char** argv) -> int {
 
   auto toolname = std::string{argv[1]};
   if (toolname == "wasm2wat") {
+    auto parallel = argc >= 3 && std::string_view{argv[2]} == "--parallel";
+    if (argc != (parallel ? 4 : 3)) { usage(); }
+    auto filename = std::string{argv[parallel ? 3 : 2]};
+    auto out = Output_sink{STDOUT_FILENO};
+    auto options = Text_format_options{.sanitize_ids = true};  // rather than stop at the first odd name
+    auto mapped = Mapped_file::map(filename);
+    if (mapped && not parallel) {
+      // Look up the module's name, which goes first, then stream the file through without mapping all of it in
+      auto bytes = mapped->bytes();
+      auto module_name = find_module_name(bytes, index_wasm(bytes));
+      mapped.reset();
+      auto is = std::ifstream{filename, std::ios::binary};
+      if (!is) {
+        std::cerr << absl::StreamFormat("Error: could not open file %s\n", filename);
+        return EXIT_FAILURE;
+      }
+      write_wasm_streaming(out, is, module_name, options);
+    } else {
+      // Either asked to, or not a regular file (e.g., a pipe), which leaves no way to find the name first
+      auto is = std::ifstream{};
+      if (not mapped) {
+        is.open(filename, std::ios::binary);
+        if (!is) {
+          std::cerr << absl::StreamFormat("Error: could not open file %s\n", filename);
+          return EXIT_FAILURE;
+        }
+      }
+      auto module = mapped ? parse_wasm(mapped->bytes()) : parse_wasm(is);  // module points into mapped
+      write_module_in_parallel(out, module, static_cast<int>(std::thread::hardware_concurrency()), options);
+    }
+    if (not out.ok()) {
+      std::cerr << "Error: could not write output\n";
+      return EXIT_FAILURE;
+    }
+  } else if (toolname == "sections") {
+    if (argc < 3) { usage(); }
+    auto filename = std::string{argv[2]};
+    if (auto mapped = Mapped_file::map(filename)) {
+      list_sections(index_wasm(mapped->bytes()));
+    } else {
+      auto is = std::ifstream{filename, std::ios::binary};
+      if (!is) {
+        std::cerr << absl::StreamFormat("Error: could not open file %s\n", filename);
+        return EXIT_FAILURE;
+      }
+      list_sections(index_wasm(is));
+    }
+  } else if (toolname == "types") {
+    auto dedup = argc >= 3 && std::string_view{argv[2]} == "--dedup";
+    if (argc != (dedup ? 4 : 3)) { usage(); }
+    auto filename = std::string{argv[dedup ? 3 : 2]};
+    auto report = [&](const Ast_type_table& types) {
+      if (dedup) {
+        report_duplicate_types(types);
+      } else {
+        list_types(types);
+      }
+    };
+    if (auto mapped = Mapped_file::map(filename)) {
+      // Only decode the type section
+      auto bytes = mapped->bytes();
+      auto index = index_wasm(bytes);
+      auto entry = index.find(k_section_type);
+      report(entry ? section_parser(bytes, *entry).parse_typesec() : Ast_type_table{});
+    } else {
+      auto is = std::ifstream{filename, std::ios::binary};
+      if (!is) {
+        std::cerr << absl::StreamFormat("Error: could not open file %s\n", filename);
+        return EXIT_FAILURE;
+      }
+      report(parse_wasm(is, {.lazy_function_bodies = true}).types);
+    }
+  } else if (toolname == "validate") {
     if (argc < 3) { usage(); }
     auto filename = std::string{argv[2]};
-    auto is = std::ifstream{filename, std::ios::binary};
-    if (!is) {
-      std::cerr << absl::StreamFormat("Error: could not open file %s\n", filename);
+    auto mapped = Mapped_file::map(filename);
+    auto is = std::ifstream{};
+    if (not mapped) {
+      is.open(filename, std::ios::binary);
+      if (!is) {
+        std::cerr << absl::StreamFormat("Error: could not open file %s\n", filename);
+        return EXIT_FAILURE;
+      }
+    }
+    auto options = Parse_options{.validate = true};
+    auto result = mapped ? try_parse_wasm(mapped->bytes(), options) : try_parse_wasm(is, options);
+    if (not result) {
+      std::cerr << absl::StreamFormat("%s: %s\n", filename, result.error().message());
       return EXIT_FAILURE;
     }
-    auto module = parse_wasm(is);
-    auto w = Text_format_writer{std::cout};
-    w.write_module(module);
+  } else if (toolname == "simd-report") {
+    if (argc < 3) { usage(); }
+    auto filename = std::string{argv[2]};
+    auto mapped = Mapped_file::map(filename);
+    auto is = std::ifstream{};
+    if (not mapped) {
+      is.open(filename, std::ios::binary);
+      if (!is) {
+        std::cerr << absl::StreamFormat("Error: could not open file %s\n", filename);
+        return EXIT_FAILURE;
+      }
+    }
+    report_simd_usage(mapped ? parse_wasm(mapped->bytes()) : parse_wasm(is));
   } else {
     usage();
   }